@@ -65,7 +65,7 @@ struct enetApplication
         {
             if( m_layers[i] == 0 )
             {
-                //std::cout << "\tGenerating Layer " << i << " of " << end << std::endl;
+                std::cerr << "Generating epsilon net layer " << i << " of " << end - 1 << std::endl;
                 epsilonnet base_net;
                 base_net.loadFromFile( netGenerator::fileName(i-1).c_str() );
                 std::unique_ptr<epsilonnet> res( netGenerator::generate( base_net ) );
@@ -17,10 +17,12 @@
 // 
 
 #include <fstream>
+#include <cstring>
 #include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include "epsilonnet.h"
 #include "output.h"
 
@@ -29,7 +31,7 @@ using boost::make_iterator_range;
 
 using namespace std;
 
-/// \brief Header of the file with epsilon net
+/// \brief Header of the epsilon net files written before pod files, see podfile.h
 struct epsilonnetHeader
 {
     size_t nodes_count;
@@ -42,33 +44,63 @@ std::ostream& operator<<(std::ostream& out, const enetNode& node )
     return out;
 }
 
-bool epsilonnet::loadFromFile(const char* filename)
+/// \brief Reads file in the format used before pod files, the whole file is copied into memory
+static bool loadLegacyFile( const char* filename, vector<enetNode>& nodes, vector<ring_int<int> >& numbers )
 {
     epsilonnetHeader eh;
     ifstream ifs( filename, ios_base::binary );
     if( !ifs )
         return false;
     ifs.read( (char*) &eh,sizeof(eh));
+    if( !ifs || eh.nodes_count == 0 )
+        return false;
     nodes.clear();
     nodes.resize( eh.nodes_count );
     ifs.read( (char*) &nodes[0], nodes.size() * sizeof(enetNode) );
     numbers.clear();
     numbers.resize( nodes.back().num_offset );
-    ifs.read( (char*) &numbers[0], numbers.size() * sizeof(ri) );
+    ifs.read( (char*) &numbers[0], numbers.size() * sizeof(ring_int<int>) );
     ifs.close();
+    return true;
+}
+
+bool epsilonnet::loadFromFile(const char* filename)
+{
+    podFileHeader h;
+    auto file = openPodFile( filename, podEpsilonNet, h );
+    if( file )
+    {
+        if( !podSection( file, h, 0, nodes ) || !podSection( file, h, 1, numbers ) ||
+            nodes.empty() || nodes.back().num_offset != numbers.size() )
+            return false;
+    }
+    else if( !loadLegacyFile( filename, nodes.modifiable(), numbers.modifiable() ) )
+        return false;
     denominator_exponent = denominatorExponent2();
+    precomputeComplex();
     return true;
 }
 
+/// \brief Appends node with given num_offset. Padding of the node is cleared too,
+/// because nodes are written to files as is and files should not depend on garbage in memory
+static void pushNode( vector<enetNode>& nodes, size_t num_offset )
+{
+    nodes.push_back( enetNode() );
+    memset( &nodes.back(), 0, sizeof(enetNode) );
+    nodes.back().num_offset = num_offset;
+}
+
 epsilonnet::epsilonnet()
 {
-    enetNode nd={0,0,0,0};
-    nodes.push_back(nd);
+    pushNode( nodes.modifiable(), 0 );
 }
 
 size_t epsilonnet::nodesCount(const char* filename) const
 {
-    epsilonnetHeader eh;
+    podFileHeader h;
+    if( openPodFile( filename, podEpsilonNet, h ) )
+        return h.sections > 0 ? h.section[0].count : 0;
+    epsilonnetHeader eh = {0};
     ifstream ifs( filename, ios_base::binary );
     ifs.read( (char*) &eh,sizeof(eh));
     ifs.close();
@@ -80,19 +112,13 @@ void epsilonnet::saveToFile  (const char* filename) const
     if( numbers.size() == 0 )
         return;
 
-    epsilonnetHeader eh;
-    eh.nodes_count = nodes.size();
-    ofstream ofs( filename, ios_base::binary );
-    ofs.write( (const char*) &eh,sizeof(eh));
-
     assert( nodes.back().ipxx == 0 );
     assert( nodes.back().ipQxx == 0 );
     assert( nodes.back().num_offset == numbers.size() );
 
-    ofs.write( (const char*) &nodes[0], nodes.size() * sizeof(enetNode) );
-    ofs.write( (const char*) &numbers[0], numbers.size() * sizeof(ri) );
-
-    ofs.close();
+    podFileData arrays[2] = { { nodes.begin(), nodes.size(), sizeof(enetNode) },
+                              { numbers.begin(), numbers.size(), sizeof(ri) } };
+    savePodFile( filename, podEpsilonNet, arrays, 2 );
 }
 
 /// \brief Comparator based on pointers data
@@ -132,15 +158,15 @@ void epsilonnet::addNode( const pair< ip_type,ip_type>& ip, const nodeRangesPtr
     nodes.back().ipQxx = ip.second;
 
     eq_ptr< ri > eq_ri;
-    back_insert_iterator_ptr< vector<ri> > biit( numbers );
+    vector<ri>& nums = numbers.modifiable();
+    back_insert_iterator_ptr< vector<ri> > biit( nums );
 
-    int size = numbers.size();
+    int size = nums.size();
     unique_copy( ranges.nums_begin, ranges.nums_end , biit , eq_ri );
-    nodes.back().compl_offset = numbers.size() - size;
+    nodes.back().compl_offset = nums.size() - size;
     unique_copy( ranges.nums_compl_begin, ranges.nums_compl_end , biit , eq_ri );
 
-    enetNode en = {0,0,numbers.size(),0};
-    nodes.push_back(en);
+    pushNode( nodes.modifiable(), numbers.size() );
 }
 
 void epsilonnet::addNode(epsilonnet::ip_type ipxx, epsilonnet::ip_type ipQxx, const nodeRanges &ranges)
@@ -148,14 +174,14 @@ void epsilonnet::addNode(epsilonnet::ip_type ipxx, epsilonnet::ip_type ipQxx, co
     nodes.back().ipxx = ipxx;
     nodes.back().ipQxx = ipQxx;
 
-    auto bi = back_inserter( numbers );
-    int size = numbers.size();
+    vector<ri>& nums = numbers.modifiable();
+    auto bi = back_inserter( nums );
+    int size = nums.size();
     unique_copy( ranges.nums_begin, ranges.nums_end ,bi );
-    nodes.back().compl_offset = numbers.size() - size;
+    nodes.back().compl_offset = nums.size() - size;
     unique_copy( ranges.nums_compl_begin, ranges.nums_compl_end , bi );
 
-    enetNode en = {0,0,numbers.size(),0};
-    nodes.push_back(en);
+    pushNode( nodes.modifiable(), numbers.size() );
 }
 
 void epsilonnet::getNode(size_t node_id, nodeRanges &ranges) const
@@ -196,22 +222,44 @@ int epsilonnet::sde() const
 double epsilonnet::findExhaustiveApproximation(const epsilonnet::vector2double &vec, epsilonnet::vi &result) const
 {
     //denominator_exponent = denominatorExponent2();
-    vi current;
-    double current_dist = 1.0;
     double best_dist = 1.0;
+    int best_node = -1;
     vector2double canonical_vec = vec;
     bool conj_1 = false, conj_2 = false;
     int w_pow1 = 0, w_pow2 = 0;
     canonical_vec.first = canonical( vec.first, w_pow1, conj_1 );
     canonical_vec.second = canonical( vec.second, w_pow2, conj_2 );
 
-    for( int i = 0; i < nodes.size(); ++i )
+    // the last node only marks the end of numbers
+    int sz = nodes.size() - 1;
+
+    // Each thread keeps the first best node in its part, the first best node overall wins,
+    // so the result is the same as for the sequential search
+    #pragma omp parallel
     {
-        current_dist = findExhaustiveApproximation( canonical_vec, current, i );
-        if( best_dist > current_dist )
+        vi current, local_result;
+        double local_dist = 1.0;
+        int local_node = -1;
+
+        #pragma omp for schedule(dynamic,16) nowait
+        for( int i = 0; i < sz; ++i )
+        {
+            double current_dist = findExhaustiveApproximation( canonical_vec, current, i );
+            if( local_dist > current_dist )
+            {
+                local_dist = current_dist;
+                local_result = current;
+                local_node = i;
+            }
+        }
+
+        #pragma omp critical
+        if( local_node >= 0 && ( best_dist > local_dist ||
+                                 ( best_dist == local_dist && local_node < best_node ) ) )
         {
-            best_dist = current_dist;
-            result  = current;
+            best_dist = local_dist;
+            best_node = local_node;
+            result = local_result;
         }
     }
 
@@ -228,133 +276,114 @@ double epsilonnet::findExhaustiveApproximation(const epsilonnet::vector2double &
     return best_dist;
 }
 
-typedef  epsilonnet::vector2double vd;
-
-/// \brief Inline Euclidean distance computation
-inline double dist_squared( const vd& a, const vd& b )
+void epsilonnet::precomputeComplex()
 {
-    double d1 = a.first.real() - b.first.real();
-    double d2 = a.second.real() - b.second.real();
-    double d3 = a.first.imag() - b.first.imag();
-    double d4 = a.second.imag() - b.second.imag();
-    return d1*d1 +d2*d2 +d3*d3 + d4*d4;
+    size_t sz = numbers.size();
+    numbers_re.resize( sz );
+    numbers_im.resize( sz );
+    for( size_t i = 0; i < sz; ++i )
+        numbers[i].toComplex( denominator_exponent, numbers_re[i], numbers_im[i] );
 }
 
-/// \brief Inline Euclidean distance computation
-inline double dist_squared( const vd& a, double fre,  double fim , double sre ,  double sim )
+/// \brief Finds numbers closest to a and to b among n numbers with real parts re and imaginary parts im.
+/// Ties are resolved in favour of the smallest index.
+static void closestNumbers( const double* re, const double* im, size_t n,
+                            std::complex<double> a, size_t& ia, double& da,
+                            std::complex<double> b, size_t& ib, double& db )
 {
-    double d1 = a.first.real() - fre;
-    double d2 = a.second.real() - sre;
-    double d3 = a.first.imag() - fim;
-    double d4 = a.second.imag() - sim;
-    return d1*d1 +d2*d2 +d3*d3 + d4*d4;
+    const double are = a.real(), aim = a.imag(), bre = b.real(), bim = b.imag();
+    ia = ib = 0;
+    da = db = std::numeric_limits<double>::max();
+    for( size_t k = 0; k < n; ++k )
+    {
+        double d1 = are - re[k];
+        double d2 = aim - im[k];
+        double d3 = bre - re[k];
+        double d4 = bim - im[k];
+        double dista = d1*d1 + d2*d2;
+        double distb = d3*d3 + d4*d4;
+        if( dista < da ) { da = dista; ia = k; }
+        if( distb < db ) { db = distb; ib = k; }
+    }
 }
 
-/// \todo Remove code duplication by changing one of epsilonnet::findExhaustiveApproximation
-double epsilonnet::findExhaustiveApproximation(const epsilonnet::vector2double &vec, epsilonnet::vi &result, int node_id) const
+double epsilonnet::findInNode(const epsilonnet::vector2double &vec, int node_id, const ri *&first, const ri *&second) const
 {
-    double best = 3.0;
     nodeRanges nr;
     getNode( node_id, nr );
-    auto ic = nr.nums_begin;
-    auto jc = nr.nums_compl_begin;
-    bool tw = true;
-    for( auto i = nr.nums_begin; i != nr.nums_end ;++i )
+    size_t n = nr.nums_end - nr.nums_begin;
+    size_t nc = nr.nums_compl_end - nr.nums_compl_begin;
+    if( n == 0 || nc == 0 )
+        return 3.0;
+
+    // nets created on the fly may have no precomputed values
+    vector<double> tmp_re, tmp_im;
+    const double* re;
+    const double* im;
+    size_t offset = nr.nums_begin - numbers.begin();
+    if( numbers_re.size() == numbers.size() )
     {
-        double iim, ire;
-        i->toComplex( denominator_exponent, ire, iim );
-        for( auto j = nr.nums_compl_begin; j != nr.nums_compl_end; ++j )
-        {
-            double jim, jre;
-            j->toComplex( denominator_exponent, jre, jim  );
-            double d1 = dist_squared( vec, ire, iim, jre, jim );
-            double d2 = dist_squared( vec, jre, jim, ire, iim );
-
-            if( d1 < best )
-            {
-                best = d1;
-                ic = i; jc = j;
-                tw = false;
-            }
-
-            if( d2 < best )
-            {
-                best = d2;
-                ic = i; jc = j;
-                tw = true;
-            }
-        }
+        re = numbers_re.data() + offset;
+        im = numbers_im.data() + offset;
+    }
+    else
+    {
+        tmp_re.resize( n + nc );
+        tmp_im.resize( n + nc );
+        for( size_t k = 0; k < n + nc; ++k )
+            nr.nums_begin[k].toComplex( denominator_exponent, tmp_re[k], tmp_im[k] );
+        re = tmp_re.data();
+        im = tmp_im.data();
     }
 
-    if( tw )
+    // Distance from vec to (x,y) is |vec.first - x|^2 + |vec.second - y|^2, so instead of
+    // checking all pairs from the node we look for the best x and the best y separately.
+    // The pair is either (x,y) or (y,x) with x a number and y a complementary number.
+    size_t ix1, iy1, ix2, iy2;
+    double dx1, dy1, dx2, dy2;
+    closestNumbers( re, im, n, vec.first, ix1, dx1, vec.second, ix2, dx2 );
+    closestNumbers( re + n, im + n, nc, vec.second, iy1, dy1, vec.first, iy2, dy2 );
+
+    double d1 = dx1 + dy1;
+    double d2 = dx2 + dy2;
+    // on a tie prefer the pair met first by the search over all pairs
+    if( d1 < d2 || ( d1 == d2 && make_pair( ix1, iy1 ) <= make_pair( ix2, iy2 ) ) )
     {
-        result.d[0] = *jc;
-        result.d[1] = *ic;
-        //result.de = denominator_exponent; // -avoid extra operations
+        first = nr.nums_begin + ix1;
+        second = nr.nums_compl_begin + iy1;
+        return d1;
     }
-    else
+    first = nr.nums_compl_begin + iy2;
+    second = nr.nums_begin + ix2;
+    return d2;
+}
+
+double epsilonnet::findExhaustiveApproximation(const epsilonnet::vector2double &vec, epsilonnet::vi &result, int node_id) const
+{
+    const ri* first = 0;
+    const ri* second = 0;
+    double best = findInNode( vec, node_id, first, second );
+    if( first )
     {
-        result.d[0] = *ic;
-        result.d[1] = *jc;
+        result.d[0] = *first;
+        result.d[1] = *second;
         //result.de = denominator_exponent; // -avoid extra operations
     }
-
     return best;
 }
 
 double epsilonnet::findExhaustiveApproximation(const epsilonnet::vector2double &vec, epsilonnet::vi &result, int node_id, double &bdist) const
 {
-    nodeRanges nr;
-    getNode( node_id, nr );
-    bool found = false;
-    auto ic = nr.nums_begin;
-    auto jc = nr.nums_compl_begin;
-    bool tw = true;
-    for( auto i = nr.nums_begin; i != nr.nums_end ;++i )
+    const ri* first = 0;
+    const ri* second = 0;
+    double best = findInNode( vec, node_id, first, second );
+    if( first && best < bdist )
     {
-        double iim, ire;
-        i->toComplex( denominator_exponent, ire, iim );
-        for( auto j = nr.nums_compl_begin; j != nr.nums_compl_end; ++j )
-        {
-            double jim, jre;
-            j->toComplex( denominator_exponent, jre, jim  );
-            double d1 = dist_squared( vec, ire, iim, jre, jim );
-            double d2 = dist_squared( vec, jre, jim, ire, iim );
-
-            if( d1 < bdist )
-            {
-                found = true;
-                bdist = d1;
-                ic = i; jc = j;
-                tw = false;
-            }
-
-            if( d2 < bdist )
-            {
-                found = true;
-                bdist = d2;
-                ic = i; jc = j;
-                tw = true;
-            }
-        }
+        bdist = best;
+        result.d[0] = *first;
+        result.d[1] = *second;
+        result.de = denominator_exponent;
     }
-
-    if( found )
-    {
-        if( tw )
-        {
-            result.d[0] = *jc;
-            result.d[1] = *ic;
-            result.de = denominator_exponent;
-        }
-        else
-        {
-            result.d[0] = *ic;
-            result.d[1] = *jc;
-            result.de = denominator_exponent;
-        }
-    }
-
     return bdist;
 }
 
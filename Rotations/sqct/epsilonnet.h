@@ -21,6 +21,7 @@
 
 #include "rint.h"
 #include "vector2.h"
+#include "podfile.h"
 #include <vector>
 
 /// \brief Node of epsilon net
@@ -45,7 +46,7 @@ struct nodeRanges
     /// \brief Type of the ring elements
     typedef ring_int<int> ri;
     /// \brief Type of ranges iterator
-    typedef std::vector<ri>::const_iterator cit;
+    typedef const ri* cit;
 
     /// \brief First element of numbers range
     cit nums_begin;
@@ -95,7 +96,8 @@ public:
 
     /// \brief Number of nodes in file
     size_t nodesCount (const char* filename) const;
-    /// \brief Loads epsilon net from file
+    /// \brief Loads epsilon net from file. Files in the current format are memory mapped and used in place,
+    /// files written by older versions are read into memory
     bool loadFromFile(const char* filename);
     /// \brief Saves epsilon net to file
     void saveToFile  (const char* filename) const;
@@ -124,11 +126,19 @@ public:
     double findExhaustiveApproximation( const vector2double& vec, vi& result ) const;
 
     /// \brief Vector of epsilon node
-    std::vector<enetNode>  nodes;
+    podArray<enetNode>     nodes;
     /// \brief Vector of numbers that appears in epsilon net
-    std::vector<ri>        numbers;
+    podArray<ri>           numbers;
     /// \brief Denominator exponent of epsilon net elements
     int                    denominator_exponent;
+    /// \brief Real parts of numbers, \see precomputeComplex
+    std::vector<double>    numbers_re;
+    /// \brief Imaginary parts of numbers, \see precomputeComplex
+    std::vector<double>    numbers_im;
+
+    /// \brief Fills numbers_re and numbers_im using denominator_exponent. Called by loadFromFile;
+    /// nets created on the fly can be searched without it, but slower
+    void precomputeComplex();
 
     /// \brief Finds exhaustive approximation within fixed node
     double findExhaustiveApproximation( const vector2double& vec, vi& result, int node_id ) const;
@@ -136,6 +146,12 @@ public:
     /// Do nothing otherwise. Useful to reduce amount of copy operations
     double findExhaustiveApproximation( const vector2double& vec, vi& result, int node_id, double& bdist ) const;
 
+private:
+    /// \brief Finds the pair of numbers from the node closest to vec
+    /// \param first, second Receive the pair, stay unchanged if the node is empty
+    /// \returns Euclidean distance squared from vec to the pair
+    double findInNode( const vector2double& vec, int node_id, const ri*& first, const ri*& second ) const;
+
 };
 
 
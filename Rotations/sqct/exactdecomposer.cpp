@@ -35,17 +35,65 @@ exactDecomposer::exactDecomposer()
     }
 }
 
-void exactDecomposer::decompose( const matrix2x2<mpz_class>& matr, circuit& c)
+/// \brief Bound on absolute values of integer coefficients of the matrix for which
+/// one step of the decomposition can be done in long without overflow
+static const long fast_range = 1L << 60;
+
+/// \brief True if next step of the decomposition of m may overflow
+static bool mayOverflow( const matrix2x2<long>& m )
 {
-    typedef ring_int< resring<8> > rr8;
-    typedef matrix2x2< resring<8> > mrr8;
+    for( int i = 0; i < 2; ++i )
+        for( int j = 0; j < 2; ++j )
+            for( int k = 0; k < 4; ++k )
+                if( m.d[i][j][k] >= fast_range || m.d[i][j][k] <= -fast_range )
+                    return true;
+    return false;
+}
+
+/// \brief Decomposition in mpz_class never overflows
+static bool mayOverflow( const matrix2x2<mpz_class>& )
+{
+    return false;
+}
+
+/// \brief True if m can be decomposed in long
+static bool fitsLong( const matrix2x2<mpz_class>& m )
+{
+    for( int i = 0; i < 2; ++i )
+        for( int j = 0; j < 2; ++j )
+            for( int k = 0; k < 4; ++k )
+                if( abs( m.d[i][j][k] ) >= fast_range )
+                    return false;
+    return true;
+}
 
+void exactDecomposer::decompose( const matrix2x2<mpz_class>& matr, circuit& c)
+{
     c.clear();
     M current(matr);
     current.reduce();
-    M t;
-
     int curr_sde = current.max_sde_abs2();
+
+    // Coefficients of the matrix fit into long for typical precisions. We switch to mpz_class
+    // only if they get out of range, mpz_class arithmetic allocates memory on every operation
+    if( fitsLong( current ) )
+    {
+        matrix2x2<long> current_l( current );
+        if( decompose( current_l, curr_sde, c ) )
+            return;
+        current = M( current_l );
+    }
+    decompose( current, curr_sde, c );
+}
+
+template< class TInt >
+bool exactDecomposer::decompose( matrix2x2<TInt>& current, int& curr_sde, circuit& c )
+{
+    typedef ring_int< resring<8> > rr8;
+    typedef matrix2x2< resring<8> > mrr8;
+
+    matrix2x2<TInt> t;
+
     while( curr_sde > 3 )
     {
         bool found = false;
@@ -75,10 +123,13 @@ void exactDecomposer::decompose( const matrix2x2<mpz_class>& matr, circuit& c)
                 break;
             }
         }
-        if( !found ) return;
+        if( !found ) return true;
+        if( curr_sde > 3 && mayOverflow( current ) )
+            return false;
     }
 
     circuit r;
     slC.find(current,r);
     c.push_back(r);
+    return true;
 }
@@ -32,6 +32,11 @@ public:
     /// \brief Decomposes matr into circuit c
     void decompose( const matrix2x2<mpz_class> &matr, circuit& c );
 private:
+    /// \brief Runs the decomposition loop on current, which has \f$ sde(|\cdot|^2) \f$ equal to curr_sde.
+    /// \returns False if current got too large for TInt, then current and curr_sde describe the
+    /// remaining part of the matrix and c contains gates found so far
+    template< class TInt >
+    bool decompose( matrix2x2<TInt>& current, int& curr_sde, circuit& c );
     /// \brief Matrix over the ring type used during decomposition
     typedef matrix2x2<mpz_class> M;
     /// \brief Ring type used during decomposition
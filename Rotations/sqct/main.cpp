@@ -460,6 +460,7 @@ struct enetApplication
         {
             if( m_layers[i] == 0 )
             {
+                cerr << "Generating epsilon net layer " << i << " of " << end - 1 << endl;
                 epsilonnet base_net;
                 base_net.loadFromFile( netGenerator::fileName(i-1).c_str() );
                 unique_ptr<epsilonnet> res( netGenerator::generate( base_net ) );
@@ -469,6 +469,8 @@ template matrix2x2<long>::matrix2x2( const matrix2x2<mpz_class>& );
 template matrix2x2<mpz_class>::matrix2x2( const matrix2x2<int>& );
 template matrix2x2<mpz_class>::matrix2x2( const matrix2x2<long>& );
 template matrix2x2< resring<8> >::matrix2x2( const matrix2x2<mpz_class>& );
+template matrix2x2<int>::matrix2x2( const matrix2x2<long>& );
+template matrix2x2< resring<8> >::matrix2x2( const matrix2x2<long>& );
 
 //////////////// Helper functions //////////////////////
 
@@ -27,9 +27,26 @@
 #include <sstream>
 #include <functional>
 #include <cassert>
+#include <iostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+static int omp_get_max_threads() { return 1; }
+static int omp_get_thread_num() { return 0; }
+#endif
 
 using namespace std;
 
+/// \brief Node of initial epsilon net layers computed by generateInitial before it is added to its layer
+struct initialNode
+{
+    /// \brief Layer of the node, -1 if there is no node for given P(x),Q(x)
+    int sde;
+    /// \brief Canonical numbers and complementary numbers, sorted
+    vector< ring_int<int> > v, vc;
+};
+
 void netGenerator::generateInitial()
 {
     typedef ring_int<int> ri;
@@ -40,37 +57,67 @@ void netGenerator::generateInitial()
 
     epsilonnet enets[ ng.max_sde + 1 ];
 
-    for( int i = 0; i < ng.ip_range; ++i )
-    for( int j = 0; j < ng.max_val2 + 1; ++j )
+    // Rows of the (i,j) grid are processed in blocks: nodes of a block are computed
+    // in parallel and then added to epsilon nets in the sequential order, so the files
+    // do not depend on the number of threads
+    const int rows_in_block = 32;
+    const int cols = ng.max_val2 + 1;
+    vector< initialNode > block( rows_in_block * cols );
+
+    for( int i0 = 0; i0 < ng.ip_range; i0 += rows_in_block )
     {
-        const auto& vec = ng.numbers(i,j);
-        const auto& vec_compl = ng.numbers( ng.max_val2 - i, -j);
+        int rows = std::min( rows_in_block, ng.ip_range - i0 );
 
-        if( (!vec.empty() ) && (!vec_compl.empty() ))
+        #pragma omp parallel for schedule(dynamic,16)
+        for( int k = 0; k < rows * cols; ++k )
         {
-            int s = std::min ( ng.getSde(i,j), ng.getSde(ng.max_val2 - i, -j) );
-            int de = ng.max_sde / 2  - (s + 1 ) / 2;
+            int i = i0 + k / cols;
+            int j = k % cols;
+            initialNode& node = block[k];
+            node.sde = -1;
+            node.v.clear();
+            node.vc.clear();
 
-            vector<ri> v;
-            vector<ri> vc;
+            const auto& vec = ng.numbers(i,j);
+            const auto& vec_compl = ng.numbers( ng.max_val2 - i, -j);
 
-            // normalize denominator and pick canonical representatives
-            for( auto ii : vec )
+            if( (!vec.empty() ) && (!vec_compl.empty() ))
             {
-                v.push_back( ii.canonical() );
-                v.back().div_eq_sqrt2( de );
-            }
+                int s = std::min ( ng.getSde(i,j), ng.getSde(ng.max_val2 - i, -j) );
+                int de = ng.max_sde / 2  - (s + 1 ) / 2;
 
-            for( auto ii : vec_compl )
-            {
-                vc.push_back( ii.canonical() );
-                vc.back().div_eq_sqrt2( de );
+                // normalize denominator and pick canonical representatives
+                for( auto ii : vec )
+                {
+                    node.v.push_back( ii.canonical() );
+                    node.v.back().div_eq_sqrt2( de );
+                }
+
+                for( auto ii : vec_compl )
+                {
+                    node.vc.push_back( ii.canonical() );
+                    node.vc.back().div_eq_sqrt2( de );
+                }
+                // sort to leave only unique elements
+                sort( node.v.begin(), node.v.end() );
+                sort( node.vc.begin(), node.vc.end() );
+                node.sde = s;
             }
-            // sort to leave only unique elements
-            sort( v.begin(), v.end() );
-            sort( vc.begin(), vc.end() );
+        }
+
+        for( int k = 0; k < rows * cols; ++k )
+        {
+            const initialNode& node = block[k];
+            if( node.sde < 0 )
+                continue;
+            int i = i0 + k / cols;
+            int j = k % cols;
+            int s = node.sde;
+            int de = ng.max_sde / 2  - (s + 1 ) / 2;
+            const vector<ri>& v = node.v;
+            const vector<ri>& vc = node.vc;
 
-            nodeRanges nr = {v.begin(),v.end(),vc.begin(), vc.end() };
+            nodeRanges nr = {v.data(),v.data() + v.size(),vc.data(), vc.data() + vc.size() };
             assert( ( (i >> de) << de ) == i );
             assert( ( (j >> de) << de ) == j );
             // in the case when ipQxx = 0 we only add numbers such that ipxx <= ng.max_val2 / 2
@@ -78,7 +125,11 @@ void netGenerator::generateInitial()
             if( ( j != 0 ) || ( (j == 0) && (i <= ng.max_val2 / 2) ) )
                 enets[s].addNode(i >> de ,j >> de ,nr);
         }
+
+        cerr << "\rGenerating initial epsilon net layers: "
+             << ( i0 + rows ) * 100 / ng.ip_range << "%" << flush;
     }
+    cerr << endl;
 
     for( int i = 0; i <= ng.max_sde; ++i )
     {
@@ -204,15 +255,19 @@ struct generation_data
             ips.push_back( {{pow2n - ipxx,-ipQxx},ac.canonical(),a.canonical()} );
     }
 
-    /// \brief Builds epsilon net from computed data
+    /// \brief Adds pointers to numbers found by part to order, part must outlive this object
+    void collect( const generation_data& part )
+    {
+        for( const auto& g : part.ips )
+            order.push_back( &g );
+    }
+
+    /// \brief Builds epsilon net from computed data collected by collect()
     epsilonnet* build_net()
     {
 
         epsilonnet* enet = new epsilonnet;
-        order.resize( ips.size() );
         int sz = order.size();
-        for( int i = 0; i < sz; ++i )
-            order[i] = & ips[i];
 
         gdata_comparator gcomp;
         /// \todo This sort can be avoided with a bit more clever algorithm
@@ -259,11 +314,16 @@ struct generation_data
 
 epsilonnet* netGenerator::generate(const epsilonnet& enet)
 {
-    generation_data gdata( enet.sde(), enet.denominatorExponent2() );
-
-    for( int i = 0; i < enet.nodes.size() - 1; ++i )
+    // Each thread collects numbers into its own part. The resulting net does not
+    // depend on the order of numbers, because build_net sorts them
+    vector< generation_data > parts( omp_get_max_threads(),
+                                     generation_data( enet.sde(), enet.denominatorExponent2() ) );
+    int sz = enet.nodes.size() - 1;
+
+    #pragma omp parallel for schedule(dynamic,64)
+    for( int i = 0; i < sz; ++i )
     {
-        const enetNode& node = enet.nodes[i];
+        generation_data& gdata = parts[ omp_get_thread_num() ];
 
         nodeRanges r;
         enet.getNode( i, r );
@@ -271,7 +331,6 @@ epsilonnet* netGenerator::generate(const epsilonnet& enet)
         for( auto i1 = r.nums_begin; i1 != r.nums_end; ++i1 )
         {
             const ri& x = *i1;
-            ri x_c = x.conjugate();
 
             for( auto i2 = r.nums_compl_begin; i2 != r.nums_compl_end; ++i2 )
             {
@@ -286,5 +345,8 @@ epsilonnet* netGenerator::generate(const epsilonnet& enet)
         }
     }
 
+    generation_data& gdata = parts[0];
+    for( const auto& part : parts )
+        gdata.collect( part );
     return gdata.build_net();
 }
@@ -18,6 +18,7 @@
 
 #include "numbersgen.h"
 #include <cassert>
+#include <cmath>
 
 static const int sde_not_computed = -1;
 
@@ -38,8 +39,9 @@ bool numbersGenerator<de>::isInRange(int ipxx, int ipQxx) const
 }
 
 template< int de >
-void numbersGenerator<de>::add_number( int a, int b , int c, int d, int ipxx )
+int numbersGenerator<de>::add_number( int a, int b , int c, int d, int ipxx )
 {
+    int added = 0;
     int m1 = ( a == 0 ? 1 : 2 );
     int m2 = ( b == 0 ? 1 : 2 );
     int m3 = ( c == 0 ? 1 : 2 );
@@ -67,37 +69,48 @@ void numbersGenerator<de>::add_number( int a, int b , int c, int d, int ipxx )
                             sdes[ ipxx ][ ipQxx + ipQ_offset ]
                                     = sde( 2 * denom_exp,  abs2x.gde() );
                         vals[ ipxx ][ ipQxx + ipQ_offset ].push_back( x );
-                        m_total_numbers++;
+                        added++;
                     }
                 }
+    return added;
 }
 
 template< int de >
 void numbersGenerator<de>::generate_all_numbers()
 {
-    for( int i1 = 0; i1 <= max_val; ++i1 )
+    int total = 0;
+    // Every number with P(x) = ipxx only touches vals[ipxx] and sdes[ipxx], so rows
+    // are generated independently. Within a row (i1,i2,i3,i4) are visited in lexicographic
+    // order, as in the sequential version, so the output does not depend on the number of threads.
+    #pragma omp parallel for schedule(dynamic) reduction(+:total)
+    for( int ipxx = 0; ipxx <= max_val2; ++ipxx )
     {
-        int ipxx1 = i1 * i1;
-        for( int i2 = 0; i2 <= max_val; ++i2 )
+        for( int i1 = 0; i1 <= max_val; ++i1 )
         {
-            int ipxx2 = ipxx1 + i2 * i2;
-            if( ipxx2 > max_val2 )
+            int ipxx1 = i1 * i1;
+            if( ipxx1 > ipxx )
                 break;
-            for( int i3 = 0; i3 <= max_val; ++i3 )
+            for( int i2 = 0; i2 <= max_val; ++i2 )
             {
-                int ipxx3 = ipxx2 + i3 * i3;
-                if( ipxx3 > max_val2 )
+                int ipxx2 = ipxx1 + i2 * i2;
+                if( ipxx2 > ipxx )
                     break;
-                for( int i4 = 0; i4 <= max_val; ++i4 )
+                for( int i3 = 0; i3 <= max_val; ++i3 )
                 {
-                    int ipxx4 = ipxx3 + i4 * i4;
-                    if( ipxx4 > max_val2 )
+                    int ipxx3 = ipxx2 + i3 * i3;
+                    if( ipxx3 > ipxx )
                         break;
-                    add_number( i1, i2, i3, i4, ipxx4 );
+                    int rest = ipxx - ipxx3;
+                    int i4 = (int) std::sqrt( (double) rest );
+                    while( i4 * i4 > rest ) --i4;
+                    while( ( i4 + 1 ) * ( i4 + 1 ) <= rest ) ++i4;
+                    if( i4 * i4 == rest && i4 <= max_val )
+                        total += add_number( i1, i2, i3, i4, ipxx );
                 }
             }
         }
     }
+    m_total_numbers += total;
 }
 
 template< int de >
@@ -52,6 +52,7 @@ public:
     /// \li \f$ \left|\frac{x}{\sqrt{2}^n}\right|^2 \le 1 \f$
     ///
     /// See Section 5 of http://arxiv.org/abs/1206.5236 for definitions of P(x) and Q(x).
+    /// \note Uses all OpenMP threads, the result is the same as for one thread
     void generate_all_numbers();
 
     /// \brief Returns vector containing
@@ -97,8 +98,8 @@ protected:
     /// \brief How many numbers were generated
     int m_total_numbers;
 private:
-    /// \brief Adds nuber to collection of found numbers
-    void add_number( int a, int b , int c, int d, int ipxx );
+    /// \brief Adds nuber to collection of found numbers, returns how many numbers were added
+    int add_number( int a, int b , int c, int d, int ipxx );
     /// \brief Initializes arrays
     void init();
     /// \brief Verifies if P(x) and Q(x) are in valid range
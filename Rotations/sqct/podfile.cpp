@@ -0,0 +1,116 @@
+//     Versioned files of flat POD arrays, see podfile.h
+//     This file uses SQCT, Copyright (c) 2012 Vadym Kliuchnikov, Dmitri Maslov, Michele Mosca;
+//     SQCT is distributed under LGPL v3
+//
+
+#include "podfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char podFileMagic[8] = "SQCTPOD";
+
+shared_ptr<const mappedFile> mappedFile::open(const char* filename)
+{
+    int fd = ::open( filename, O_RDONLY );
+    if( fd < 0 )
+        return shared_ptr<const mappedFile>();
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+    {
+        close( fd );
+        return shared_ptr<const mappedFile>();
+    }
+    // MAP_SHARED lets all decomposer processes use the same page cache copy
+    void* p = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( p == MAP_FAILED )
+        return shared_ptr<const mappedFile>();
+    return shared_ptr<const mappedFile>( new mappedFile( (const char*) p, st.st_size ) );
+}
+
+mappedFile::~mappedFile()
+{
+    munmap( (void*) m_data, m_size );
+}
+
+static uint64_t alignUp( uint64_t offset )
+{
+    return ( offset + podFileAlignment - 1 ) / podFileAlignment * podFileAlignment;
+}
+
+bool savePodFile(const char* filename, podFileKind kind, const podFileData* arrays, int count)
+{
+    if( count < 0 || count > 2 )
+        return false;
+
+    podFileHeader h;
+    memset( &h, 0, sizeof(h) );
+    memcpy( h.magic, podFileMagic, sizeof(h.magic) );
+    h.version = podFileVersion;
+    h.byte_order = podFileByteOrder;
+    h.kind = kind;
+    h.sections = count;
+    uint64_t offset = alignUp( sizeof(h) );
+    for( int i = 0; i < count; ++i )
+    {
+        h.section[i].offset = offset;
+        h.section[i].count = arrays[i].count;
+        h.section[i].elem_size = arrays[i].elem_size;
+        offset = alignUp( offset + arrays[i].count * arrays[i].elem_size );
+    }
+
+    stringstream tmpname;
+    tmpname << filename << ".tmp." << getpid();
+    {
+        ofstream ofs( tmpname.str().c_str(), ios_base::binary );
+        if( !ofs )
+            return false;
+        static const char zeros[podFileAlignment] = {0};
+        ofs.write( (const char*) &h, sizeof(h) );
+        uint64_t written = sizeof(h);
+        for( int i = 0; i < count; ++i )
+        {
+            ofs.write( zeros, h.section[i].offset - written );
+            ofs.write( (const char*) arrays[i].data, arrays[i].count * arrays[i].elem_size );
+            written = h.section[i].offset + arrays[i].count * arrays[i].elem_size;
+        }
+        ofs.close();
+        if( !ofs )
+        {
+            remove( tmpname.str().c_str() );
+            return false;
+        }
+    }
+    if( rename( tmpname.str().c_str(), filename ) != 0 )
+    {
+        remove( tmpname.str().c_str() );
+        return false;
+    }
+    return true;
+}
+
+shared_ptr<const mappedFile> openPodFile(const char* filename, podFileKind kind, podFileHeader& header)
+{
+    shared_ptr<const mappedFile> file = mappedFile::open( filename );
+    if( !file || file->size() < sizeof(header) )
+        return shared_ptr<const mappedFile>();
+    memcpy( &header, file->data(), sizeof(header) );
+    if( memcmp( header.magic, podFileMagic, sizeof(header.magic) ) != 0 ||
+        header.version != podFileVersion ||
+        header.byte_order != podFileByteOrder ||
+        header.kind != (uint32_t) kind ||
+        header.sections > 2 )
+        return shared_ptr<const mappedFile>();
+    return file;
+}
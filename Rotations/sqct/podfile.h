@@ -0,0 +1,154 @@
+//     Versioned files of flat POD arrays that are used in place through a
+//     read-only memory mapping (epsilon-net layers and the approximation index)
+//     This file uses SQCT, Copyright (c) 2012 Vadym Kliuchnikov, Dmitri Maslov, Michele Mosca;
+//     SQCT is distributed under LGPL v3
+//
+
+#ifndef PODFILE_H
+#define PODFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// \brief Bumped whenever layout of podFileHeader or of any stored structure changes
+const uint32_t podFileVersion = 1;
+
+/// \brief Contents of a pod file, stored in podFileHeader::kind
+enum podFileKind
+{
+    podEpsilonNet = 1, ///< enetNode array followed by ring_int<int> array
+    podIndex = 2       ///< index_node array
+};
+
+/// \brief Location of one array in a pod file
+struct podFileSection
+{
+    uint64_t offset;    ///< Offset of the first element from the beginning of the file
+    uint64_t count;     ///< Number of elements
+    uint32_t elem_size; ///< sizeof of the element type of the writer
+    uint32_t reserved;
+};
+
+/// \brief Header at the beginning of a pod file
+/// \note Arrays are aligned to podFileAlignment, so that they can be used directly from the mapping
+struct podFileHeader
+{
+    char     magic[8];   ///< "SQCTPOD" and a terminating zero
+    uint32_t version;    ///< podFileVersion of the writer
+    uint32_t byte_order; ///< podFileByteOrder as written by the writer
+    uint32_t kind;       ///< \see podFileKind
+    uint32_t sections;   ///< Number of used entries of section
+    podFileSection section[2];
+};
+
+const uint32_t podFileByteOrder = 0x01020304;
+const size_t podFileAlignment = 64;
+
+/// \brief Read-only shared mapping of a whole file
+class mappedFile
+{
+public:
+    /// \brief Maps file, returns null pointer if it can not be opened or mapped
+    static std::shared_ptr<const mappedFile> open( const char* filename );
+    ~mappedFile();
+    /// \brief Beginning of the mapping
+    const char* data() const { return m_data; }
+    /// \brief Size of the file in bytes
+    size_t size() const { return m_size; }
+private:
+    mappedFile( const char* data, size_t size ) : m_data(data), m_size(size) {}
+    mappedFile( const mappedFile& );
+    mappedFile& operator=( const mappedFile& );
+    const char* m_data;
+    size_t m_size;
+};
+
+/// \brief Array that is either owned or lives in a mappedFile.
+/// Read access is the same in both cases; modification of a mapped array copies it first.
+template< class T >
+class podArray
+{
+public:
+    typedef T value_type;
+    typedef const T* const_iterator;
+
+    podArray() : m_mapped(0), m_mapped_size(0) {}
+
+    size_t size() const { return m_file ? m_mapped_size : m_owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T* begin() const { return m_file ? m_mapped : m_owned.data(); }
+    const T* end() const { return begin() + size(); }
+    const T& operator[]( size_t i ) const { return begin()[i]; }
+    const T& back() const { return end()[-1]; }
+
+    T& back() { return modifiable().back(); }
+    void push_back( const T& val ) { modifiable().push_back(val); }
+    void reserve( size_t n ) { modifiable().reserve(n); }
+    void clear() { m_file.reset(); m_owned.clear(); }
+
+    /// \brief Owned copy of the array that can be changed freely
+    std::vector<T>& modifiable()
+    {
+        if( m_file )
+        {
+            m_owned.assign( m_mapped, m_mapped + m_mapped_size );
+            m_file.reset();
+        }
+        return m_owned;
+    }
+
+    /// \brief Uses count elements at data that stays valid while file is alive
+    void assign( const std::shared_ptr<const mappedFile>& file, const T* data, size_t count )
+    {
+        m_owned.clear();
+        m_file = file;
+        m_mapped = data;
+        m_mapped_size = count;
+    }
+
+    /// \brief True if array lives in a mapped file
+    bool isMapped() const { return (bool)m_file; }
+
+private:
+    std::vector<T> m_owned;
+    std::shared_ptr<const mappedFile> m_file;
+    const T* m_mapped;
+    size_t m_mapped_size;
+};
+
+/// \brief Array to be written by savePodFile
+struct podFileData
+{
+    const void* data;
+    uint64_t count;
+    uint32_t elem_size;
+};
+
+/// \brief Writes arrays into filename.
+/// The file is written under a temporary name and renamed, so that processes that
+/// have the old file mapped are not affected.
+bool savePodFile( const char* filename, podFileKind kind, const podFileData* arrays, int count );
+
+/// \brief Maps filename if it is a pod file of given kind and current version
+/// \param header Receives header of the file
+/// \returns Null pointer if file can not be mapped or its header does not match
+std::shared_ptr<const mappedFile> openPodFile( const char* filename, podFileKind kind, podFileHeader& header );
+
+/// \brief Checks that section i of a mapped pod file holds elements of type T and points array to it
+template< class T >
+bool podSection( const std::shared_ptr<const mappedFile>& file, const podFileHeader& header, uint32_t i, podArray<T>& array )
+{
+    if( i >= header.sections )
+        return false;
+    const podFileSection& s = header.section[i];
+    if( s.elem_size != sizeof(T) || s.offset % podFileAlignment != 0 )
+        return false;
+    if( s.offset > file->size() || s.count > ( file->size() - s.offset ) / sizeof(T) )
+        return false;
+    array.assign( file, (const T*)( file->data() + s.offset ), s.count );
+    return true;
+}
+
+#endif // PODFILE_H
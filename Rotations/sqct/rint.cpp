@@ -740,3 +740,5 @@ template ring_int<long int>::ring_int( const ring_int<mpz_class>& val );
 template ring_int<mpz_class>::ring_int( const ring_int<int>& val );
 template ring_int<mpz_class>::ring_int( const ring_int<long int>& val );
 template ring_int< resring<8> >::ring_int( const ring_int<mpz_class>& val );
+template ring_int<int>::ring_int( const ring_int<long int>& val );
+template ring_int< resring<8> >::ring_int( const ring_int<long int>& val );
@@ -0,0 +1,292 @@
+//     Throughput and quality benchmark of the rotation decomposers used by the
+//     Rotations pass: sqct (SKDecompose) at several levels and the gridsynth
+//     binary at several precisions.
+//
+//     Angles are read from DecomposeRotation_* names on standard input, e.g.
+//       grep -rhoE 'DecomposeRotation[XY]?_[n0-9_e]+' ../../LPFS_Scheds | ./rotbench
+//     (see 'make bench'). The distinct angles are sorted and a seeded shuffle
+//     picks the corpus, so a given input, count and seed always give the same
+//     angles. For every decomposer and precision the whole corpus is timed and
+//     angles/sec, T-count and the trace distance to the rotation are reported.
+//
+//     This file uses SQCT, Copyright (c) 2012 Vadym Kliuchnikov, Dmitri Maslov, Michele Mosca;
+//     SQCT is distributed under LGPL v3
+//
+
+#include "skdecomposer.h"
+#include "eapp.h"
+#include "../../llvm/include/llvm/Transforms/Scaffold/RotationDistance.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief A rotation of the corpus
+struct benchAngle
+{
+    char axis;          ///< 'X', 'Y' or 'Z'
+    double angle;       ///< radians
+    bool operator<( const benchAngle& o ) const
+    {
+        return axis != o.axis ? axis < o.axis : angle < o.angle;
+    }
+};
+
+/// \brief Results of one decomposer at one precision over the corpus
+struct benchResult
+{
+    string decomposer;
+    string precision;
+    int angles;
+    int failed;
+    double seconds;
+    double tcount;      ///< sum over angles
+    int tmax;
+    double error;       ///< sum over angles
+    double errmax;
+    benchResult() : angles(0), failed(0), seconds(0), tcount(0), tmax(0), error(0), errmax(0) {}
+
+    void add( int t, double e )
+    {
+        angles++;
+        tcount += t;
+        tmax = max( tmax, t );
+        error += e;
+        errmax = max( errmax, e );
+    }
+};
+
+/// \brief Parses the angle of a DecomposeRotation[XY]_<angle> name, where the
+/// angle was printed with %e and '-' became 'n', '.' became '_' and '+' was dropped
+static bool parseName( const string& name, benchAngle& a )
+{
+    static const string prefix = "DecomposeRotation";
+    if( name.compare( 0, prefix.size(), prefix ) != 0 )
+        return false;
+    size_t i = prefix.size();
+    a.axis = 'Z';
+    if( i < name.size() && ( name[i] == 'X' || name[i] == 'Y' ) )
+        a.axis = name[i++];
+    if( i >= name.size() || name[i++] != '_' )
+        return false;
+    string num;
+    for( ; i < name.size(); ++i )
+    {
+        char c = name[i];
+        if( c == 'n' ) num += '-';
+        else if( c == '_' ) num += '.';
+        else num += c;
+    }
+    char* end = 0;
+    a.angle = strtod( num.c_str(), &end );
+    return !num.empty() && *end == 0;
+}
+
+/// \brief Every DecomposeRotation name on the stream, in any surrounding text
+static set<benchAngle> readAngles( istream& in )
+{
+    set<benchAngle> res;
+    string line;
+    while( getline( in, line ) )
+    {
+        size_t pos = 0;
+        while( ( pos = line.find( "DecomposeRotation", pos ) ) != string::npos )
+        {
+            size_t end = pos;
+            while( end < line.size() && ( isalnum( line[end] ) || line[end] == '_' ) )
+                ++end;
+            benchAngle a;
+            if( parseName( line.substr( pos, end - pos ), a ) )
+                res.insert( a );
+            pos = end;
+        }
+    }
+    return res;
+}
+
+/// \brief Fisher-Yates shuffle driven by mt19937 alone, so that the corpus
+/// does not depend on the standard library's distributions
+static vector<benchAngle> pickCorpus( const set<benchAngle>& all, size_t count, uint32_t seed )
+{
+    vector<benchAngle> v( all.begin(), all.end() );
+    mt19937 gen( seed );
+    for( size_t i = v.size(); i > 1; --i )
+        swap( v[i - 1], v[ gen() % i ] );
+    if( v.size() > count )
+        v.resize( count );
+    return v;
+}
+
+static int countT( const string& gates )
+{
+    return count( gates.begin(), gates.end(), 'T' ) + count( gates.begin(), gates.end(), 't' );
+}
+
+static vector<int> parseList( const char* s )
+{
+    vector<int> res;
+    stringstream ss( s );
+    string item;
+    while( getline( ss, item, ',' ) )
+        if( !item.empty() )
+            res.push_back( atoi( item.c_str() ) );
+    return res;
+}
+
+static double secondsSince( chrono::steady_clock::time_point start )
+{
+    return chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+}
+
+static benchResult benchSqct( SKDecompose& sk, const vector<benchAngle>& corpus, int level )
+{
+    benchResult r;
+    r.decomposer = "sqct";
+    r.precision = "level " + to_string( level );
+    auto start = chrono::steady_clock::now();
+    for( const benchAngle& a : corpus )
+    {
+        switch( a.axis )
+        {
+        case 'X': sk.rotX( a.angle, level ); break;
+        case 'Y': sk.rotY( a.angle, level ); break;
+        default:  sk.rotZ( a.angle, level ); break;
+        }
+        r.add( sk.tCount(), sk.distance() );
+    }
+    r.seconds = secondsSince( start );
+    return r;
+}
+
+/// \brief Runs gridsynth the way the Rotations pass does, one process per
+/// angle. gridsynth only synthesizes Z rotations, so every angle is taken
+/// as one.
+static benchResult benchGridsynth( const string& path, const vector<benchAngle>& corpus, int digits )
+{
+    benchResult r;
+    r.decomposer = "gridsynth";
+    r.precision = "-d " + to_string( digits );
+    auto start = chrono::steady_clock::now();
+    for( const benchAngle& a : corpus )
+    {
+        ostringstream cmd;
+        cmd << path << " \"(" << fixed << a.angle << ")\" -d " << digits;
+        string out;
+        FILE* pipe = popen( cmd.str().c_str(), "r" );
+        if( pipe )
+        {
+            char buf[4096];
+            size_t n;
+            while( ( n = fread( buf, 1, sizeof( buf ), pipe ) ) > 0 )
+                out.append( buf, n );
+        }
+        if( !pipe || pclose( pipe ) != 0 )
+        {
+            r.failed++;
+            continue;
+        }
+        r.add( countT( out ), rotdist::traceDistance( 'Z', a.angle, out ) );
+    }
+    r.seconds = secondsSince( start );
+    return r;
+}
+
+static void printResult( const benchResult& r )
+{
+    cout << left << setw( 10 ) << r.decomposer << setw( 10 ) << r.precision << right
+         << setw( 7 ) << r.angles << setw( 7 ) << r.failed
+         << fixed << setprecision( 3 ) << setw( 10 ) << r.seconds
+         << setprecision( 1 ) << setw( 12 ) << ( r.seconds > 0 ? r.angles / r.seconds : 0. )
+         << setw( 9 ) << ( r.angles ? r.tcount / r.angles : 0. ) << setw( 7 ) << r.tmax
+         << scientific << setprecision( 2 )
+         << setw( 11 ) << ( r.angles ? r.error / r.angles : 0. ) << setw( 11 ) << r.errmax
+         << endl;
+    cout.unsetf( ios::floatfield );
+}
+
+static void usage( const char* prog )
+{
+    cerr << "Usage: " << prog << " [-n count] [-s seed] [-l levels] [-g gridsynth] [-d digits] < names\n"
+         << "    -n   Number of angles in the corpus (default 100)\n"
+         << "    -s   Seed of the corpus shuffle (default 1)\n"
+         << "    -l   Comma separated sqct levels to time (default 0,1,2; empty to skip)\n"
+         << "    -g   gridsynth binary to time as well\n"
+         << "    -d   Comma separated gridsynth precisions (default 3)\n"
+         << "Reads DecomposeRotation_* names from standard input.\n";
+}
+
+int main( int argc, char** argv )
+{
+    size_t count = 100;
+    uint32_t seed = 1;
+    vector<int> levels = parseList( "0,1,2" );
+    vector<int> digits = parseList( "3" );
+    string gridsynth;
+    int opt;
+    while( ( opt = getopt( argc, argv, "hn:s:l:g:d:" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'n': count = strtoul( optarg, 0, 10 ); break;
+        case 's': seed = strtoul( optarg, 0, 10 ); break;
+        case 'l': levels = parseList( optarg ); break;
+        case 'g': gridsynth = optarg; break;
+        case 'd': digits = parseList( optarg ); break;
+        default: usage( argv[0] ); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    set<benchAngle> all = readAngles( cin );
+    if( all.empty() )
+    {
+        cerr << "No DecomposeRotation names on standard input" << endl;
+        usage( argv[0] );
+        return 1;
+    }
+    vector<benchAngle> corpus = pickCorpus( all, count, seed );
+    cout << "Corpus: " << corpus.size() << " of " << all.size()
+         << " distinct angles, seed " << seed << endl;
+
+    vector<benchResult> results;
+    if( !levels.empty() )
+    {
+        // Same set up as rotZ
+        auto start = chrono::steady_clock::now();
+        enetOptions eopts;
+        eopts.epsilon_net_layers.push_back( 30 );
+        enetApplication eapp( eopts );
+        eapp.process();
+        SKDecompose sk;
+        // warm up, so that the mapped epsilon net is paged in before timing
+        sk.rotZ( corpus[0].angle, 0 );
+        cout << "sqct set up (epsilon net load and warm-up): " << fixed << setprecision( 3 )
+             << secondsSince( start ) << " s" << endl;
+        cout.unsetf( ios::floatfield );
+        for( int level : levels )
+            results.push_back( benchSqct( sk, corpus, level ) );
+    }
+    if( !gridsynth.empty() )
+        for( int d : digits )
+            results.push_back( benchGridsynth( gridsynth, corpus, d ) );
+
+    cout << left << setw( 10 ) << "tool" << setw( 10 ) << "precision" << right
+         << setw( 7 ) << "angles" << setw( 7 ) << "failed" << setw( 10 ) << "seconds"
+         << setw( 12 ) << "angles/sec" << setw( 9 ) << "mean T" << setw( 7 ) << "max T"
+         << setw( 11 ) << "mean dist" << setw( 11 ) << "max dist" << endl;
+    for( const benchResult& r : results )
+        printResult( r );
+    return 0;
+}
@@ -21,6 +21,7 @@
 #include "output.h"
 
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 sk::sk(int max_layer) :
@@ -30,6 +31,40 @@ sk::sk(int max_layer) :
 
 typedef ring_int<int>::mpclass mpclass;
 
+/// \brief Number of bits in the largest absolute value of integer coefficients of m
+static size_t coefficientBits( const sk::Me& m )
+{
+    size_t res = 0;
+    for( int i = 0; i < 2; ++i )
+        for( int j = 0; j < 2; ++j )
+            for( int k = 0; k < 4; ++k )
+                res = std::max( res, mpz_sizeinbase( m.d[i][j][k].get_mpz_t(), 2 ) );
+    return res;
+}
+
+/// \brief Product m[0] * m[1] * ... * m[count-1]. Each entry of a product of two matrices is
+/// a sum of 8 products of coefficients, so it has at most 3 bits more than the sum of bits of
+/// the factors. When the result fits into long we multiply in long and avoid mpz_class allocations.
+static sk::Me product( const sk::Me* m, int count )
+{
+    size_t bits = 0;
+    for( int i = 0; i < count; ++i )
+        bits += coefficientBits( m[i] ) + 3;
+
+    if( bits < 8 * sizeof(long) - 1 )
+    {
+        matrix2x2<long> res( m[0] );
+        for( int i = 1; i < count; ++i )
+            res = res * matrix2x2<long>( m[i] );
+        return sk::Me( res );
+    }
+
+    sk::Me res( m[0] );
+    for( int i = 1; i < count; ++i )
+        res = res * m[i];
+    return res;
+}
+
 void sk::decompose(const sk::Ma &U, sk::Me &out, int n)
 {
     if( n == 0 )
@@ -47,6 +82,7 @@ void sk::decompose(const sk::Ma &U, sk::Me &out, int n)
         Me Ve,We;
         decompose(V,Ve,n-1);
         decompose(W,We,n-1);
-        out = Ve * We * Ve.conjugateTranspose() * We.conjugateTranspose() * Ue;
+        const Me factors[5] = { Ve, We, Ve.conjugateTranspose(), We.conjugateTranspose(), Ue };
+        out = product( factors, 5 );
     }
 }
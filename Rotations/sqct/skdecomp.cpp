@@ -0,0 +1,68 @@
+//     C interface to SKDecompose for loading sqct into the Rotations pass;
+//     see llvm/include/llvm/Transforms/Scaffold/SKDecomp.h
+//     This file uses SQCT, Copyright (c) 2012 Vadym Kliuchnikov, Dmitri Maslov, Michele Mosca;
+//     SQCT is distributed under LGPL v3
+//
+
+#include "skdecomposer.h"
+#include "eapp.h"
+#include "../../llvm/include/llvm/Transforms/Scaffold/SKDecomp.h"
+
+#include <cstring>
+#include <string>
+
+// SKDecompose keeps the circuit of the last decomposition as a member, so
+// a decomposer must only be used by one thread at a time
+struct skdecomp {
+  SKDecompose sk;
+};
+
+extern "C" {
+
+int skdecomp_api_version(void) {
+  return SKDECOMP_API_VERSION;
+}
+
+skdecomp *skdecomp_create(int max_sde) {
+  try {
+    // Same set up as rotZ: make sure the layers exist before SKDecompose
+    // loads them
+    enetOptions eopts;
+    eopts.epsilon_net_layers.push_back( max_sde );
+    enetApplication eapp( eopts );
+    eapp.process();
+    return new skdecomp;
+  } catch (...) {
+    return 0;
+  }
+}
+
+int skdecomp_rotation(skdecomp *d, char axis, double angle, int iterations,
+                      char *buf, size_t size) {
+  if (!d)
+    return -1;
+  try {
+    circuit c;
+    switch (axis) {
+      case 'X': c = d->sk.rotX( angle, iterations ); break;
+      case 'Y': c = d->sk.rotY( angle, iterations ); break;
+      case 'Z': c = d->sk.rotZ( angle, iterations ); break;
+      default: return -1;
+    }
+    std::string gates = c.toString();
+    if (size > 0) {
+      size_t n = gates.size() < size - 1 ? gates.size() : size - 1;
+      memcpy( buf, gates.data(), n );
+      buf[n] = 0;
+    }
+    return (int)gates.size();
+  } catch (...) {
+    return -1;
+  }
+}
+
+void skdecomp_destroy(skdecomp *d) {
+  delete d;
+}
+
+} // extern "C"
@@ -51,6 +51,12 @@ public:
 
     /// \brief generate a Z rotation
     circuit rotZ( double angle, int iter, bool frac = false );
+
+    /// \brief T and inverse of T gate count of the last circuit
+    int tCount() const { return tc; }
+
+    /// \brief Trace distance of the last circuit to its rotation
+    double distance() const { return dst; }
 };
 
 
@@ -22,9 +22,14 @@
 #include <algorithm>
 #include <ctime>
 #include <cassert>
+#include <cstdlib>
 #include <fstream>
 #include "exactdecomposer.h"
 
+#ifdef _OPENMP
+#include <parallel/algorithm>
+#endif
+
 using namespace std;
 
 /// \brief Order on index nodes based on index_node::abs2 used in indexedUnitaryApproximator
@@ -36,6 +41,22 @@ struct indexNodeComparator
     }
 };
 
+/// \brief Total order on index nodes that refines indexNodeComparator, so that
+/// the index does not depend on the sorting algorithm used to build it
+struct indexNodeStrictComparator
+{
+    bool operator () ( const index_node& a, const index_node& b ) const
+    {
+        if( a.abs2 != b.abs2 )
+            return a.abs2 < b.abs2;
+        if( a.layer_id != b.layer_id )
+            return a.layer_id < b.layer_id;
+        if( a.node_id != b.node_id )
+            return a.node_id < b.node_id;
+        return a.swapped < b.swapped;
+    }
+};
+
 /////////////////////////////////////////////////////
 
 unitaryApproximator::unitaryApproximator( int max_layer )
@@ -170,33 +191,24 @@ void indexedUnitaryApproximator::add_nodes_to_index(int layer_id)
     }
 }
 
-/// \brief Header of index file
-struct inxdex_header
+/// \brief Name of the index file for the given number of layers, next to the epsilon net files
+static string indexFileName( size_t layers )
 {
-    size_t size;
-};
+    stringstream filename;
+    char const *folder = getenv("TMPDIR");
+    if (folder == 0)
+        folder = "/tmp";
+    filename << folder << "/index-" << layers << ".bin";
+    return filename.str();
+}
 
 void indexedUnitaryApproximator::loadIndex()
 {
-    inxdex_header eh = {0};
-    stringstream filename;
-    filename << "/tmp/index-" << layers.size() << ".bin";
-    ifstream ifs( filename.str().c_str(), ios_base::binary );
-    if( !ifs )
-    {
-        is_index_ok = false;
-        return;
-    }
-    ifs.read( (char*) &eh,sizeof(eh));
-    if( eh.size == 0 )
-    {
-        is_index_ok = false;
-        return;
-    }
-    index_nodes.clear();
-    index_nodes.resize( eh.size );
-    ifs.read( (char*) &index_nodes[0], index_nodes.size() * sizeof(index_node) );
-    is_index_ok = true;
+    podFileHeader h;
+    auto file = openPodFile( indexFileName( layers.size() ).c_str(), podIndex, h );
+    is_index_ok = file && podSection( file, h, 0, index_nodes ) && !index_nodes.empty();
+    if( !is_index_ok )
+        index_nodes.clear();
 }
 
 void indexedUnitaryApproximator::approximate_i(size_t end1, size_t start2, double epsilon0)
@@ -233,16 +245,36 @@ void indexedUnitaryApproximator::approximate_i(size_t end1, size_t start2, doubl
     // On next iteration we update end1 and start2 to exclude intervals that we already checked
     // [loff,end1) U [start2, uoff )
 
-    for( int i = loff; i < end1 ; ++i )
-    {
-        index_node& cn = index_nodes[i];
-        layers[ cn.layer_id ]->findExhaustiveApproximation(vec,curr_res,cn.node_id,bestDist);
-    }
+    // Both intervals are searched in parallel. Each thread keeps the first best node in its part,
+    // the first best node overall wins, so the result is the same as for the sequential search
+    int n1 = std::max( (int)end1 - loff, 0 );
+    int n2 = std::max( uoff - (int)start2, 0 );
+    const double start_dist = bestDist;
+    int best_k = -1;
 
-    for( int i = start2; i < uoff; ++i )
+    #pragma omp parallel
     {
-        index_node& cn = index_nodes[i];
-        layers[ cn.layer_id ]->findExhaustiveApproximation(vec,curr_res,cn.node_id,bestDist);
+        epsilonnet::vi local_res;
+        double local_dist = start_dist;
+        int local_k = -1;
+
+        #pragma omp for schedule(dynamic,64) nowait
+        for( int k = 0; k < n1 + n2 ; ++k )
+        {
+            const index_node& cn = index_nodes[ k < n1 ? loff + k : start2 + ( k - n1 ) ];
+            double prev_dist = local_dist;
+            layers[ cn.layer_id ]->findExhaustiveApproximation(vec,local_res,cn.node_id,local_dist);
+            if( local_dist < prev_dist )
+                local_k = k;
+        }
+
+        #pragma omp critical
+        if( local_k >= 0 && ( local_dist < bestDist || ( local_dist == bestDist && local_k < best_k ) ) )
+        {
+            bestDist = local_dist;
+            curr_res = local_res;
+            best_k = local_k;
+        }
     }
 
     auto v1 = curr_res.d[0].toComplex( curr_res.de );
@@ -272,18 +304,15 @@ void indexedUnitaryApproximator::createIndex()
     for( int i = 0; i < layers.size() ; ++i )
         add_nodes_to_index( i );
 
-    indexNodeComparator ic;
-    std::sort( index_nodes.begin(), index_nodes.end(), ic );
-
-    { // write to file
-        stringstream filename;
-        filename << "/tmp/index-" << layers.size() << ".bin";
-        ofstream ofs( filename.str().c_str(), ios_base::binary );
-        if( !ofs )
-            throw std::exception();
-        inxdex_header eh = {index_nodes.size()};
-        ofs.write( (const char*) &eh,sizeof(eh));
-        ofs.write( (const char*) &index_nodes[0], index_nodes.size() * sizeof(index_node) );
-        ofs.close();
-    }
+    indexNodeStrictComparator ic;
+    auto& nodes = index_nodes.modifiable();
+#ifdef _OPENMP
+    __gnu_parallel::sort( nodes.begin(), nodes.end(), ic );
+#else
+    std::sort( nodes.begin(), nodes.end(), ic );
+#endif
+
+    podFileData array = { index_nodes.begin(), index_nodes.size(), sizeof(index_node) };
+    if( !savePodFile( indexFileName( layers.size() ).c_str(), podIndex, &array, 1 ) )
+        throw std::exception();
 }
@@ -78,7 +78,7 @@ public:
 private:
     /// \brief Adds all nodes from given layer to index
     void add_nodes_to_index( int layer_id );
-    /// \brief Loads index from file
+    /// \brief Maps index from file
     void loadIndex();
     /// \brief Assumes that there exist approximation within distance epsilon0
     /// and check nodes from index_nodes with index in \f$ [0,end1) \cup [start2, index size ) \f$.
@@ -90,8 +90,8 @@ private:
     double bestDist;///< Best distance to approximation that was laready found
     double abs2val;///< Absolute value squared of the first component of vec
     epsilonnet::vi curr_res;///< Current best approximation found
-    /// \brief Index nodes sorted by index_node::abs2
-    std::vector<index_node> index_nodes;
+    /// \brief Index nodes sorted by index_node::abs2, memory mapped from the index file when possible
+    podArray<index_node> index_nodes;
 };
 
 #endif // UNITARYAPPROXIMATOR_H
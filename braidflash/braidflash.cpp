@@ -34,6 +34,7 @@
 #include <memory>     //std::shared_ptr, std::make_unique
 #include <limits>     //std::numeric_limits
 #include <boost/graph/adjacency_list.hpp>
+#include "../simd_router/ScheduleFile.h" // .lpfs/.freq
 #include <boost/graph/reverse_graph.hpp>
 #include <boost/graph/copy.hpp>
 #include <boost/graph/graphviz.hpp>
@@ -900,22 +901,6 @@ pair< pair<int,int>, pair<int,int> > compare_manhattan_costs () {
 }
 
 // Parsing functions
-// is there any of several words in a given string?
-template<typename T, size_t N>
-T * endof(T (&ra)[N]) {
-    return ra + N;
-}
-string::size_type is_there(vector<string> needles, string haystack) {
-  vector<string>::iterator needle;
-  string::size_type pos;
-  for(needle=needles.begin(); needle!=needles.end(); ++needle){
-    pos = haystack.find(*needle);
-    if(pos != string::npos){
-      return pos;
-    }
-  }  
-  return string::npos;
-}
 // tokenize string
 vector<string> &split(const string &s, char delim, vector<string> &elems) {
     stringstream ss(s);
@@ -926,69 +911,43 @@ vector<string> &split(const string &s, char delim, vector<string> &elems) {
     }
     return elems;
 }
+// parse an LPFS schedule, text or binary from scripts/qtrace; text
+// schedules have one more column in front of the gate mnemonic
+// (FIXME: OLD FORMAT); qubits are numbered per module in order of first use
 void parse_LPFS (const string file_path) {
-  ifstream LPFSfile (file_path);
-  string line;
-  string leaf_func = "";
-  unsigned int seq = 1;      
-  unsigned long long module_q_count = 0;    
-  map<string, unsigned long long> q_name_to_num;            
-  vector<Gate> module_gates; 
-  const char* all_ops[] = {"PrepZ ", "X ", "Z ", "H ", "CNOT ", "T ", "Tdag ", "S ", "Sdag ", "MeasZ "};  
-  vector<string> op_strings(all_ops, endof(all_ops));  
-  if (LPFSfile.is_open()) {
-    while ( getline (LPFSfile,line) ) {
-      // FunctionHeaders
-      if (line.find("Function") != string::npos) {
-        // save result of previous iteration
-        if (leaf_func != "") {
-          all_gates[leaf_func] = module_gates;
-          all_q_counts[leaf_func] = module_q_count;
-        }
-        // reset book keeping     
-        vector<string> elems;          
-        split(line, ' ', elems);        
-        leaf_func = elems[1];
-        seq = 1;
-        module_q_count = 0;
-        q_name_to_num.clear();        
-        module_gates.clear();        
-      }     
+  schedfile::Schedule schedule;
+  if (!schedule.load(file_path, 0, 1)) {
+    cerr<<"Error: "<<file_path<<": "<<schedule.getError()<<endl;
+    exit(1);
+  }
+  vector<long long> q_id_to_num (schedule.Qubits.size(), -1);   // schedule qubit id -> module qubit number
+  for (auto &F : schedule.Functions) {
+    string leaf_func = F.Name.str();
+    unsigned int seq = 1;
+    unsigned long long module_q_count = 0;
+    vector<Gate> module_gates;
+    fill(q_id_to_num.begin(), q_id_to_num.end(), -1);
+    for (auto &op : F.Ops) {
       // OPinsts
-      else if (is_there(op_strings, line) != string::npos) {
-        vector<string> elems;          
-        split(line, ' ', elems);
-        // FIXME: OLD FORMAT: 2,3,5,4
-        // FIXME: NEW FORMAT: 1,2,4,3
-        string op_type = elems[2];        
-        vector<unsigned int> qid;        
-        string qid1 = elems[3];     
-        if (q_name_to_num.find(qid1) == q_name_to_num.end())
-          q_name_to_num[qid1] = module_q_count++;    
-        qid.push_back(q_name_to_num[qid1]);         
-        if (elems.size() == 5) {
-          string qid2 = elems[4];                    
-          if (q_name_to_num.find(qid2) == q_name_to_num.end())
-            q_name_to_num[qid2] = module_q_count++;          
-          qid.push_back(q_name_to_num[qid2]);
-        }
-        if (/*op_type == "PrepZ" || op_type == "MeasZ" ||*/ op_type == "CNOT" || op_type == "H" /*|| op_type == "T" || op_type == "Tdag"*/) {
-          Gate g = Gate(seq++, op_type, qid); 
-          module_gates.push_back(g);        
-        }
+      if (op.Code != qtrace::PrepZ && op.Code != qtrace::X && op.Code != qtrace::Z &&
+          op.Code != qtrace::H && op.Code != qtrace::CNOT && op.Code != qtrace::T &&
+          op.Code != qtrace::Tdag && op.Code != qtrace::S && op.Code != qtrace::Sdag &&
+          op.Code != qtrace::MeasZ)
+        continue;
+      vector<unsigned int> qid;
+      for (unsigned int i = 0; i < qtrace::getArity(op.Code); i++) {
+        if (q_id_to_num[op.Qubits[i]] < 0)
+          q_id_to_num[op.Qubits[i]] = module_q_count++;
+        qid.push_back(q_id_to_num[op.Qubits[i]]);
+      }
+      if (/*op.Code == qtrace::PrepZ || op.Code == qtrace::MeasZ ||*/ op.Code == qtrace::CNOT || op.Code == qtrace::H /*|| op.Code == qtrace::T || op.Code == qtrace::Tdag*/) {
+        Gate g = Gate(seq++, qtrace::getName(op.Code), qid);
+        module_gates.push_back(g);
       }
     }
-    // save result of last iteration
-    if (leaf_func != "") {
-      all_gates[leaf_func] = module_gates;
-      all_q_counts[leaf_func] = module_q_count;
-    }    
-    LPFSfile.close();
+    all_gates[leaf_func] = module_gates;
+    all_q_counts[leaf_func] = module_q_count;
   }
-  else {
-    cerr<<"Error: Unable to open file."<<endl;
-    exit(1);
-  }      
 }
 
 void parse_tr (const string file_path) {
@@ -1031,19 +990,10 @@ void parse_tr (const string file_path) {
 }
 // parse profile of module frequencies
 void parse_freq (const string file_path) {
-  ifstream profile_freq_file (file_path);
-  string line;
-  string module_name = "";  
-  unsigned long long freq = 0;
-  if (profile_freq_file.is_open()) {
-    while ( getline (profile_freq_file,line) ) {
-      vector<string> elems; 
-      elems.clear();     
-      split(line, ' ', elems);              
-      module_name = elems[0];
-      freq = stoull(elems[9]);
-      module_freqs[module_name] = freq;
-    }
+  schedfile::FrequencyProfile profile;
+  if (profile.load(file_path)) {
+    for (auto &E : profile.Entries)
+      module_freqs[E.Module.str()] = E.Count;
   }
   else
     cerr << "Unable to open .freq file" << endl;
@@ -0,0 +1,74 @@
+//===-- CliffordTSeq.h - Packed Clifford+T gate sequences -------*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// With -rotation-seq the Rotations pass gives every DecomposeRotation_*
+// function a single call
+//
+//   call void @llvm.CliffordTSeq(i16 %q, i8* getelementptr inbounds
+//                                ([N x i8]* @.str, i64 0, i64 0))
+//
+// instead of one intrinsic call per gate. The second operand is a constant
+// C string with one letter per gate, in the order the gates are applied,
+// using the letters of the rotation decomposers:
+//
+//   H X Y Z    T t (Tdag)    P p (S and Sdag)
+//
+// Passes that count or print gates read the sequence with the helpers below;
+// the gates themselves are only expanded when flat QASM is written.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_CLIFFORDTSEQ_H
+#define LLVM_TRANSFORMS_SCAFFOLD_CLIFFORDTSEQ_H
+
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+namespace cliffordt {
+
+/// getGates - If CI is a call to llvm.CliffordTSeq, set Gates to its gate
+/// string and return true.
+inline bool getGates(const CallInst *CI, StringRef &Gates) {
+  const Function *F = CI->getCalledFunction();
+  if (!F || F->getIntrinsicID() != Intrinsic::CliffordTSeq)
+    return false;
+  Gates = StringRef();
+  const GlobalVariable *GV =
+    dyn_cast<GlobalVariable>(CI->getArgOperand(1)->stripPointerCasts());
+  if (GV && GV->hasInitializer())
+    if (const ConstantDataArray *CDA =
+          dyn_cast<ConstantDataArray>(GV->getInitializer()))
+      if (CDA->isCString())
+        Gates = CDA->getAsCString();
+  return true;
+}
+
+/// getGate - The intrinsic a gate letter stands for, or not_intrinsic.
+inline Intrinsic::ID getGate(char C) {
+  switch (C) {
+  case 'H': return Intrinsic::H;
+  case 'X': return Intrinsic::X;
+  case 'Y': return Intrinsic::Y;
+  case 'Z': return Intrinsic::Z;
+  case 'T': return Intrinsic::T;
+  case 't': return Intrinsic::Tdag;
+  case 'P': return Intrinsic::S;
+  case 'p': return Intrinsic::Sdag;
+  default:  return Intrinsic::not_intrinsic;
+  }
+}
+
+} // End cliffordt namespace
+} // End llvm namespace
+
+#endif
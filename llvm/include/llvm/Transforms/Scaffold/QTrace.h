@@ -0,0 +1,402 @@
+//===-- QTrace.h - Compact binary gate traces -------------------*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// Reader and writer for QTrace, a compact binary encoding of flat QASM and
+// LPFS schedules. It replaces one text line per gate ("CNOT q1,q2",
+// "12,3 CNOT q1 q2") with a few bytes, and qubit names with integer ids.
+//
+// The header only depends on the C++ standard library (C++98), so the
+// Scaffold passes and the standalone tools (simd_router, braidflash,
+// scripts/qtrace) can all include it.
+//
+// Layout:
+//
+//   "QTRC" <version byte> <3 reserved bytes>
+//   record*
+//
+// Every record starts with a tag byte:
+//
+//   0x00-0x3f  gate; tag is the opcode (see OpCode)
+//   0x40       flag on a gate tag: varint timestep and varint zone follow
+//   0x80       QUBIT   varint id, varint length, name bytes
+//   0x81       CBIT    varint id, varint length, name bytes
+//   0x82       MODULE  varint length, name bytes, varint k, varint d
+//              (module boundary; k and d are the SIMD regions and depth of
+//              an LPFS schedule, 0 for flat QASM)
+//   0x83       END     end of the trace
+//
+// Gate operands follow the tag (and the schedule, if any):
+//
+//   1-3 qubit ids as varints (getArity)
+//   TMOV/BMOV: varint destination, varint source, then the qubit id
+//   Rx/Ry/Rz: the qubit id, then the angle as a little-endian IEEE double
+//
+// Varints are unsigned LEB128. Qubit ids refer to earlier QUBIT/CBIT
+// records.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_QTRACE_H
+#define LLVM_TRANSFORMS_SCAFFOLD_QTRACE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace qtrace {
+
+typedef unsigned long long u64;
+
+enum OpCode {
+  H = 0, X, Y, Z, S, Sdag, T, Tdag,
+  CNOT, Toffoli, Fredkin,
+  PrepX, PrepZ, MeasX, MeasZ,
+  Rx, Ry, Rz,
+  TMOV, BMOV,
+  NumOpCodes
+};
+
+enum Tag {
+  TagScheduled = 0x40,
+  TagQubit = 0x80,
+  TagCbit = 0x81,
+  TagModule = 0x82,
+  TagEnd = 0x83
+};
+
+static const char Magic[4] = { 'Q', 'T', 'R', 'C' };
+static const unsigned char Version = 1;
+
+/// getName - Mnemonic used in the text formats; Toffoli is "Tof" as in flat
+/// QASM.
+inline const char *getName(OpCode Op) {
+  static const char *const Names[NumOpCodes] = {
+    "H", "X", "Y", "Z", "S", "Sdag", "T", "Tdag",
+    "CNOT", "Tof", "Fredkin",
+    "PrepX", "PrepZ", "MeasX", "MeasZ",
+    "Rx", "Ry", "Rz",
+    "TMOV", "BMOV"
+  };
+  return Op < NumOpCodes ? Names[Op] : "UNKNOWN";
+}
+
+/// getOpCode - Parse a mnemonic; returns false if it is not a gate.
+inline bool getOpCode(const std::string &Name, OpCode &Op) {
+  for (unsigned i = 0; i < NumOpCodes; i++)
+    if (Name == getName((OpCode)i)) {
+      Op = (OpCode)i;
+      return true;
+    }
+  if (Name == "Toffoli") {
+    Op = Toffoli;
+    return true;
+  }
+  return false;
+}
+
+/// getArity - Number of qubit operands.
+inline unsigned getArity(OpCode Op) {
+  switch (Op) {
+  case CNOT: return 2;
+  case Toffoli: case Fredkin: return 3;
+  default: return 1;
+  }
+}
+
+inline bool hasAngle(OpCode Op) { return Op == Rx || Op == Ry || Op == Rz; }
+inline bool isMove(OpCode Op) { return Op == TMOV || Op == BMOV; }
+
+/// Record - One decoded record.
+struct Record {
+  enum Kind { Gate, Qubit, Cbit, Module, End };
+  Kind kind;
+  OpCode op;
+  bool scheduled;
+  u64 timestep, zone;   // if scheduled
+  u64 qubits[3];        // getArity(op) ids
+  u64 dst, src;         // TMOV/BMOV
+  double angle;         // Rx/Ry/Rz
+  u64 id;               // Qubit/Cbit
+  std::string name;     // Qubit/Cbit/Module
+  u64 k, d;             // Module
+  Record() : kind(End), op(H), scheduled(false), timestep(0), zone(0),
+             dst(0), src(0), angle(0.0), id(0), k(0), d(0) {
+    qubits[0] = qubits[1] = qubits[2] = 0;
+  }
+};
+
+/// Writer - Encodes records into any stream with a write(const char*, n)
+/// member (llvm::raw_ostream, std::ostream). Output is buffered here, so
+/// unbuffered streams are fine.
+template <class Stream>
+class Writer {
+  Stream &OS;
+  char Buf[1 << 16];
+  unsigned Len;
+
+  void reserve(unsigned N) {
+    if (Len + N > sizeof(Buf)) flush();
+  }
+  void byte(unsigned char B) { Buf[Len++] = (char)B; }
+  void varint(u64 V) {
+    while (V >= 0x80) {
+      byte((unsigned char)(V | 0x80));
+      V >>= 7;
+    }
+    byte((unsigned char)V);
+  }
+  void string(const std::string &S) {
+    varint(S.size());
+    if (Len + S.size() > sizeof(Buf)) {
+      flush();
+      OS.write(S.data(), S.size());
+    } else {
+      memcpy(Buf + Len, S.data(), S.size());
+      Len += S.size();
+    }
+  }
+  void tag(OpCode Op, bool Scheduled, u64 Timestep, u64 Zone) {
+    byte(Op | (Scheduled ? TagScheduled : 0));
+    if (Scheduled) {
+      varint(Timestep);
+      varint(Zone);
+    }
+  }
+
+public:
+  explicit Writer(Stream &os) : OS(os), Len(0) {
+    memcpy(Buf, Magic, 4);
+    Buf[4] = (char)Version;
+    Buf[5] = Buf[6] = Buf[7] = 0;
+    Len = 8;
+  }
+  ~Writer() { flush(); }
+
+  void flush() {
+    if (Len) OS.write(Buf, Len);
+    Len = 0;
+  }
+
+  void declare(u64 Id, const std::string &Name, bool IsCbit = false) {
+    reserve(24);
+    byte(IsCbit ? TagCbit : TagQubit);
+    varint(Id);
+    string(Name);
+  }
+
+  void module(const std::string &Name, u64 K = 0, u64 D = 0) {
+    reserve(12);
+    byte(TagModule);
+    string(Name);
+    reserve(20);
+    varint(K);
+    varint(D);
+  }
+
+  /// gate - An unscheduled gate, as in flat QASM.
+  void gate(OpCode Op, u64 A, u64 B = 0, u64 C = 0) {
+    scheduledGate(Op, false, 0, 0, A, B, C);
+  }
+
+  /// scheduledGate - A gate at a timestep and zone, as in LPFS schedules.
+  void scheduledGate(OpCode Op, bool Scheduled, u64 Timestep, u64 Zone,
+                     u64 A, u64 B = 0, u64 C = 0) {
+    reserve(64);
+    tag(Op, Scheduled, Timestep, Zone);
+    varint(A);
+    unsigned N = getArity(Op);
+    if (N > 1) varint(B);
+    if (N > 2) varint(C);
+  }
+
+  void rotation(OpCode Op, u64 A, double Angle, bool Scheduled = false,
+                u64 Timestep = 0, u64 Zone = 0) {
+    reserve(48);
+    tag(Op, Scheduled, Timestep, Zone);
+    varint(A);
+    u64 Bits;
+    memcpy(&Bits, &Angle, sizeof(Bits));
+    for (unsigned i = 0; i < 8; i++)
+      byte((unsigned char)(Bits >> (8 * i)));
+  }
+
+  void move(OpCode Op, u64 Timestep, u64 Zone, u64 Dst, u64 Src, u64 Qubit) {
+    reserve(64);
+    tag(Op, true, Timestep, Zone);
+    varint(Dst);
+    varint(Src);
+    varint(Qubit);
+  }
+
+  void end() {
+    reserve(1);
+    byte(TagEnd);
+    flush();
+  }
+};
+
+/// Reader - Decodes a trace file sequentially through a large stdio buffer.
+/// Qubit and cbit names are collected as their records are read.
+class Reader {
+  FILE *F;
+  std::vector<char> Buf;
+  size_t Pos, Len;
+  bool Eof;
+  std::vector<std::string> Names;
+  std::string Error;
+
+  bool refill() {
+    if (Pos < Len) {
+      memmove(&Buf[0], &Buf[Pos], Len - Pos);
+      Len -= Pos;
+    } else {
+      Len = 0;
+    }
+    Pos = 0;
+    size_t N = fread(&Buf[Len], 1, Buf.size() - Len, F);
+    Len += N;
+    return N > 0;
+  }
+  bool byte(unsigned char &B) {
+    if (Pos == Len && !refill()) return false;
+    B = (unsigned char)Buf[Pos++];
+    return true;
+  }
+  bool varint(u64 &V) {
+    V = 0;
+    unsigned char B;
+    for (unsigned Shift = 0; Shift < 64; Shift += 7) {
+      if (!byte(B)) return false;
+      V |= (u64)(B & 0x7f) << Shift;
+      if (!(B & 0x80)) return true;
+    }
+    return false;
+  }
+  bool string(std::string &S) {
+    u64 N;
+    if (!varint(N)) return false;
+    S.resize(N);
+    for (u64 i = 0; i < N; i++) {
+      unsigned char B;
+      if (!byte(B)) return false;
+      S[i] = (char)B;
+    }
+    return true;
+  }
+  bool fail(const char *Msg) {
+    Error = Msg;
+    return false;
+  }
+
+public:
+  Reader() : F(0), Buf(1 << 20), Pos(0), Len(0), Eof(false) {}
+  ~Reader() { close(); }
+
+  /// isTrace - Does the file start with the QTrace magic?
+  static bool isTrace(const std::string &Path) {
+    FILE *In = fopen(Path.c_str(), "rb");
+    if (!In) return false;
+    char Head[4];
+    bool Match = fread(Head, 1, 4, In) == 4 && memcmp(Head, Magic, 4) == 0;
+    fclose(In);
+    return Match;
+  }
+
+  bool open(const std::string &Path) {
+    close();
+    F = fopen(Path.c_str(), "rb");
+    if (!F) return fail("cannot open file");
+    unsigned char Head[8];
+    if (fread(Head, 1, 8, F) != 8 || memcmp(Head, Magic, 4) != 0)
+      return fail("not a QTrace file");
+    if (Head[4] != Version)
+      return fail("unsupported QTrace version");
+    return true;
+  }
+
+  void close() {
+    if (F) fclose(F);
+    F = 0;
+    Pos = Len = 0;
+    Eof = false;
+    Names.clear();
+  }
+
+  const std::string &getError() const { return Error; }
+
+  /// getQubitName - Name of a qubit or cbit id declared so far.
+  const std::string &getQubitName(u64 Id) const {
+    static const std::string Undef("UNDEF");
+    return Id < Names.size() ? Names[Id] : Undef;
+  }
+  size_t getNumQubits() const { return Names.size(); }
+
+  /// next - Read the next record; returns false at the end of the trace or
+  /// on a malformed record (getError() is set then).
+  bool next(Record &R) {
+    if (Eof || !F) return false;
+    unsigned char Tag;
+    if (!byte(Tag)) {
+      Eof = true;
+      return false;
+    }
+    switch (Tag) {
+    case TagQubit:
+    case TagCbit:
+      R.kind = Tag == TagQubit ? Record::Qubit : Record::Cbit;
+      if (!varint(R.id) || !string(R.name))
+        return fail("truncated declaration");
+      if (R.id >= Names.size()) Names.resize(R.id + 1);
+      Names[R.id] = R.name;
+      return true;
+    case TagModule:
+      R.kind = Record::Module;
+      if (!string(R.name) || !varint(R.k) || !varint(R.d))
+        return fail("truncated module record");
+      return true;
+    case TagEnd:
+      R.kind = Record::End;
+      Eof = true;
+      return false;
+    default:
+      break;
+    }
+
+    unsigned Op = Tag & 0x3f;
+    if ((Tag & 0x80) || Op >= NumOpCodes)
+      return fail("unknown record tag");
+    R.kind = Record::Gate;
+    R.op = (OpCode)Op;
+    R.scheduled = (Tag & TagScheduled) != 0;
+    if (R.scheduled && (!varint(R.timestep) || !varint(R.zone)))
+      return fail("truncated schedule");
+    if (isMove(R.op)) {
+      if (!varint(R.dst) || !varint(R.src) || !varint(R.qubits[0]))
+        return fail("truncated move");
+      return true;
+    }
+    for (unsigned i = 0, e = getArity(R.op); i != e; ++i)
+      if (!varint(R.qubits[i]))
+        return fail("truncated gate");
+    if (hasAngle(R.op)) {
+      u64 Bits = 0;
+      for (unsigned i = 0; i < 8; i++) {
+        unsigned char B;
+        if (!byte(B)) return fail("truncated angle");
+        Bits |= (u64)B << (8 * i);
+      }
+      memcpy(&R.angle, &Bits, sizeof(Bits));
+    }
+    return true;
+  }
+};
+
+} // End qtrace namespace
+
+#endif
@@ -0,0 +1,104 @@
+//===-- QbitTimesteps.h - Per-qubit timesteps of a function -----*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// The state -GetCriticalPath, -GetClassicalCriticalPath and -ModCriticalPath
+// keep for every qbit array of the function being scheduled: the timestep at
+// which each of its qubits is free again.
+//
+// The arrays of a function are numbered when they are found, so a gate
+// operand is an array number and an index, and finding its timestep is two
+// vector lookups. An index only gets a slot of its own when it is first
+// used, taking the timestep of the whole array at that point; until then it
+// shares the timestep of the whole array.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_QBITTIMESTEPS_H
+#define LLVM_TRANSFORMS_SCAFFOLD_QBITTIMESTEPS_H
+
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+namespace critpath {
+
+/// QbitArray - The timesteps of the qubits of one qbit array or qbit
+/// argument.
+struct QbitArray {
+  uint64_t whole;   // indices without a slot of their own
+  uint64_t max;     // max over all indices
+  std::vector<uint64_t> ts;
+  std::vector<char> hasSlot;
+  std::vector<int> slots;   // indices with a slot, in order of first use
+
+  QbitArray() : whole(0), max(0) {}
+
+  bool has(int index) const {
+    return index >= 0 && (unsigned)index < hasSlot.size() && hasSlot[index];
+  }
+
+  /// at - The timestep of index, giving it a slot first if it has none. An
+  /// index of -1 stands for the whole array and -2 for the max.
+  uint64_t &at(int index) {
+    if (index == -1)
+      return whole;
+    if (index == -2)
+      return max;
+    if ((unsigned)index >= hasSlot.size()) {
+      ts.resize(index + 1);
+      hasSlot.resize(index + 1, false);
+    }
+    if (!hasSlot[index]) {
+      hasSlot[index] = true;
+      slots.push_back(index);
+      ts[index] = whole;
+    }
+    return ts[index];
+  }
+
+  /// get - The timestep of index, without giving it a slot.
+  uint64_t get(int index) const {
+    if (index == -2)
+      return max;
+    return has(index) ? ts[index] : whole;
+  }
+
+  /// setAll - Set the whole array, its max and every slot to t.
+  void setAll(uint64_t t) {
+    whole = max = t;
+    for (unsigned i = 0; i < slots.size(); i++)
+      ts[slots[i]] = t;
+  }
+
+  /// print - "-2:max  -1:whole  index:timestep ..." in index order.
+  void print(raw_ostream &OS) const {
+    std::vector<int> sorted(slots);
+    std::sort(sorted.begin(), sorted.end());
+    OS << -2 << ":" << max << "  " << -1 << ":" << whole << "  ";
+    for (unsigned i = 0; i < sorted.size(); i++)
+      OS << sorted[i] << ":" << ts[sorted[i]] << "  ";
+  }
+};
+
+/// ArgQbits - The qbit arrays of a scheduled function by argument number.
+struct ArgQbits {
+  std::vector<QbitArray> arrays;
+  std::vector<char> isQbit;
+
+  /// lookup - The qbit array of argument i, or null if it is not a qbit.
+  const QbitArray *lookup(unsigned i) const {
+    return i < isQbit.size() && isQbit[i] ? &arrays[i] : 0;
+  }
+};
+
+} // End critpath namespace
+} // End llvm namespace
+
+#endif
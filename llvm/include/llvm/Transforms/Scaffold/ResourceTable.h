@@ -0,0 +1,204 @@
+//===-- ResourceTable.h - Qubit and gate counts per function ----*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// The resource accounting shared by -ResourceCount, -ResourceCount2,
+// -GateCount and -ResourceCountSymbolic.
+//
+// Gate calls are classified by intrinsic ID. The counts of all functions of a
+// module live in one array with a row of NumKinds counters per function, so
+// counting a module is a single pass over its instructions that allocates
+// nothing per instruction. Every function only writes its own row, so the
+// SCCs of the call graph can be counted on several threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_RESOURCETABLE_H
+#define LLVM_TRANSFORMS_SCAFFOLD_RESOURCETABLE_H
+
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Transforms/Scaffold/CliffordTSeq.h"
+#include "llvm/Transforms/Scaffold/SCCSchedule.h"
+#include <vector>
+
+namespace llvm {
+namespace resources {
+
+/// Kind - A column of the resource tables. The first eleven are the columns
+/// -ResourceCount has always printed, in the same order.
+enum Kind {
+  Qubit, X, Z, H, T, Tdag, S, Sdag, CNOT, PrepZ, MeasZ,
+  Y, Rx, Ry, Rz, Toffoli, Fredkin, PrepX, MeasX,
+  NumKinds
+};
+
+/// getName - The column heading of K.
+inline const char *getName(unsigned K) {
+  static const char *const Names[NumKinds] = {
+    "Qubit", "X", "Z", "H", "T", "T_dag", "S", "S_dag", "CNOT", "PrepZ",
+    "MeasZ", "Y", "Rx", "Ry", "Rz", "Toffoli", "Fredkin", "PrepX", "MeasX"
+  };
+  return Names[K];
+}
+
+/// getKind - The column a gate intrinsic is counted in, or NumKinds if the
+/// intrinsic is not a gate.
+inline unsigned getKind(unsigned IID) {
+  switch (IID) {
+  case Intrinsic::X:       return X;
+  case Intrinsic::Y:       return Y;
+  case Intrinsic::Z:       return Z;
+  case Intrinsic::H:       return H;
+  case Intrinsic::T:       return T;
+  case Intrinsic::Tdag:    return Tdag;
+  case Intrinsic::S:       return S;
+  case Intrinsic::Sdag:    return Sdag;
+  case Intrinsic::CNOT:    return CNOT;
+  case Intrinsic::Toffoli: return Toffoli;
+  case Intrinsic::Fredkin: return Fredkin;
+  case Intrinsic::Rx:      return Rx;
+  case Intrinsic::Ry:      return Ry;
+  case Intrinsic::Rz:      return Rz;
+  case Intrinsic::PrepX:   return PrepX;
+  case Intrinsic::PrepZ:   return PrepZ;
+  case Intrinsic::MeasX:   return MeasX;
+  case Intrinsic::MeasZ:   return MeasZ;
+  default:                 return NumKinds;
+  }
+}
+
+/// countInstruction - Add the qubits allocated or the gates applied by I to
+/// Row. Calls of other functions are left to the caller; returns the callee
+/// of such a call and null otherwise.
+inline const Function *countInstruction(const Instruction &I,
+                                        unsigned long long *Row) {
+  if (const AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+    // qbit arrays are arrays of i16
+    if (ArrayType *AT = dyn_cast<ArrayType>(AI->getAllocatedType()))
+      if (AT->getElementType()->isIntegerTy(16))
+        Row[Qubit] += AT->getNumElements();
+    return 0;
+  }
+
+  const CallInst *CI = dyn_cast<CallInst>(&I);
+  if (!CI)
+    return 0;
+  const Function *Callee = CI->getCalledFunction();
+  if (!Callee)
+    return 0;
+  unsigned IID = Callee->getIntrinsicID();
+  if (IID == Intrinsic::not_intrinsic)
+    return Callee;
+
+  if (IID == Intrinsic::CliffordTSeq) {
+    // a packed run of gates from the Rotations pass
+    StringRef Gates;
+    cliffordt::getGates(CI, Gates);
+    for (size_t g = 0; g < Gates.size(); g++) {
+      unsigned K = getKind(cliffordt::getGate(Gates[g]));
+      if (K != NumKinds)
+        Row[K]++;
+    }
+    return 0;
+  }
+
+  unsigned K = getKind(IID);
+  if (K != NumKinds)
+    Row[K]++;
+  return 0;
+}
+
+/// totalGates - All gates of a row, i.e. every column but Qubit.
+inline unsigned long long totalGates(const unsigned long long *Row) {
+  unsigned long long Total = 0;
+  for (unsigned K = 0; K < NumKinds; K++)
+    if (K != Qubit)
+      Total += Row[K];
+  return Total;
+}
+
+/// ResourceTable - The qubits and gates of every function of a module,
+/// including those of the functions it calls.
+class ResourceTable {
+  DenseMap<const Function*, unsigned> Numbers;  // defined functions only
+  std::vector<const Function*> Functions;       // in module order
+  std::vector<unsigned long long> Counts;       // NumKinds per function
+  std::vector<char> Counted;   // not vector<bool>: rows are set concurrently
+
+public:
+  explicit ResourceTable(const Module &M) {
+    for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if (!F->isDeclaration()) {
+        Numbers[F] = Functions.size();
+        Functions.push_back(F);
+      }
+    Counts.assign(Functions.size() * NumKinds, 0);
+    Counted.assign(Functions.size(), false);
+  }
+
+  unsigned size() const { return Functions.size(); }
+  const Function *getFunction(unsigned i) const { return Functions[i]; }
+  bool isCounted(unsigned i) const { return Counted[i]; }
+
+  const unsigned long long *getRow(unsigned i) const {
+    return &Counts[i * NumKinds];
+  }
+
+  /// lookup - The row of F, or null if F has no body.
+  const unsigned long long *lookup(const Function *F) const {
+    DenseMap<const Function*, unsigned>::const_iterator I = Numbers.find(F);
+    return I == Numbers.end() ? 0 : getRow(I->second);
+  }
+
+  /// countFunction - Count F, adding in the rows of the functions it calls.
+  /// Callees must be counted first; calls into the same call graph SCC that
+  /// are not counted yet contribute nothing.
+  void countFunction(const Function &F) {
+    DenseMap<const Function*, unsigned>::const_iterator N = Numbers.find(&F);
+    if (N == Numbers.end())
+      return;
+    unsigned long long *Row = &Counts[N->second * NumKinds];
+    for (Function::const_iterator BB = F.begin(), BE = F.end(); BB != BE; ++BB)
+      for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if (const Function *Callee = countInstruction(*I, Row)) {
+          DenseMap<const Function*, unsigned>::const_iterator C = Numbers.find(Callee);
+          if (C == Numbers.end() || !Counted[C->second])
+            continue;
+          const unsigned long long *CalleeRow = &Counts[C->second * NumKinds];
+          for (unsigned K = 0; K < NumKinds; K++)
+            Row[K] += CalleeRow[K];
+        }
+    Counted[N->second] = true;
+  }
+
+  /// countCallGraph - Count every function reachable from the root of CG,
+  /// callees before callers, on Threads threads (0 means one per core). The
+  /// counts do not depend on the number of threads.
+  void countCallGraph(CallGraph &CG, unsigned Threads = 1) {
+    struct Counter : public SCCVisitor {
+      ResourceTable &Table;
+      explicit Counter(ResourceTable &T) : Table(T) {}
+      virtual void visitSCC(const std::vector<CallGraphNode*> &Nodes, unsigned) {
+        for (std::vector<CallGraphNode*>::const_iterator I = Nodes.begin(), IE = Nodes.end(); I != IE; ++I)
+          if (const Function *F = (*I)->getFunction())
+            Table.countFunction(*F);
+      }
+    } C(*this);
+    visitCallGraph(CG, C, Threads);
+  }
+};
+
+} // End resources namespace
+} // End llvm namespace
+
+#endif
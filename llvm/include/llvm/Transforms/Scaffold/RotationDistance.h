@@ -0,0 +1,84 @@
+//===-- RotationDistance.h - Error of a rotation decomposition --*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// Trace distance sqrt(1 - |tr(U^+ V)|/2) between a rotation U and the product
+// V of a Clifford+T gate string, the metric sqct reports for its own
+// decompositions. The Rotations pass uses it for -rotation-error-budget and
+// Rotations/sqct/rotbench for the gridsynth results, so both report errors in
+// the same metric.
+//
+// Gates are letters in matrix product order (the last one is applied first),
+// as the decomposers print them:
+//
+//   H X Y Z    T t (Tdag)    S P p (S and Sdag)
+//
+// Other characters, including the global phases W and I, are skipped.
+//
+// The header only depends on the C++ standard library (C++98), so the
+// Scaffold passes and the standalone tools can both include it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_ROTATIONDISTANCE_H
+#define LLVM_TRANSFORMS_SCAFFOLD_ROTATIONDISTANCE_H
+
+#include <cmath>
+#include <complex>
+#include <string>
+
+namespace rotdist {
+
+/// traceDistance - Distance between the rotation by Angle about Axis ('X',
+/// 'Y' or 'Z') and the product of Gates. It is computed from the traceless
+/// part of U^+ V so that it stays accurate for very precise decompositions.
+inline double traceDistance(char Axis, double Angle, const std::string &Gates) {
+  typedef std::complex<double> C;
+  const double h = 0.70710678118654752440;
+  C M[2][2] = { { 1., 0. }, { 0., 1. } };
+  for (std::string::size_type g = 0; g < Gates.size(); g++) {
+    C G[2][2] = { { 1., 0. }, { 0., 1. } };
+    switch (Gates[g]) {
+    case 'T': G[1][1] = C(h, h); break;
+    case 't': G[1][1] = C(h, -h); break;
+    case 'S': case 'P': G[1][1] = C(0., 1.); break;
+    case 'p': G[1][1] = C(0., -1.); break;
+    case 'H': G[0][0] = G[0][1] = G[1][0] = h; G[1][1] = -h; break;
+    case 'X': G[0][0] = G[1][1] = 0.; G[0][1] = G[1][0] = 1.; break;
+    case 'Y': G[0][0] = G[1][1] = 0.; G[0][1] = C(0., -1.); G[1][0] = C(0., 1.); break;
+    case 'Z': G[1][1] = -1.; break;
+    default: continue;
+    }
+    C P[2][2];
+    for (int i = 0; i < 2; i++)
+      for (int j = 0; j < 2; j++)
+        P[i][j] = M[i][0] * G[0][j] + M[i][1] * G[1][j];
+    for (int i = 0; i < 2; i++)
+      for (int j = 0; j < 2; j++)
+        M[i][j] = P[i][j];
+  }
+  // U^+ for U = cos(a/2) I - i sin(a/2) n.sigma
+  double c = std::cos(Angle / 2), s = std::sin(Angle / 2);
+  C U[2][2] = { { c, 0. }, { 0., c } };
+  if (Axis == 'X') { U[0][1] = U[1][0] = C(0., s); }
+  else if (Axis == 'Y') { U[0][1] = s; U[1][0] = -s; }
+  else { U[0][0] = C(c, s); U[1][1] = C(c, -s); }
+  C D[2][2];
+  for (int i = 0; i < 2; i++)
+    for (int j = 0; j < 2; j++)
+      D[i][j] = U[i][0] * M[0][j] + U[i][1] * M[1][j];
+  // U^+ V = e^{ia} (cos b I - i sin b n.sigma); 1 - |cos b| from sin b
+  double SinB2 = std::norm((D[0][0] - D[1][1]) / 2.) +
+                 (std::norm(D[0][1]) + std::norm(D[1][0])) / 2;
+  if (SinB2 > 1.)
+    SinB2 = 1.;
+  return std::sqrt(SinB2 / (1. + std::sqrt(1. - SinB2)));
+}
+
+} // end namespace rotdist
+
+#endif
@@ -0,0 +1,163 @@
+//===-- SCCSchedule.h - Call graph SCCs as a DAG of tasks -------*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// Bottom-up passes such as -ResourceCount analyze every function after the
+// functions it calls. Walking scc_begin() does that one SCC at a time, but an
+// SCC only has to wait for the SCCs it calls into, so the SCCs of the call
+// graph are scheduled as a DAG: a pool of threads takes whichever SCCs have
+// all their callees done.
+//
+// A visitor may only read the IR. Whatever it computes for an SCC is written
+// to slots owned by that SCC, and is read by the callers of the SCC once it
+// is done. Output should be kept per SCC and printed in post-order afterwards
+// so that it does not depend on the number of threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_SCCSCHEDULE_H
+#define LLVM_TRANSFORMS_SCAFFOLD_SCCSCHEDULE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+namespace llvm {
+namespace resources {
+
+/// SCCVisitor - The work done for each SCC of the call graph.
+class SCCVisitor {
+public:
+  virtual ~SCCVisitor() {}
+
+  /// startSCCs - Called before any SCC is visited, e.g. to make room for the
+  /// results of every SCC.
+  virtual void startSCCs(unsigned NumSCCs) {}
+
+  /// visitSCC - Called once for every SCC reachable from the root, after the
+  /// SCCs it calls into. Index is the position of the SCC in post-order.
+  virtual void visitSCC(const std::vector<CallGraphNode*> &SCC,
+                        unsigned Index) = 0;
+};
+
+/// SCCQueue - The SCCs in post-order, with the callers waiting on each.
+struct SCCQueue {
+  std::vector<std::vector<CallGraphNode*> > SCCs;
+  std::vector<std::vector<unsigned> > Callers;
+  std::vector<unsigned> Pending;   // callee SCCs not visited yet
+  std::vector<unsigned> Ready;
+  unsigned Remaining;
+  SCCVisitor *Visitor;
+  pthread_mutex_t Lock;
+  pthread_cond_t Wake;
+
+  explicit SCCQueue(CallGraphNode *Root) : Remaining(0), Visitor(0) {
+    DenseMap<CallGraphNode*, unsigned> Number;
+    for (scc_iterator<CallGraphNode*> SCC = scc_begin(Root), E = scc_end(Root); SCC != E; ++SCC) {
+      const std::vector<CallGraphNode*> &Nodes = *SCC;
+      for (unsigned n = 0; n < Nodes.size(); n++)
+        Number[Nodes[n]] = SCCs.size();
+      SCCs.push_back(Nodes);
+    }
+
+    // Callees come first in post-order, so they are all numbered by now
+    Callers.resize(SCCs.size());
+    Pending.assign(SCCs.size(), 0);
+    std::vector<unsigned> LastCaller(SCCs.size(), ~0U);
+    for (unsigned i = 0; i < SCCs.size(); i++) {
+      for (unsigned n = 0; n < SCCs[i].size(); n++)
+        for (CallGraphNode::iterator C = SCCs[i][n]->begin(), CE = SCCs[i][n]->end(); C != CE; ++C) {
+          unsigned j = Number.lookup(C->second);
+          if (j == i || LastCaller[j] == i)
+            continue;
+          LastCaller[j] = i;
+          Callers[j].push_back(i);
+          Pending[i]++;
+        }
+      if (Pending[i] == 0)
+        Ready.push_back(i);
+    }
+    Remaining = SCCs.size();
+  }
+
+  static void *run(void *Arg) {
+    SCCQueue *Q = static_cast<SCCQueue*>(Arg);
+    pthread_mutex_lock(&Q->Lock);
+    for (;;) {
+      while (Q->Ready.empty() && Q->Remaining)
+        pthread_cond_wait(&Q->Wake, &Q->Lock);
+      if (!Q->Remaining)
+        break;
+      unsigned i = Q->Ready.back();
+      Q->Ready.pop_back();
+      pthread_mutex_unlock(&Q->Lock);
+
+      Q->Visitor->visitSCC(Q->SCCs[i], i);
+
+      pthread_mutex_lock(&Q->Lock);
+      Q->Remaining--;
+      bool Wakeup = !Q->Remaining;
+      for (unsigned c = 0; c < Q->Callers[i].size(); c++)
+        if (--Q->Pending[Q->Callers[i][c]] == 0) {
+          Q->Ready.push_back(Q->Callers[i][c]);
+          Wakeup = true;
+        }
+      if (Wakeup)
+        pthread_cond_broadcast(&Q->Wake);
+    }
+    pthread_mutex_unlock(&Q->Lock);
+    return 0;
+  }
+};
+
+/// visitCallGraph - Visit the SCCs reachable from the root of CG, callees
+/// before callers, on Threads threads (0 means one per core). With a single
+/// thread the SCCs are visited in post-order.
+inline void visitCallGraph(CallGraph &CG, SCCVisitor &V, unsigned Threads) {
+  CallGraphNode *Root = CG.getRoot();
+  if (Threads == 1) {
+    std::vector<std::vector<CallGraphNode*> > SCCs;
+    for (scc_iterator<CallGraphNode*> SCC = scc_begin(Root), E = scc_end(Root); SCC != E; ++SCC)
+      SCCs.push_back(*SCC);
+    V.startSCCs(SCCs.size());
+    for (unsigned i = 0; i < SCCs.size(); i++)
+      V.visitSCC(SCCs[i], i);
+    return;
+  }
+
+  SCCQueue Q(Root);
+  Q.Visitor = &V;
+  V.startSCCs(Q.SCCs.size());
+  pthread_mutex_init(&Q.Lock, 0);
+  pthread_cond_init(&Q.Wake, 0);
+  if (Threads == 0) {
+    long Cores = sysconf(_SC_NPROCESSORS_ONLN);
+    Threads = Cores > 0 ? Cores : 1;
+  }
+  if (Threads > Q.SCCs.size())
+    Threads = Q.SCCs.size();
+  // The calling thread is one of the workers
+  std::vector<pthread_t> Pool;
+  for (unsigned t = 1; t < Threads; t++) {
+    pthread_t Thread;
+    if (pthread_create(&Thread, 0, SCCQueue::run, &Q) == 0)
+      Pool.push_back(Thread);
+  }
+  SCCQueue::run(&Q);
+  for (unsigned t = 0; t < Pool.size(); t++)
+    pthread_join(Pool[t], 0);
+  pthread_cond_destroy(&Q.Wake);
+  pthread_mutex_destroy(&Q.Lock);
+}
+
+} // End resources namespace
+} // End llvm namespace
+
+#endif
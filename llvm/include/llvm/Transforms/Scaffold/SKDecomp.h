@@ -0,0 +1,63 @@
+//===-- SKDecomp.h - C interface to the SQCT decomposer ---------*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// The sqct rotation decomposer as a shared library (libskdecomp.so, built by
+// 'make shared' in Rotations/sqct). The Rotations pass opens it with dlopen
+// (-sqct-lib) so that the epsilon-net is loaded once per opt run instead of
+// once per angle by a new rotZ process.
+//
+// The interface is plain C so that it does not depend on the compiler or the
+// C++ standard either side is built with. Every entry point has a matching
+// pointer type for dlsym.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCAFFOLD_SKDECOMP_H
+#define LLVM_TRANSFORMS_SCAFFOLD_SKDECOMP_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Bumped whenever a signature below changes.
+#define SKDECOMP_API_VERSION 1
+
+/// An SQCT decomposer with its epsilon-net loaded.
+typedef struct skdecomp skdecomp;
+
+/// skdecomp_api_version - SKDECOMP_API_VERSION the library was built with.
+int skdecomp_api_version(void);
+typedef int (*skdecomp_api_version_fn)(void);
+
+/// skdecomp_create - Generate the missing epsilon-net layers up to max_sde,
+/// as rotZ does, and load them. Returns null on failure.
+skdecomp *skdecomp_create(int max_sde);
+typedef skdecomp *(*skdecomp_create_fn)(int);
+
+/// skdecomp_rotation - Decompose a rotation by angle (radians) about axis
+/// 'X', 'Y' or 'Z' with the given number of Solovay-Kitaev iterations.
+/// Writes the gate string, exactly as rotZ prints it, into buf as a null
+/// terminated string truncated to size bytes, and returns its full length
+/// (call again with a larger buffer if that is not less than size), or -1
+/// on error. A decomposer must only be used by one thread at a time.
+int skdecomp_rotation(skdecomp *d, char axis, double angle, int iterations,
+                      char *buf, size_t size);
+typedef int (*skdecomp_rotation_fn)(skdecomp *, char, double, int, char *,
+                                    size_t);
+
+/// skdecomp_destroy - Free a decomposer.
+void skdecomp_destroy(skdecomp *d);
+typedef void (*skdecomp_destroy_fn)(skdecomp *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
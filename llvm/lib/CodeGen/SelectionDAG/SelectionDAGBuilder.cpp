@@ -5168,6 +5168,7 @@ SelectionDAGBuilder::visitIntrinsicCall(const CallInst &I, unsigned Intrinsic) {
   case Intrinsic::MeasZ:
   case Intrinsic::Toffoli:
   case Intrinsic::Fredkin:
+  case Intrinsic::CliffordTSeq:
     visitQuantumGate(I);
     return 0;   
 
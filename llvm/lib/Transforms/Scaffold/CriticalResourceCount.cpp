@@ -27,11 +27,16 @@
 #include "llvm/ADT/ilist.h"
 #include "llvm/Constants.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Scaffold/SCCSchedule.h"
 
 
 using namespace llvm;
 using namespace std;
 
+// Defined in ResourceCount.cpp
+extern cl::opt<unsigned> ResourceThreads;
+
 #define MAX_GATE_ARGS 15
 #define MAX_BT_COUNT 15 //max backtrace allowed - to avoid infinite recursive loops
 #define NUM_QGATES 17
@@ -97,13 +102,21 @@ struct qGate{
   struct MaxTSInfo{ //TimeStepInfo
     unsigned long long int timesteps;
     unsigned long long int parallel_gates[NUM_QGATES];
-    MaxTSInfo(): timesteps(0){ }
+    MaxTSInfo(): timesteps(0){
+      for(int i=0; i<NUM_QGATES; i++) parallel_gates[i] = 0;
+    }
   };
 
-  struct CriticalResourceCount : public ModulePass {
-    static char ID; // Pass identification
-    
-    string gate_name[NUM_QGATES];
+  // The timesteps of the function being analyzed. Every SCC task has its
+  // own, so independent SCCs of the call graph can be analyzed at the same
+  // time. The results of a function go to its entries of the shared maps,
+  // which are all created before any task runs.
+  struct FunctionCriticalPath {
+    const string *gate_name;
+    map<string, TSInfo > &funcParallelFactor; //string is function name
+    map<string, MaxTSInfo> &funcMaxParallelFactor;
+    raw_ostream &Out;
+
     vector<qGateArg> tmpDepQbit;
     vector<Value*> vectQbit;
     
@@ -112,18 +125,57 @@ struct qGate{
     vector<qArgInfo> currTimeStep; //contains set of arguments operated on currently
     vector<string> currParallelFunc;
     MaxTSInfo maxParallelFactor; //overall max parallel factor
-    map<string, int> gate_index;    
     vector<unsigned long long int> curr_parallel_ts; //vector of current timesteps that are parallel; used for comparing functions
-    map<string, TSInfo > funcParallelFactor; //string is function name
-    map<string, MaxTSInfo> funcMaxParallelFactor;
 
-        
-    CriticalResourceCount() : ModulePass(ID) {}
+    FunctionCriticalPath(const string *gate_name,
+                         map<string, TSInfo> &funcParallelFactor,
+                         map<string, MaxTSInfo> &funcMaxParallelFactor,
+                         raw_ostream &Out)
+      : gate_name(gate_name), funcParallelFactor(funcParallelFactor),
+        funcMaxParallelFactor(funcMaxParallelFactor), Out(Out), btCount(0) {}
     
     bool backtraceOperand(Value* opd, int opOrIndex);
     void analyzeAllocInst(Function* F,Instruction* pinst);
     void analyzeCallInst(Function* F,Instruction* pinst);
     void getFunctionArguments(Function *F);
+
+    void init_critical_path_algo(Function* F);
+    void reset_current_ts_info(Function* F);
+    void print_current_ts_info();
+    void print_vector_TSGates(Function* F);
+    void print_max_critical_info(MaxTSInfo ts);
+    void update_max_critical_info(Function* F);
+    void calc_critical_time(Function* F, qGate qg);        
+    void update_currParallelFunc(TSInfo ts);                
+    void print_currParallelFunc();
+    void print_TSInfo(TSInfo ts);
+    void copy_max_parallel_factor(Function *F);
+
+    void print_qgateArg(qGateArg qg)
+    {
+      Out<< "Printing QGate Argument:\n";
+      if(qg.argPtr) Out << "  Name: "<<qg.argPtr->getName()<<"\n";
+      Out << "  Arg Num: "<<qg.argNum<<"\n"
+	     << "  isUndef: "<<qg.isUndef
+	     << "  isQbit: "<<qg.isQbit
+	     << "  isCbit: "<<qg.isCbit
+	     << "  isPtr: "<<qg.isPtr << "\n"
+	     << "  Value or Index: "<<qg.valOrIndex<<"\n";
+    }                    
+    
+    void CountCriticalFunctionResources (Function *F);
+  }; // End of struct FunctionCriticalPath
+
+  struct CriticalResourceCount : public ModulePass {
+    static char ID; // Pass identification
+    
+    string gate_name[NUM_QGATES];
+    map<string, int> gate_index;    
+    map<string, TSInfo > funcParallelFactor; //string is function name
+    map<string, MaxTSInfo> funcMaxParallelFactor;
+
+        
+    CriticalResourceCount() : ModulePass(ID) {}
     
     
     void init_gate_names(){
@@ -168,31 +220,6 @@ struct qGate{
         
 
     void init_gates_as_functions();    
-    void init_critical_path_algo(Function* F);
-    void reset_current_ts_info(Function* F);
-    void print_current_ts_info();
-    void print_vector_TSGates(Function* F);
-    void print_max_critical_info(MaxTSInfo ts);
-    void update_max_critical_info(Function* F);
-    void calc_critical_time(Function* F, qGate qg);        
-    void update_currParallelFunc(TSInfo ts);                
-    void print_currParallelFunc();
-    void print_TSInfo(TSInfo ts);
-    void copy_max_parallel_factor(Function *F);
-
-    void print_qgateArg(qGateArg qg)
-    {
-      errs()<< "Printing QGate Argument:\n";
-      if(qg.argPtr) errs() << "  Name: "<<qg.argPtr->getName()<<"\n";
-      errs() << "  Arg Num: "<<qg.argNum<<"\n"
-	     << "  isUndef: "<<qg.isUndef
-	     << "  isQbit: "<<qg.isQbit
-	     << "  isCbit: "<<qg.isCbit
-	     << "  isPtr: "<<qg.isPtr << "\n"
-	     << "  Value or Index: "<<qg.valOrIndex<<"\n";
-    }                    
-    
-    void CountCriticalFunctionResources (Function *F);
     
     bool runOnModule (Module &M);
     
@@ -210,11 +237,11 @@ struct qGate{
 char CriticalResourceCount::ID = 0;
 static RegisterPass<CriticalResourceCount> X("CriticalResourceCount", "Critical Resource Counter Pass");
 
-void CriticalResourceCount::getFunctionArguments(Function* F)
+void FunctionCriticalPath::getFunctionArguments(Function* F)
 {
   for(Function::arg_iterator ait=F->arg_begin();ait!=F->arg_end();++ait)
     {    
-      //if(ait) errs() << "Argument: "<<ait->getName()<< " ";
+      //if(ait) Out << "Argument: "<<ait->getName()<< " ";
 
       string argName = (ait->getName()).str();
       Type* argType = ait->getType();
@@ -249,7 +276,7 @@ void CriticalResourceCount::getFunctionArguments(Function* F)
     }
 }
 
-bool CriticalResourceCount::backtraceOperand(Value* opd, int opOrIndex)
+bool FunctionCriticalPath::backtraceOperand(Value* opd, int opOrIndex)
 {
   if(opOrIndex == 0) //backtrace for operand
     {
@@ -372,7 +399,7 @@ bool CriticalResourceCount::backtraceOperand(Value* opd, int opOrIndex)
 }
 
 
-void CriticalResourceCount::analyzeAllocInst(Function* F, Instruction* pInst){
+void FunctionCriticalPath::analyzeAllocInst(Function* F, Instruction* pInst){
   if (AllocaInst *AI = dyn_cast<AllocaInst>(pInst)) {
     Type *allocatedType = AI->getAllocatedType();
     
@@ -399,11 +426,11 @@ void CriticalResourceCount::analyzeAllocInst(Function* F, Instruction* pInst){
 }
 
 
-void CriticalResourceCount::init_critical_path_algo(Function* F){
+void FunctionCriticalPath::init_critical_path_algo(Function* F){
 
   MaxTSInfo structMaxInfo;
-  TSInfo vectGateInfo; //initialize an entry in the function map
-  funcParallelFactor[F->getName().str()] = vectGateInfo;
+  TSInfo vectGateInfo; //reset the entry of F in the function map
+  funcParallelFactor.find(F->getName().str())->second = vectGateInfo;
 
   currTimeStep.clear(); //initialize critical time steps   
 
@@ -415,31 +442,31 @@ void CriticalResourceCount::init_critical_path_algo(Function* F){
     maxParallelFactor.parallel_gates[i] = 0;
     structMaxInfo.parallel_gates[i] = 0;
   }
-  funcMaxParallelFactor[F->getName().str()] = structMaxInfo;
+  funcMaxParallelFactor.find(F->getName().str())->second = structMaxInfo;
   currParallelFunc.clear();
 }
 
 
-void CriticalResourceCount::print_vector_TSGates(Function* F){
+void FunctionCriticalPath::print_vector_TSGates(Function* F){
   map<string, TSInfo>::iterator fp = funcParallelFactor.find(F->getName().str());
-  errs() << "Printing function map \n";
+  Out << "Printing function map \n";
   for(vector<TSParGateInfo>::iterator vit = (*fp).second.gates.begin(); vit!=(*fp).second.gates.end(); ++vit){
     for(int i=0; i< NUM_QGATES ; i++){
-      errs() << (*vit).parallel_gates[i] << " ";
+      Out << (*vit).parallel_gates[i] << " ";
     }
-    errs() << "\n";
+    Out << "\n";
   }
 }
 
-void CriticalResourceCount::print_currParallelFunc(){
-  errs() << "currParallelFunc: ";
+void FunctionCriticalPath::print_currParallelFunc(){
+  Out << "currParallelFunc: ";
   for(vector<string>::iterator vit = currParallelFunc.begin(); vit!=currParallelFunc.end(); ++vit){
-      errs() << (*vit) << " ";
+      Out << (*vit) << " ";
     }
-    errs() << "\n";
+    Out << "\n";
   }
 
-void CriticalResourceCount::reset_current_ts_info(Function* F){ //current timestep info
+void FunctionCriticalPath::reset_current_ts_info(Function* F){ //current timestep info
 
   //clear arguments being operated upon
   currTimeStep.clear(); //initialize critical time steps
@@ -448,7 +475,7 @@ void CriticalResourceCount::reset_current_ts_info(Function* F){ //current timest
 
   if(debugCritDataPath){
     print_currParallelFunc();
-    errs() << " --------------- \n";
+    Out << " --------------- \n";
   }
 
   currParallelFunc.clear();
@@ -458,32 +485,32 @@ void CriticalResourceCount::reset_current_ts_info(Function* F){ //current timest
   
 }
 
-void CriticalResourceCount::print_current_ts_info(){ //current timestep info
-  errs() << "\n Current Critical Time Steps = "<<maxParallelFactor.timesteps << " ";
+void FunctionCriticalPath::print_current_ts_info(){ //current timestep info
+  Out << "\n Current Critical Time Steps = "<<maxParallelFactor.timesteps << " ";
   for(vector<string>::iterator vit = currParallelFunc.begin(); vit!=currParallelFunc.end(); ++vit)
-      errs() << (*vit) << " ";
-    errs() << "\n" ;
+      Out << (*vit) << " ";
+    Out << "\n" ;
   
 }
 
-void CriticalResourceCount::print_max_critical_info(MaxTSInfo ts){ //max timestep info
-    errs() << "MAX Critical Time Steps = "<<ts.timesteps << "\n";
-    errs() << "MAX Parallelism Factors: \n";
+void FunctionCriticalPath::print_max_critical_info(MaxTSInfo ts){ //max timestep info
+    Out << "MAX Critical Time Steps = "<<ts.timesteps << "\n";
+    Out << "MAX Parallelism Factors: \n";
     for(int i=0; i<NUM_QGATES; i++)
-      errs() << "\t" << gate_name[i] << ": " << ts.parallel_gates[i] << "\n";
-    errs() << "\n" ;
+      Out << "\t" << gate_name[i] << ": " << ts.parallel_gates[i] << "\n";
+    Out << "\n" ;
 }
 
-void CriticalResourceCount::print_TSInfo(TSInfo ts){
+void FunctionCriticalPath::print_TSInfo(TSInfo ts){
     for(vector<TSParGateInfo>::iterator printIt = ts.gates.begin(); printIt!=ts.gates.end(); ++ printIt)
       {
 	for(int print_var = 0; print_var < NUM_QGATES; print_var++)
-	  errs() << (*printIt).parallel_gates[print_var] << " ";
-	errs() << "\n";
+	  Out << (*printIt).parallel_gates[print_var] << " ";
+	Out << "\n";
       }
 }
 
-void CriticalResourceCount::update_max_critical_info(Function* F){ //max timestep info
+void FunctionCriticalPath::update_max_critical_info(Function* F){ //max timestep info
 
   if(currParallelFunc.size()>1)
   {
@@ -497,14 +524,14 @@ void CriticalResourceCount::update_max_critical_info(Function* F){ //max timeste
     for(vector<string>::iterator vit=currParallelFunc.begin(); vit!=currParallelFunc.end(); ++vit){
       map<string,TSInfo>::iterator tsIter = funcParallelFactor.find(*vit);
       if(debugCritDataPath)
-	errs() << "Timesteps of function: " << (*vit) << " are " << (*tsIter).second.timesteps << "\n";
+	Out << "Timesteps of function: " << (*vit) << " are " << (*tsIter).second.timesteps << "\n";
       if((*tsIter).second.timesteps > sum_info.timesteps)
 	sum_info.timesteps = (*tsIter).second.timesteps;
       
       unsigned int vsize = sum_info.gates.size();
       unsigned int fnsize = (*tsIter).second.gates.size();
       
-      //errs() << "vsize = "<<vsize<< " fnSize = "<<fnsize <<"\n";
+      //Out << "vsize = "<<vsize<< " fnSize = "<<fnsize <<"\n";
 
       if(vsize<fnsize){
 	for(unsigned int j=0; j<vsize;j++){
@@ -552,7 +579,7 @@ void CriticalResourceCount::update_max_critical_info(Function* F){ //max timeste
     tsIter = funcParallelFactor.find(fStr);
 
     if(debugCritDataPath)
-      errs() << "Timesteps of function: " << fStr << " are " << (*tsIter).second.timesteps << "\n";
+      Out << "Timesteps of function: " << fStr << " are " << (*tsIter).second.timesteps << "\n";
 
     //save TSInfo
     if(F->getName() != "main"){ //do not save for main
@@ -574,7 +601,7 @@ void CriticalResourceCount::update_max_critical_info(Function* F){ //max timeste
   }  
 }
 
-void CriticalResourceCount::calc_critical_time(Function* F, qGate qg){
+void FunctionCriticalPath::calc_critical_time(Function* F, qGate qg){
   string fname = qg.qFunc->getName();
   
   //check each arg with args in currTimeStep
@@ -629,11 +656,11 @@ void CriticalResourceCount::calc_critical_time(Function* F, qGate qg){
 
 
 
-void CriticalResourceCount::analyzeCallInst(Function* F, Instruction* pInst){
+void FunctionCriticalPath::analyzeCallInst(Function* F, Instruction* pInst){
   if(CallInst *CI = dyn_cast<CallInst>(pInst))
     {      
       if(debugCritDataPath)
-	errs() << "Call inst: " << CI->getCalledFunction()->getName() << "\n";
+	Out << "Call inst: " << CI->getCalledFunction()->getName() << "\n";
 
       if(CI->getCalledFunction()->getName() == "store_cbit"){	//trace return values
 	return;
@@ -653,7 +680,7 @@ void CriticalResourceCount::analyzeCallInst(Function* F, Instruction* pInst){
 	
 	
 	if(isa<UndefValue>(CI->getArgOperand(iop))){
-	  errs() << "WARNING: LLVM IR code has UNDEF values. \n";
+	  Out << "WARNING: LLVM IR code has UNDEF values. \n";
 	  tmpQGateArg.isUndef = true;	
 	  //exit(1);
 	}
@@ -692,16 +719,16 @@ void CriticalResourceCount::analyzeCallInst(Function* F, Instruction* pInst){
       if(allDepQbit.size() > 0){
 	if(debugCritDataPath)
 	  {
-	    errs() << "\nCall inst: " << CI->getCalledFunction()->getName();	    
-	    errs() << ": Found all arguments: ";       
+	    Out << "\nCall inst: " << CI->getCalledFunction()->getName();	    
+	    Out << ": Found all arguments: ";       
 	    for(unsigned int vb=0; vb<allDepQbit.size(); vb++){
 	      if(allDepQbit[vb].argPtr)
-		errs() << allDepQbit[vb].argPtr->getName() <<" Index: ";
+		Out << allDepQbit[vb].argPtr->getName() <<" Index: ";
                                 
 	      //else
-		errs() << allDepQbit[vb].valOrIndex <<" ";
+		Out << allDepQbit[vb].valOrIndex <<" ";
 	    }
-	    errs()<<"\n";
+	    Out<<"\n";
 	    
 	  }
           
@@ -725,7 +752,7 @@ void CriticalResourceCount::analyzeCallInst(Function* F, Instruction* pInst){
     }
 }
 
-void CriticalResourceCount::copy_max_parallel_factor(Function *F){
+void FunctionCriticalPath::copy_max_parallel_factor(Function *F){
   map<string, MaxTSInfo>::iterator fparIter = funcMaxParallelFactor.find(F->getName().str());
   (*fparIter).second.timesteps = maxParallelFactor.timesteps;
   for(int i=0;i<NUM_QGATES;i++)
@@ -734,7 +761,7 @@ void CriticalResourceCount::copy_max_parallel_factor(Function *F){
     }
 }
 
-void CriticalResourceCount::CountCriticalFunctionResources (Function *F) {
+void FunctionCriticalPath::CountCriticalFunctionResources (Function *F) {
       // Traverse instruction by instruction
   init_critical_path_algo(F);
   
@@ -791,33 +818,57 @@ void CriticalResourceCount::init_gates_as_functions(){
 }
 
 
-bool CriticalResourceCount::runOnModule (Module &M) {
-  init_gate_names();
-  init_gates_as_functions();
-  
-  // iterate over all functions, and over all instructions in those functions
-  CallGraphNode* rootNode = getAnalysis<CallGraph>().getRoot();
-  
-  //Post-order
-  for (scc_iterator<CallGraphNode*> sccIb = scc_begin(rootNode), E = scc_end(rootNode); sccIb != E; ++sccIb) {
-    const std::vector<CallGraphNode*> &nextSCC = *sccIb;
-    for (std::vector<CallGraphNode*>::const_iterator nsccI = nextSCC.begin(), E = nextSCC.end(); nsccI != E; ++nsccI) {
+// Analyzes every SCC into its own output, which is printed in post-order
+// once all SCCs are done
+struct CriticalSCCVisitor : public resources::SCCVisitor {
+  CriticalResourceCount &Pass;
+  vector<string> Output;
+
+  explicit CriticalSCCVisitor(CriticalResourceCount &P) : Pass(P) {}
+
+  virtual void startSCCs(unsigned NumSCCs) {
+    Output.resize(NumSCCs);
+  }
+
+  virtual void visitSCC(const vector<CallGraphNode*> &nextSCC, unsigned Index) {
+    raw_string_ostream Out(Output[Index]);
+    for (vector<CallGraphNode*>::const_iterator nsccI = nextSCC.begin(), E = nextSCC.end(); nsccI != E; ++nsccI) {
       Function *F = (*nsccI)->getFunction();	  
             
       if(F && !F->isDeclaration()){
-      errs() << "\nFunction: " << F->getName() << "\n";      
+      Out << "\nFunction: " << F->getName() << "\n";      
 
-      getFunctionArguments(F);
+      FunctionCriticalPath Path(Pass.gate_name, Pass.funcParallelFactor,
+                                Pass.funcMaxParallelFactor, Out);
+      Path.getFunctionArguments(F);
       
       // count the critical resources for this function
-      CountCriticalFunctionResources(F);
+      Path.CountCriticalFunctionResources(F);
 
     }
       else{
 	    if(debugCritDataPath)
-	      errs() << "WARNING: Ignoring external node or dummy function.\n";
+	      Out << "WARNING: Ignoring external node or dummy function.\n";
 	  }
     }
-  }  
+  }
+};
+
+bool CriticalResourceCount::runOnModule (Module &M) {
+  init_gate_names();
+  init_gates_as_functions();
+
+  // every function gets its map entries now; the SCC tasks only update them
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration()) {
+      funcParallelFactor[F->getName().str()] = TSInfo();
+      funcMaxParallelFactor[F->getName().str()] = MaxTSInfo();
+    }
+  
+  //Post-order
+  CriticalSCCVisitor Visitor(*this);
+  resources::visitCallGraph(getAnalysis<CallGraph>(), Visitor, ResourceThreads);
+  for (unsigned i = 0; i < Visitor.Output.size(); i++)
+    errs() << Visitor.Output[i];
   return false;
 } // End runOnModule
@@ -0,0 +1,539 @@
+//===------------------------- GenFlatQASM.cpp ---------------------------===//
+// This file implements the Scaffold pass that writes flattened QASM: every
+// module call reachable from main is expanded in place until only gates on
+// named qubits remain.
+//
+// The output is the same as the earlier flow of translating -gen-qasm output
+// to C with flatten-qasm.py, compiling it and running the binary: a list of
+// "qubit <name>" and "cbit <name>" declarations followed by one gate per
+// line. Ancilla qubits allocated outside main get an 'a' suffix.
+//
+// Each quantum function is first compiled into a list of gates and calls
+// whose operands are slots of local arrays or offsets into arguments; the
+// expansion then walks these lists and streams gates to a buffered writer.
+// With -flat-qasm-binary the gates are written in the QTrace format instead
+// of text. Packed llvm.CliffordTSeq calls from the Rotations pass are only
+// expanded here, one gate per letter.
+//
+//        This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "GenFlatQASM"
+#include <string>
+#include <vector>
+#include "llvm/Pass.h"
+#include "llvm/Module.h"
+#include "llvm/Function.h"
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instruction.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Transforms/Scaffold/CliffordTSeq.h"
+#include "llvm/Transforms/Scaffold/QTrace.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumFlatGates, "Number of gates written to flat QASM");
+STATISTIC(NumUnresolvedOperands, "Number of gate operands that could not be resolved");
+
+static cl::opt<bool>
+FlatQASMBinary("flat-qasm-binary", cl::init(false),
+  cl::desc("Write flattened QASM as a compact binary trace (QTrace.h)"));
+
+static cl::opt<unsigned>
+FlatMaxCallDepth("flat-qasm-max-depth", cl::init(10000), cl::Hidden,
+  cl::desc("Maximum module call depth while flattening QASM"));
+
+// An anonymous namespace for the pass. Things declared inside it are
+// only visible to the current file.
+namespace {
+
+  // Where a gate or call operand comes from
+  struct Operand {
+    enum Kind { Undef, Local, Arg, Const };
+    Kind kind;
+    unsigned idx;     // index into the local arrays for Local, argument number for Arg
+    unsigned offset;  // element offset into the local array or argument
+    double val;       // value for Const (angles, Prep values)
+    Operand() : kind(Undef), idx(0), offset(0), val(0.0) {}
+  };
+
+  // Value of an operand in one invocation of a function: qubits are an
+  // element of a local array, since the elements of one array need not have
+  // consecutive name ids
+  struct FrameVal {
+    int array;      // index into the local arrays, -1 if not a qubit
+    unsigned elem;  // element of that array
+    double val;
+    FrameVal() : array(-1), elem(0), val(0.0) {}
+  };
+
+  // A gate or a call to another quantum function
+  struct FlatOp {
+    Intrinsic::ID gate;   // not_intrinsic for calls
+    int callee;           // index into the compiled functions for calls
+    SmallVector<Operand, 3> args;
+    StringRef seq;        // gates of a CliffordTSeq
+  };
+
+  struct FlatFunction {
+    Function *F;
+    std::vector<FlatOp> ops;
+  };
+
+  // Writes the flat gate list, as text or as a QTrace; all output goes
+  // through one buffered stream
+  class FlatQASMWriter {
+    raw_ostream &OS;
+    const std::vector<std::string> &Names;
+    qtrace::Writer<raw_ostream> *Bin;
+    int UndefId;  // name id written for unresolved operands
+
+    void name(int id) {
+      if (id < 0) OS << "UNDEF";
+      else OS << Names[id];
+    }
+    qtrace::u64 binId(int id) const { return id < 0 ? UndefId : id; }
+
+  public:
+    FlatQASMWriter(raw_ostream &os, const std::vector<std::string> &names,
+                   qtrace::Writer<raw_ostream> *bin, int undefId)
+      : OS(os), Names(names), Bin(bin), UndefId(undefId) {}
+
+    void declare(bool isCbit, int id) {
+      if (Bin) Bin->declare(id, Names[id], isCbit);
+      else OS << (isCbit ? "cbit " : "qubit ") << Names[id] << "\n";
+    }
+
+    void gate(qtrace::OpCode G, int a) {
+      ++NumFlatGates;
+      if (Bin) { Bin->gate(G, binId(a)); return; }
+      OS << qtrace::getName(G) << " "; name(a); OS << "\n";
+    }
+
+    void gate(qtrace::OpCode G, int a, int b) {
+      ++NumFlatGates;
+      if (Bin) { Bin->gate(G, binId(a), binId(b)); return; }
+      OS << qtrace::getName(G) << " "; name(a); OS << ","; name(b); OS << "\n";
+    }
+
+    void gate(qtrace::OpCode G, int a, int b, int c) {
+      ++NumFlatGates;
+      if (Bin) { Bin->gate(G, binId(a), binId(b), binId(c)); return; }
+      OS << qtrace::getName(G) << " "; name(a); OS << ","; name(b); OS << ",";
+      name(c); OS << "\n";
+    }
+
+    void rotation(qtrace::OpCode G, int a, double angle) {
+      ++NumFlatGates;
+      if (Bin) { Bin->rotation(G, binId(a), angle); return; }
+      OS << qtrace::getName(G) << " "; name(a); OS << "," << format("%f", angle) << "\n";
+    }
+  };
+
+  struct GenFlatQASM : public ModulePass {
+    static char ID; // Pass identification
+    GenFlatQASM() : ModulePass(ID) {}
+
+    std::vector<FlatFunction> Funcs;
+    DenseMap<Function*, int> FuncIndex;
+    DenseMap<const Value*, unsigned> LocalIndex; // alloca -> index in Locals
+    std::vector<std::vector<unsigned> > Locals;  // name ids of each array's elements
+    std::vector<std::string> Names;
+    std::vector<bool> NameIsCbit;
+    StringMap<unsigned> NameIds;
+    std::vector<unsigned> Decls;                 // name ids in declaration order
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<CallGraph>();
+    }
+
+    // same variable naming as GenQASM: strip ".addr" and trailing dots
+    static std::string varName(StringRef s) {
+      std::string sName = s.str();
+      size_t pos = sName.rfind("..");
+      if (pos != std::string::npos && pos == sName.length()-2)
+        return sName.substr(0, pos);
+      pos = sName.rfind(".");
+      if (pos != std::string::npos && pos == sName.length()-1)
+        return sName.substr(0, pos);
+      return sName.substr(0, sName.find(".addr"));
+    }
+
+    // number of i16/i1 elements in a (possibly nested) array type
+    static uint64_t numElements(Type *T) {
+      uint64_t N = 1;
+      while (ArrayType *AT = dyn_cast<ArrayType>(T)) {
+        N *= AT->getNumElements();
+        T = AT->getElementType();
+      }
+      return N;
+    }
+
+    static bool isBitType(Type *T, bool &isCbit) {
+      while (ArrayType *AT = dyn_cast<ArrayType>(T))
+        T = AT->getElementType();
+      isCbit = T->isIntegerTy(1);
+      return T->isIntegerTy(16) || isCbit;
+    }
+
+    unsigned internName(const std::string &S, bool isCbit) {
+      StringMap<unsigned>::iterator I = NameIds.find(S);
+      if (I != NameIds.end()) {
+        // cbits are listed once per declaration, as the old flow did
+        if (isCbit) Decls.push_back(I->second);
+        return I->second;
+      }
+      unsigned Id = Names.size();
+      Names.push_back(S);
+      NameIsCbit.push_back(isCbit);
+      NameIds[S] = Id;
+      Decls.push_back(Id);
+      return Id;
+    }
+
+    // qbit/cbit arrays allocated in F get one name per element; arrays of
+    // the same name in different functions share the names they have in
+    // common
+    void declareLocals(Function *F, bool isMain) {
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        AllocaInst *AI = dyn_cast<AllocaInst>(&*I);
+        bool isCbit;
+        if (!AI || !isBitType(AI->getAllocatedType(), isCbit))
+          continue;
+        uint64_t N = numElements(AI->getAllocatedType());
+        if (ConstantInt *CI = dyn_cast<ConstantInt>(AI->getArraySize()))
+          N *= CI->getZExtValue();
+        std::string Base = varName(AI->getName());
+        const char *Suffix = (isMain || isCbit) ? "" : "a";
+        LocalIndex[AI] = Locals.size();
+        Locals.push_back(std::vector<unsigned>());
+        std::vector<unsigned> &Ids = Locals.back();
+        Ids.reserve(N);
+        for (uint64_t i = 0; i < N; i++) {
+          std::string S;
+          raw_string_ostream(S) << Base << i << Suffix;
+          Ids.push_back(internName(S, isCbit));
+        }
+      }
+    }
+
+    // quantum functions declare qbits/cbits or take them as arguments
+    static bool isQuantumFunction(Function *F) {
+      bool isCbit;
+      for (Function::arg_iterator A = F->arg_begin(), E = F->arg_end(); A != E; ++A) {
+        Type *T = A->getType();
+        if (PointerType *PT = dyn_cast<PointerType>(T))
+          T = PT->getElementType();
+        if (isBitType(T, isCbit))
+          return true;
+      }
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+        if (AllocaInst *AI = dyn_cast<AllocaInst>(&*I))
+          if (isBitType(AI->getAllocatedType(), isCbit))
+            return true;
+      return false;
+    }
+
+    // resolve a pointer to a qbit/cbit element
+    Operand resolvePointer(Value *V) {
+      Operand Op;
+      if (AllocaInst *AI = dyn_cast<AllocaInst>(V)) {
+        DenseMap<const Value*, unsigned>::iterator I = LocalIndex.find(AI);
+        if (I != LocalIndex.end()) {
+          Op.kind = Operand::Local;
+          Op.idx = I->second;
+        }
+        return Op;
+      }
+      if (Argument *A = dyn_cast<Argument>(V)) {
+        Op.kind = Operand::Arg;
+        Op.idx = A->getArgNo();
+        return Op;
+      }
+      if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(V)) {
+        Op = resolvePointer(GEP->getPointerOperand());
+        if (Op.kind == Operand::Undef)
+          return Op;
+        Type *T = GEP->getPointerOperandType()->getPointerElementType();
+        for (unsigned i = 1, e = GEP->getNumOperands(); i != e; ++i) {
+          ConstantInt *CI = dyn_cast<ConstantInt>(GEP->getOperand(i));
+          if (!CI) {
+            Op.kind = Operand::Undef;
+            return Op;
+          }
+          // the first index steps over whole objects, later ones into arrays
+          if (i > 1) T = cast<ArrayType>(T)->getElementType();
+          Op.offset += CI->getZExtValue() * numElements(T);
+        }
+        return Op;
+      }
+      if (CastInst *CI = dyn_cast<CastInst>(V))
+        return resolvePointer(CI->getOperand(0));
+      return Op;
+    }
+
+    Operand resolveOperand(Value *V) {
+      Operand Op;
+      if (ConstantInt *CI = dyn_cast<ConstantInt>(V)) {
+        Op.kind = Operand::Const;
+        Op.val = CI->getSExtValue();
+      }
+      else if (ConstantFP *CF = dyn_cast<ConstantFP>(V)) {
+        Op.kind = Operand::Const;
+        Op.val = CF->getValueAPF().convertToDouble();
+      }
+      else if (LoadInst *LI = dyn_cast<LoadInst>(V))
+        Op = resolvePointer(LI->getPointerOperand());
+      else if (Argument *A = dyn_cast<Argument>(V)) {
+        Op.kind = Operand::Arg;
+        Op.idx = A->getArgNo();
+      }
+      else if (V->getType()->isPointerTy())
+        Op = resolvePointer(V);
+      return Op;
+    }
+
+    static bool isFlatGate(Intrinsic::ID ID) {
+      switch (ID) {
+      case Intrinsic::CNOT: case Intrinsic::Toffoli: case Intrinsic::Fredkin:
+      case Intrinsic::H: case Intrinsic::X: case Intrinsic::Y: case Intrinsic::Z:
+      case Intrinsic::S: case Intrinsic::Sdag: case Intrinsic::T: case Intrinsic::Tdag:
+      case Intrinsic::Rx: case Intrinsic::Ry: case Intrinsic::Rz:
+      case Intrinsic::PrepX: case Intrinsic::PrepZ:
+      case Intrinsic::MeasX: case Intrinsic::MeasZ:
+      case Intrinsic::CliffordTSeq:
+        return true;
+      default:
+        return false;
+      }
+    }
+
+    void compileFunction(FlatFunction &FF) {
+      for (inst_iterator I = inst_begin(FF.F), E = inst_end(FF.F); I != E; ++I) {
+        CallInst *CI = dyn_cast<CallInst>(&*I);
+        if (!CI || !CI->getCalledFunction())
+          continue;
+        Function *Callee = CI->getCalledFunction();
+
+        FlatOp Op;
+        Op.gate = (Intrinsic::ID)Callee->getIntrinsicID();
+        Op.callee = -1;
+        if (!isFlatGate(Op.gate)) {
+          DenseMap<Function*, int>::iterator CalleeIt = FuncIndex.find(Callee);
+          if (CalleeIt == FuncIndex.end())
+            continue;  // classical helper or declaration
+          Op.gate = Intrinsic::not_intrinsic;
+          Op.callee = CalleeIt->second;
+        }
+        // the gate string of a sequence is kept as it is, not as an operand
+        unsigned NumArgs = CI->getNumArgOperands();
+        if (cliffordt::getGates(CI, Op.seq))
+          NumArgs = 1;
+        for (unsigned i = 0; i != NumArgs; ++i) {
+          Operand A = resolveOperand(CI->getArgOperand(i));
+          if (A.kind == Operand::Undef && Op.callee < 0)
+            ++NumUnresolvedOperands;
+          Op.args.push_back(A);
+        }
+        FF.ops.push_back(Op);
+      }
+    }
+
+    static FrameVal evaluate(const Operand &Op, const std::vector<FrameVal> &Frame) {
+      FrameVal V;
+      switch (Op.kind) {
+      case Operand::Local:
+        V.array = Op.idx;
+        V.elem = Op.offset;
+        break;
+      case Operand::Arg:
+        if (Op.idx < Frame.size()) {
+          V = Frame[Op.idx];
+          if (V.array >= 0) V.elem += Op.offset;
+        }
+        break;
+      case Operand::Const:
+        V.val = Op.val;
+        break;
+      case Operand::Undef:
+        break;
+      }
+      return V;
+    }
+
+    // name id of a qubit value, -1 if it is not one or lies outside its array
+    int qubit(const FrameVal &V) const {
+      if (V.array < 0)
+        return -1;
+      const std::vector<unsigned> &Ids = Locals[V.array];
+      return V.elem < Ids.size() ? (int)Ids[V.elem] : -1;
+    }
+
+    static void emitCliffordT(FlatQASMWriter &W, Intrinsic::ID G, int q0) {
+      switch (G) {
+      case Intrinsic::H: W.gate(qtrace::H, q0); break;
+      case Intrinsic::X: W.gate(qtrace::X, q0); break;
+      case Intrinsic::Y: W.gate(qtrace::Y, q0); break;
+      case Intrinsic::Z: W.gate(qtrace::Z, q0); break;
+      case Intrinsic::S: W.gate(qtrace::S, q0); break;
+      case Intrinsic::T: W.gate(qtrace::T, q0); break;
+      case Intrinsic::Tdag: W.gate(qtrace::Tdag, q0); break;
+      case Intrinsic::Sdag: // Sdag = S^3
+        W.gate(qtrace::S, q0); W.gate(qtrace::S, q0); W.gate(qtrace::S, q0);
+        break;
+      default:
+        break;
+      }
+    }
+
+    void emitGate(FlatQASMWriter &W, const FlatOp &Op, const std::vector<FrameVal> &Frame) {
+      int q0 = qubit(evaluate(Op.args[0], Frame));
+      switch (Op.gate) {
+      case Intrinsic::H: case Intrinsic::X: case Intrinsic::Y: case Intrinsic::Z:
+      case Intrinsic::S: case Intrinsic::Sdag: case Intrinsic::T: case Intrinsic::Tdag:
+        emitCliffordT(W, Op.gate, q0);
+        break;
+      case Intrinsic::CliffordTSeq:
+        for (size_t g = 0; g < Op.seq.size(); g++)
+          emitCliffordT(W, cliffordt::getGate(Op.seq[g]), q0);
+        break;
+      case Intrinsic::MeasX: W.gate(qtrace::MeasX, q0); break;
+      case Intrinsic::MeasZ: W.gate(qtrace::MeasZ, q0); break;
+      case Intrinsic::PrepX:
+      case Intrinsic::PrepZ:
+        W.gate(Op.gate == Intrinsic::PrepX ? qtrace::PrepX : qtrace::PrepZ, q0);
+        if (evaluate(Op.args[1], Frame).val == 1)
+          W.gate(qtrace::X, q0);
+        break;
+      case Intrinsic::Rx:
+      case Intrinsic::Ry:
+      case Intrinsic::Rz:
+        W.rotation(Op.gate == Intrinsic::Rx ? qtrace::Rx :
+                   Op.gate == Intrinsic::Ry ? qtrace::Ry : qtrace::Rz,
+                   q0, evaluate(Op.args[1], Frame).val);
+        break;
+      case Intrinsic::CNOT:
+        W.gate(qtrace::CNOT, q0, qubit(evaluate(Op.args[1], Frame)));
+        break;
+      case Intrinsic::Toffoli:
+      case Intrinsic::Fredkin:
+        W.gate(Op.gate == Intrinsic::Toffoli ? qtrace::Toffoli : qtrace::Fredkin, q0,
+               qubit(evaluate(Op.args[1], Frame)), qubit(evaluate(Op.args[2], Frame)));
+        break;
+      default:
+        break;
+      }
+    }
+
+    // expand one invocation of a function; returns false if the call depth
+    // limit was hit
+    bool expand(FlatQASMWriter &W, const FlatFunction &FF,
+                const std::vector<FrameVal> &Frame, unsigned Depth) {
+      if (Depth > FlatMaxCallDepth) {
+        errs() << "GenFlatQASM: call depth limit reached in " << FF.F->getName()
+               << " (recursive module?)\n";
+        return false;
+      }
+      for (std::vector<FlatOp>::const_iterator I = FF.ops.begin(), E = FF.ops.end(); I != E; ++I) {
+        if (I->callee < 0) {
+          emitGate(W, *I, Frame);
+          continue;
+        }
+        std::vector<FrameVal> CalleeFrame;
+        CalleeFrame.reserve(I->args.size());
+        for (unsigned i = 0, e = I->args.size(); i != e; ++i)
+          CalleeFrame.push_back(evaluate(I->args[i], Frame));
+        if (!expand(W, Funcs[I->callee], CalleeFrame, Depth + 1))
+          return false;
+      }
+      return true;
+    }
+
+    virtual bool runOnModule(Module &M) {
+      // quantum functions in callgraph post-order, like -gen-qasm prints them
+      std::vector<Function*> QFuncs;
+      CallGraphNode *Root = getAnalysis<CallGraph>().getRoot();
+      for (scc_iterator<CallGraphNode*> SCCI = scc_begin(Root), E = scc_end(Root);
+           SCCI != E; ++SCCI) {
+        const std::vector<CallGraphNode*> &SCC = *SCCI;
+        for (std::vector<CallGraphNode*>::const_iterator I = SCC.begin(), IE = SCC.end(); I != IE; ++I) {
+          Function *F = (*I)->getFunction();
+          if (F && !F->isDeclaration() && isQuantumFunction(F))
+            QFuncs.push_back(F);
+        }
+      }
+      if (QFuncs.empty()) {
+        errs() << "GenFlatQASM: no quantum functions found\n";
+        return false;
+      }
+
+      // the entry module is main, or the last one printed if there is none
+      Function *Main = QFuncs.back();
+      for (unsigned i = 0; i < QFuncs.size(); i++)
+        if (QFuncs[i]->getName() == "main")
+          Main = QFuncs[i];
+
+      for (unsigned i = 0; i < QFuncs.size(); i++) {
+        declareLocals(QFuncs[i], QFuncs[i] == Main);
+        FuncIndex[QFuncs[i]] = i;
+        FlatFunction FF;
+        FF.F = QFuncs[i];
+        Funcs.push_back(FF);
+      }
+      for (unsigned i = 0; i < Funcs.size(); i++)
+        compileFunction(Funcs[i]);
+
+      if (NumUnresolvedOperands)
+        errs() << "GenFlatQASM: WARNING: " << NumUnresolvedOperands
+               << " gate operands could not be resolved and are written as UNDEF\n";
+
+      // unresolved operands refer to a qubit named UNDEF in binary traces
+      int UndefId = -1;
+      if (FlatQASMBinary && NumUnresolvedOperands) {
+        UndefId = Names.size();
+        Names.push_back("UNDEF");
+        NameIsCbit.push_back(false);
+        Decls.push_back(UndefId);
+      }
+
+      // buffered stream on stderr, where the other Scaffold passes print
+      raw_fd_ostream Out(2, false);
+      OwningPtr<qtrace::Writer<raw_ostream> > Bin;
+      if (FlatQASMBinary)
+        Bin.reset(new qtrace::Writer<raw_ostream>(Out));
+      FlatQASMWriter W(Out, Names, Bin.get(), UndefId);
+      for (unsigned i = 0; i < Decls.size(); i++)
+        if (!NameIsCbit[Decls[i]])
+          W.declare(false, Decls[i]);
+      for (unsigned i = 0; i < Decls.size(); i++)
+        if (NameIsCbit[Decls[i]])
+          W.declare(true, Decls[i]);
+
+      std::vector<FrameVal> Frame(Main->arg_size());
+      expand(W, Funcs[FuncIndex[Main]], Frame, 0);
+      if (Bin)
+        Bin->end();
+      Out.flush();
+      return false;
+    } // End runOnModule
+  }; // End of struct GenFlatQASM
+} // End of anonymous namespace
+
+char GenFlatQASM::ID = 0;
+static RegisterPass<GenFlatQASM> X("gen-flat-qasm", "Generate flattened QASM output code");
@@ -23,6 +23,7 @@
 #include "llvm/Constants.h"
 #include "llvm/Analysis/DebugInfo.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/Transforms/Scaffold/CliffordTSeq.h"
 
 using namespace llvm;
 using namespace std;
@@ -54,6 +55,7 @@ namespace {
     Function* func;
     Value* instPtr;
     std::vector<qGateArg> qArgs;
+    std::string gateName; //printed instead of func's name for the gates of a CliffordTSeq
   };    
 
   struct GenQASM : public ModulePass {
@@ -567,7 +569,12 @@ void GenQASM::analyzeAllocInstShort(Function* F, Instruction* pInst){
 
       bool tracked_all_operands = true;
 
-      for(unsigned iop=0;iop<CI->getNumArgOperands();iop++){
+      //only the qbit of a packed gate sequence is an operand
+      StringRef seqGates;
+      bool isSeq = cliffordt::getGates(CI, seqGates);
+      unsigned numArgOps = isSeq ? 1 : CI->getNumArgOperands();
+
+      for(unsigned iop=0;iop<numArgOps;iop++){
         tmpDepQbit.clear();
 
         qGateArg tmpQGateArg;
@@ -666,7 +673,18 @@ void GenQASM::analyzeAllocInstShort(Function* F, Instruction* pInst){
 
       //map<Function*, vector<FnCall> >::iterator mvdpit = mapFunction.find(F);	
       //(*mvdpit).second.push_back(qInfo);      
-      mapFunction.push_back(qInfo);
+      if(isSeq){
+        //one line per gate of the sequence
+        for(size_t g=0;g<seqGates.size();g++){
+          Intrinsic::ID gate = cliffordt::getGate(seqGates[g]);
+          if(gate == Intrinsic::not_intrinsic)
+            continue;
+          qInfo.gateName = Intrinsic::getName(gate);
+          mapFunction.push_back(qInfo);
+        }
+      }
+      else
+        mapFunction.push_back(qInfo);
 
       return;      
     }
@@ -804,7 +822,7 @@ void GenQASM::analyzeAllocInstShort(Function* F, Instruction* pInst){
       if(mapFunction[mIndex].qArgs.size()>0)
       {
 
-        string fToPrint = mapFunction[mIndex].func->getName();
+        string fToPrint = mapFunction[mIndex].gateName.empty() ? mapFunction[mIndex].func->getName().str() : mapFunction[mIndex].gateName;
         if(fToPrint.find("llvm.") != string::npos)
           fToPrint = fToPrint.substr(5);
         errs()<<"\t";
@@ -18,6 +18,7 @@
 #include "llvm/Instructions.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/PassAnalysisSupport.h"
 #include "llvm/Analysis/CallGraph.h"
@@ -27,6 +28,7 @@
 #include "llvm/ADT/ilist.h"
 #include "llvm/Constants.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/Transforms/Scaffold/QbitTimesteps.h"
 
 
 using namespace llvm;
@@ -69,9 +71,9 @@ namespace {
   };
 
   struct qArgInfo{
-    string name;
+    int id; //qbit array of the current function
     int index;
-    qArgInfo(): name("none"), index(-1){ }
+    qArgInfo(): id(-1), index(-1){ }
   };
 
   struct qGate{
@@ -104,7 +106,7 @@ namespace {
 
     string gate_name[NUM_QGATES];
     vector<qGateArg> tmpDepQbit;
-    vector<Value*> vectQbit;
+    DenseMap<Value*, int> vectQbit; //qbit array id, -1 for cbits
 
     int btCount; //backtrace count
 
@@ -116,14 +118,14 @@ namespace {
     map<string, allTSParallelism > funcParallelFactor; //string is function name
     map<string, MaxInfo> funcMaxParallelFactor;
 
-    map<string, map<int,uint64_t> > funcQbits; //qbits in current function
-    map<string, map<int,uint64_t> > funcQbitsStart; //start ts of qbits in current function
-    map<string, map<int,uint64_t> > funcQbitsHalf; //qbits in current function
-    map<Function*, map<unsigned int, map<int,uint64_t> > > tableFuncQbits;
-    map<Function*, map<unsigned int, map<int,uint64_t> > > tableFuncQbitsStart;
-    map<string, unsigned int> funcArgs;
+    vector<critpath::QbitArray> funcQbits; //qbits in current function, by id
+    vector<critpath::QbitArray> funcQbitsHalf; //qbits in current function
+    vector<Value*> qbitValue; //id -> qbit array
+    vector<int> funcArgs; //id -> argument number, -1 for allocas
+    map<Function*, critpath::ArgQbits> tableFuncQbits;
+    map<Function*, critpath::ArgQbits> tableFuncQbitsStart;
 
-    map<uint64_t, vector<qGate> > tsGates;
+    vector<vector<qGate> > tsGates; //indexed by timestep
     map<Function*, uint64_t> crit_path_f; 
 
     allTSParallelism currTS;
@@ -136,12 +138,15 @@ namespace {
     GetClassicalCriticalPath() : ModulePass(ID) {}
 
     bool backtraceOperand(Value* opd, int opOrIndex);
+    void addQbitArray(Value* V, int argNum);
     void analyzeAllocInst(Function* F,Instruction* pinst);
     void analyzeCallInst(Function* F,Instruction* pinst);
     void getFunctionArguments(Function *F);
 
+    void saveTable(Function* F, vector<critpath::QbitArray> &qbits, critpath::ArgQbits &table);
     void saveTableFuncQbits(Function* F);
     void saveTableFuncQbitsStart(Function* F);
+    void print_table(map<Function*, critpath::ArgQbits> &table);
     void print_tableFuncQbits();
     void print_tableFuncQbitsStart();
     void print_tsGates();
@@ -187,6 +192,7 @@ namespace {
     void init_gates_as_functions();    
     void init_critical_path_algo(Function* F);
     void calc_critical_time(Function* F, qGate qg);        
+    void print_qbitArrays(vector<critpath::QbitArray> &qbits);
     void print_funcQbits();
     void print_funcQbitsHalf();
     void print_qgate(qGate qg);
@@ -245,7 +251,6 @@ void GetClassicalCriticalPath::getFunctionArguments(Function* F)
   {    
     //if(ait) errs() << "Argument: "<<ait->getName()<< " ";
 
-    string argName = (ait->getName()).str();
     Type* argType = ait->getType();
     unsigned int argNum=ait->getArgNo();         
 
@@ -259,55 +264,41 @@ void GetClassicalCriticalPath::getFunctionArguments(Function* F)
       Type *elementType = argType->getPointerElementType();
       if (elementType->isIntegerTy(16)){ //qbit*
         tmpQArg.isQbit = true;
-        vectQbit.push_back(ait);
-
-        map<int,uint64_t> tmpMap;
-        tmpMap[-1] = 0; //add entry for entire array
-        tmpMap[-2] = 0; //add entry for max
-        funcQbits[argName]=tmpMap;
-
-        map<int,uint64_t> tmpMapHalf;
-        funcQbitsHalf[argName]=tmpMapHalf;
-
-        funcArgs[argName] = argNum;
-
+        addQbitArray(ait, argNum);
       }
       else if (elementType->isIntegerTy(1)){ //cbit*
         tmpQArg.isCbit = true;
-        vectQbit.push_back(ait);
-        funcArgs[argName] = argNum;
+        vectQbit[ait] = -1;
       }
     }
     else if (argType->isIntegerTy(16)){ //qbit
       tmpQArg.isQbit = true;
-      vectQbit.push_back(ait);
-
-      map<int,uint64_t> tmpMap;
-      tmpMap[-1] = 0; //add entry for entire array
-      tmpMap[-2] = 0; //add entry for max
-      funcQbits[argName]=tmpMap;
-
-      map<int,uint64_t> tmpMapHalf;
-      funcQbitsHalf[argName]=tmpMapHalf;
-
-      funcArgs[argName] = argNum;
+      addQbitArray(ait, argNum);
     }
     else if (argType->isIntegerTy(1)){ //cbit
       tmpQArg.isCbit = true;
-      vectQbit.push_back(ait);
-      funcArgs[argName] = argNum;
+      vectQbit[ait] = -1;
     }
 
   }
 }
 
+void GetClassicalCriticalPath::addQbitArray(Value* V, int argNum)
+{
+  //number the qbit array; its timesteps all start at 0
+  vectQbit[V] = funcQbits.size();
+  funcQbits.push_back(critpath::QbitArray());
+  funcQbitsHalf.push_back(critpath::QbitArray());
+  qbitValue.push_back(V);
+  funcArgs.push_back(argNum);
+}
+
 bool GetClassicalCriticalPath::backtraceOperand(Value* opd, int opOrIndex)
 {
   if(opOrIndex == 0) //backtrace for operand
   {
-    //search for opd in qbit/cbit vector
-    vector<Value*>::iterator vIter=find(vectQbit.begin(),vectQbit.end(),opd);
-    if(vIter != vectQbit.end()){
+    //search for opd in qbit/cbit map
+    if(vectQbit.count(opd)){
       tmpDepQbit[0].argPtr = opd;
 
       return true;
@@ -434,23 +425,14 @@ void GetClassicalCriticalPath::analyzeAllocInst(Function* F, Instruction* pInst)
       Type *elementType = arrayType->getElementType();
       uint64_t arraySize = arrayType->getNumElements();
       if (elementType->isIntegerTy(16)){
-        vectQbit.push_back(AI);
+        addQbitArray(AI, -1); //add qbit to funcQbits
         tmpQArg.isQbit = true;
         tmpQArg.argPtr = AI;
         tmpQArg.valOrIndex = arraySize;
-
-        map<int,uint64_t> tmpMap; //add qbit to funcQbits
-        tmpMap[-1] = 0; //entry for entire array
-        tmpMap[-2] = 0; //entry for max
-        funcQbits[AI->getName()]=tmpMap;
-
-        map<int,uint64_t> tmpMapHalf;
-        funcQbitsHalf[AI->getName()]=tmpMapHalf;
-
       }
 
       if (elementType->isIntegerTy(1)){
-        vectQbit.push_back(AI); //Cbit added here
+        vectQbit[AI] = -1; //Cbit added here
         tmpQArg.isCbit = true;
         tmpQArg.argPtr = AI;
         tmpQArg.valOrIndex = arraySize;
@@ -471,9 +453,6 @@ void GetClassicalCriticalPath::init_critical_path_algo(Function* F){
   highestDelay = 0;
 
   //clear tsGates
-  for(map<uint64_t, vector<qGate> >::iterator mit=tsGates.begin(); mit!=tsGates.end(); ++mit){
-    (*mit).second.clear();
-  }
   tsGates.clear();
 
   currTimeStep.clear(); //initialize critical time steps   
@@ -493,31 +472,33 @@ void GetClassicalCriticalPath::init_critical_path_algo(Function* F){
   currParallelFunc.clear();
 }
 
-void GetClassicalCriticalPath::print_funcQbits(){
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbits.begin(); mIter!=funcQbits.end(); ++mIter){
-    errs() << "Var "<< (*mIter).first << " ---> ";
-    for(map<int,uint64_t>::iterator indexIter  = (*mIter).second.begin(); indexIter!=(*mIter).second.end(); ++indexIter){
-      errs() << (*indexIter).first << ":"<<(*indexIter).second<< "  ";
-    }
+void GetClassicalCriticalPath::print_qbitArrays(vector<critpath::QbitArray> &qbits){
+  //print in order of name
+  vector<pair<string, int> > byName;
+  for(unsigned id = 0; id < qbits.size(); id++)
+    byName.push_back(make_pair(qbitValue[id]->getName().str(), (int)id));
+  stable_sort(byName.begin(), byName.end());
+
+  for(unsigned i = 0; i < byName.size(); i++){
+    errs() << "Var "<< byName[i].first << " ---> ";
+    qbits[byName[i].second].print(errs());
     errs() << "\n";
   }
 }
 
+void GetClassicalCriticalPath::print_funcQbits(){
+  print_qbitArrays(funcQbits);
+}
+
 void GetClassicalCriticalPath::print_funcQbitsHalf(){
   errs() << "Printing funcQbitsHalf ---- \n";
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbitsHalf.begin(); mIter!=funcQbitsHalf.end(); ++mIter){
-    errs() << "Var "<< (*mIter).first << " ---> ";
-    for(map<int,uint64_t>::iterator indexIter  = (*mIter).second.begin(); indexIter!=(*mIter).second.end(); ++indexIter){
-      errs() << (*indexIter).first << ":"<<(*indexIter).second<< "  ";
-    }
-    errs() << "\n";
-  }
+  print_qbitArrays(funcQbitsHalf);
 }
 
 void GetClassicalCriticalPath::print_qgate(qGate qg){
   errs() << "--Gate: " << qg.qFunc->getName() << " : ";
   for(int i=0;i<qg.numArgs;i++){
-    errs() << qg.args[i].name << " idx=" << qg.args[i].index 
+    errs() << qbitValue[qg.args[i].id]->getName() << " idx=" << qg.args[i].index 
       << ", "  ;
   }
   errs() << "ASAP=" << qg.asap_num << " ALAP=" << qg.alap_num;
@@ -583,10 +564,9 @@ void GetClassicalCriticalPath::update_critical_info(string currFunc, uint64_t ts
 
 uint64_t GetClassicalCriticalPath::find_max_funcQbits(){
   uint64_t max_timesteps = 0;
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbits.begin(); mIter!=funcQbits.end(); ++mIter){
-    map<int,uint64_t>::iterator arrIter = (*mIter).second.find(-2);
-    if((*arrIter).second > max_timesteps)
-      max_timesteps = (*arrIter).second;
+  for(unsigned id = 0; id < funcQbits.size(); id++){
+    if(funcQbits[id].max > max_timesteps)
+      max_timesteps = funcQbits[id].max;
   }
 
   return max_timesteps;
@@ -594,17 +574,13 @@ uint64_t GetClassicalCriticalPath::find_max_funcQbits(){
 }
 
 void GetClassicalCriticalPath::memset_funcQbits(uint64_t val){
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbits.begin(); mIter!=funcQbits.end(); ++mIter){
-    for(map<int,uint64_t>::iterator arrIter = (*mIter).second.begin(); arrIter!=(*mIter).second.end();++arrIter)
-      (*arrIter).second = val;
-  }
+  for(unsigned id = 0; id < funcQbits.size(); id++)
+    funcQbits[id].setAll(val);
 }
 
 void GetClassicalCriticalPath::memset_funcQbitsHalf(uint64_t val){
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbitsHalf.begin(); mIter!=funcQbitsHalf.end(); ++mIter){
-    for(map<int,uint64_t>::iterator arrIter = (*mIter).second.begin(); arrIter!=(*mIter).second.end();++arrIter)
-      (*arrIter).second = val;
-  }
+  for(unsigned id = 0; id < funcQbitsHalf.size(); id++)
+    funcQbitsHalf[id].setAll(val);
 }
 
 void GetClassicalCriticalPath::print_scheduled_gate(qGate qg, uint64_t ts){
@@ -614,37 +590,39 @@ void GetClassicalCriticalPath::print_scheduled_gate(qGate qg, uint64_t ts){
   errs() << ts << " : " << tmpGateName;
   for(int i = 0; i<qg.numArgs; i++){
     //if(qg.args[i].index != -1)
-    errs() << " " << qg.args[i].name << qg.args[i].index;
+    errs() << " " << qbitValue[qg.args[i].id]->getName() << qg.args[i].index;
   }
 
   errs() << "\n";
 }
 
-void GetClassicalCriticalPath::print_tableFuncQbits(){
-  for(map<Function*, map<unsigned int, map<int, uint64_t> > >::iterator m1 = tableFuncQbits.begin(); m1!=tableFuncQbits.end(); ++m1){
+void GetClassicalCriticalPath::print_table(map<Function*, critpath::ArgQbits> &table){
+  for(map<Function*, critpath::ArgQbits>::iterator m1 = table.begin(); m1!=table.end(); ++m1){
     errs() << "Function " << (*m1).first->getName() << " \n  ";
-    for(map<unsigned int, map<int, uint64_t> >::iterator m2 = (*m1).second.begin(); m2!=(*m1).second.end(); ++m2){
-      errs() << "\tArg# "<< (*m2).first << " -- ";
-      for(map<int, uint64_t>::iterator m3 = (*m2).second.begin(); m3!=(*m2).second.end(); ++m3){
-        errs() << " ; " << (*m3).first << " : " << (*m3).second;
+    for(unsigned int argNum = 0; argNum < (*m1).second.arrays.size(); argNum++){
+      const critpath::QbitArray *entry = (*m1).second.lookup(argNum);
+      if(!entry)
+        continue;
+      errs() << "\tArg# "<< argNum << " -- ";
+      errs() << " ; " << -2 << " : " << entry->max;
+      errs() << " ; " << -1 << " : " << entry->whole;
+      vector<int> sorted(entry->slots);
+      sort(sorted.begin(), sorted.end());
+      for(unsigned k = 0; k < sorted.size(); k++){
+        errs() << " ; " << sorted[k] << " : " << entry->ts[sorted[k]];
       }
       errs() << "\n";
     }
   }
 }
 
+void GetClassicalCriticalPath::print_tableFuncQbits(){
+  print_table(tableFuncQbits);
+}
+
 void GetClassicalCriticalPath::print_tableFuncQbitsStart(){
   errs() << "Printing tableFuncQbitsStart\n";
-  for(map<Function*, map<unsigned int, map<int, uint64_t> > >::iterator m1 = tableFuncQbitsStart.begin(); m1!=tableFuncQbitsStart.end(); ++m1){
-    errs() << "Function " << (*m1).first->getName() << " \n  ";
-    for(map<unsigned int, map<int, uint64_t> >::iterator m2 = (*m1).second.begin(); m2!=(*m1).second.end(); ++m2){
-      errs() << "\tArg# "<< (*m2).first << " -- ";
-      for(map<int, uint64_t>::iterator m3 = (*m2).second.begin(); m3!=(*m2).second.end(); ++m3){
-        errs() << " ; " << (*m3).first << " : " << (*m3).second;
-      }
-      errs() << "\n";
-    }
-  }
+  print_table(tableFuncQbitsStart);
 }
 
 void GetClassicalCriticalPath::calc_max_parallelism_statistic()
@@ -679,9 +657,11 @@ void GetClassicalCriticalPath::calc_max_parallelism_statistic()
 
 void GetClassicalCriticalPath::print_tsGates()
 {
-  for(map<uint64_t, vector<qGate> >::iterator mit = tsGates.begin(); mit!=tsGates.end(); ++mit){
-    errs() << "TS#"<<(*mit).first << " --> ";
-    for(vector<qGate>::iterator vit = (*mit).second.begin(); vit!=(*mit).second.end();++vit)
+  for(uint64_t ts = 0; ts < tsGates.size(); ts++){
+    if(tsGates[ts].empty())
+      continue;
+    errs() << "TS#"<< ts << " --> ";
+    for(vector<qGate>::iterator vit = tsGates[ts].begin(); vit!=tsGates[ts].end();++vit)
       print_qgate(*vit);
   }
 
@@ -691,15 +671,9 @@ void GetClassicalCriticalPath::addToTSGates(qGate qg, uint64_t ts)
 {
   if(isLeaf){
     //add to tsGates
-    map<uint64_t, vector<qGate> >::iterator git = tsGates.find(ts);
-    if(git!=tsGates.end()){
-      (*git).second.push_back(qg); //add to vector
-    }
-    else{
-      vector<qGate> tmpVect;
-      tmpVect.push_back(qg);
-      tsGates[ts] = tmpVect; //add to map	
-    } 
+    if(ts >= tsGates.size())
+      tsGates.resize(ts+1);
+    tsGates[ts].push_back(qg);
   } //isLeaf
 }
 
@@ -710,35 +684,22 @@ uint64_t GetClassicalCriticalPath::compute_max_ts_of_all_args(qGate qg)
 
   //find last timestep for all arguments of qgate
   for(int i=0;i<qg.numArgs; i++){
-    map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
-    assert(mIter!=funcQbits.end()); //should already have an entry for the name of the qbit
+    critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
 
     int argIndex = qg.args[i].index;
 
-    //find the index of argument in the map<int,int>
     if(argIndex == -1) //operation on entire array
     {
       //find max for the array
-      map<int,uint64_t>::iterator indexIter = (*mIter).second.find(-2);
-      if((*indexIter).second > max_ts_of_all_args)
-        max_ts_of_all_args = (*indexIter).second;	  
+      if(qbits.max > max_ts_of_all_args)
+        max_ts_of_all_args = qbits.max;
     }
     else
     {
-      map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-      if(indexIter!=(*mIter).second.end()){
-        if((*indexIter).second > max_ts_of_all_args)
-          max_ts_of_all_args = (*indexIter).second;
-      }
-      else{
-        //find the value for entire array
-        map<int,uint64_t>::iterator fullArrayIndexIter = (*mIter).second.find(-1);
-
-        ((*mIter).second)[argIndex] = (*fullArrayIndexIter).second;
-        if((*fullArrayIndexIter).second > max_ts_of_all_args)
-          max_ts_of_all_args = (*fullArrayIndexIter).second;
-        //((*mIter).second)[argIndex] = 0;
-      }
+      //an index not seen before takes the value for entire array
+      uint64_t ts = qbits.at(argIndex);
+      if(ts > max_ts_of_all_args)
+        max_ts_of_all_args = ts;
     }
   }
 
@@ -771,12 +732,12 @@ uint64_t GetClassicalCriticalPath::compute_least_slack(Function* F, qGate qg, ui
   //compute startsAt
   //print_tableFuncQbitsStart();
 
-  map<Function*, map<unsigned int, map<int, uint64_t> > >::iterator tableIt = tableFuncQbitsStart.find(qg.qFunc);
+  map<Function*, critpath::ArgQbits>::iterator tableIt = tableFuncQbitsStart.find(qg.qFunc);
   assert(tableIt!=tableFuncQbitsStart.end() && "No previous entry for this function");
 
   for(int i=0;i<qg.numArgs; i++){    
-    map<unsigned int, map<int, uint64_t> >::iterator entryIt = (*tableIt).second.find(i);
-    if(entryIt!=(*tableIt).second.end()){
+    const critpath::QbitArray *entry = (*tableIt).second.lookup(i);
+    if(entry){
 
       //differentiate for qbit and qbit*
 
@@ -784,16 +745,13 @@ uint64_t GetClassicalCriticalPath::compute_least_slack(Function* F, qGate qg, ui
 
         //errs() << "Array\n";
 
-        map<int, uint64_t>::iterator lookUpIt = (*entryIt).second.find(-2);
-        startsAt[i] = tmax + (*lookUpIt).second;			
+        startsAt[i] = tmax + entry->max;
       }
       else{ //qbit was passed
         //errs() << "i = " << i << " Qbit\n";
         //errs() << "index = " << qg.args[i].index << " Qbit\n";
         //take the 0th entry and add that to the index entry
-        map<int, uint64_t>::iterator lookUpQbitIt = (*entryIt).second.find(0);
-        assert(lookUpQbitIt!=(*entryIt).second.end() && "arg index not found in tablefuncqbitshalf"); //there exists entry for reqd index in the func table of called func
-        startsAt[i] = tmax + (*lookUpQbitIt).second;
+        startsAt[i] = tmax + entry->get(0);
 
       }
     }
@@ -805,31 +763,19 @@ uint64_t GetClassicalCriticalPath::compute_least_slack(Function* F, qGate qg, ui
   //compute endsAt
   //find last timestep for all arguments of qgate
   for(int i=0;i<qg.numArgs; i++){
-    map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
-    assert(mIter!=funcQbits.end()); //should already have an entry for the name of the qbit
+    critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
 
     int argIndex = qg.args[i].index;
 
-    //find the index of argument in the map<int,int>
     if(argIndex == -1) //operation on entire array
     {
       //find max for the array
-      map<int,uint64_t>::iterator indexIter = (*mIter).second.find(-2);
-      endsAt[i] = (*indexIter).second;	  
+      endsAt[i] = qbits.max;
     }
     else
     {
-      map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-      if(indexIter!=(*mIter).second.end()){
-        endsAt[i] = (*indexIter).second;
-      }
-      else{
-        //find the value for entire array
-        map<int,uint64_t>::iterator fullArrayIndexIter = (*mIter).second.find(-1);
-
-        ((*mIter).second)[argIndex] = (*fullArrayIndexIter).second;
-        endsAt[i] = (*fullArrayIndexIter).second;
-      }
+      //an index not seen before takes the value for entire array
+      endsAt[i] = qbits.at(argIndex);
     }
   }
 
@@ -868,17 +814,17 @@ void GetClassicalCriticalPath::calc_critical_time(Function* F, qGate qg){
     //--print_scheduled_gate(qg,maxFQ+1);
     addToTSGates(qg,maxFQ+1);
 
-    map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[0].name);
+    if(qg.numArgs > 0){
+      critpath::QbitArray &qbits = funcQbits[qg.args[0].id];
 
-    int argIndex = qg.args[0].index;
+      int argIndex = qg.args[0].index;
 
-    //update the timestep number for that argument
-    map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-    (*indexIter).second =  maxFQ + 1;
+      //update the timestep number for that argument
+      qbits.at(argIndex) =  maxFQ + 1;
 
-    //update -2 entry for the array, i.e. max ts over all indices
-    indexIter = (*mIter).second.find(-2);
-    (*indexIter).second = maxFQ + 1;
+      //update max ts over all indices
+      qbits.max = maxFQ + 1;
+    }
 
     //update_critical_info(F->getName().str(), maxFQ, qg.qFunc->getName(), qg.angle);   
     isFirstMeas = false;
@@ -899,27 +845,22 @@ void GetClassicalCriticalPath::calc_critical_time(Function* F, qGate qg){
 
       //find last timestep for all arguments of qgate
       for(int i=0;i<qg.numArgs; i++){
-        map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
+        critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
 
         int argIndex = qg.args[i].index;
 
         if(argIndex == -1){
-          for(map<int,uint64_t>::iterator entryIter = (*mIter).second.begin(); entryIter!=(*mIter).second.end();++entryIter){
-            (*entryIter).second = max_ts_of_all_args + 1;
-          }
-
+          qbits.setAll(max_ts_of_all_args + 1);
         }
         else{
           //update the timestep number for that argument (ajavadia: for multi-qubit gates, only update for target)
-          map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
           if (i == qg.numArgs-1) {          
-            (*indexIter).second =  max_ts_of_all_args + 1;
+            qbits.at(argIndex) =  max_ts_of_all_args + 1;
           }
 
-          //update -2 entry for the array, i.e. max ts over all indices
-          indexIter = (*mIter).second.find(-2);
-          if((*indexIter).second < max_ts_of_all_args + 1)
-            (*indexIter).second = max_ts_of_all_args + 1;
+          //update max ts over all indices
+          if(qbits.max < max_ts_of_all_args + 1)
+            qbits.max = max_ts_of_all_args + 1;
         }  
       }
     } //intrinsic func
@@ -946,41 +887,34 @@ void GetClassicalCriticalPath::calc_critical_time(Function* F, qGate qg){
       if(tmpDelay > highestDelay) highestDelay = tmpDelay;
 
       //check tableFuncQbits for values to update with
-      map<Function*, map<unsigned int, map<int, uint64_t> > >::iterator tableIt = tableFuncQbits.find(qg.qFunc);
+      map<Function*, critpath::ArgQbits>::iterator tableIt = tableFuncQbits.find(qg.qFunc);
       assert(tableIt!=tableFuncQbits.end() && "No previous entry for this function");
 
       for(int i=0;i<qg.numArgs; i++){
-        map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
-        assert(mIter!=funcQbits.end()); //should already have an entry for the name of the qbit
+        critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
 
-        map<unsigned int, map<int, uint64_t> >::iterator entryIt = (*tableIt).second.find(i);
-        if(entryIt!=(*tableIt).second.end()){
+        const critpath::QbitArray *entry = (*tableIt).second.lookup(i);
+        if(entry){
 
           //differentiate for qbit and qbit*
 
           if(qg.args[i].index == -1){ //qbit*
-            for(map<int, uint64_t>::iterator indexIt = (*entryIt).second.begin(); indexIt!=(*entryIt).second.end(); ++indexIt){
-              map<int,uint64_t>::iterator currEntryIt = (*mIter).second.find((*indexIt).first);
-              if(currEntryIt!=(*mIter).second.end())
-                (*currEntryIt).second = max_ts_of_all_args + (*indexIt).second - least_slack + 1;
-              else
-                (*mIter).second[(*indexIt).first] = max_ts_of_all_args + (*indexIt).second - least_slack + 1;
+            uint64_t offset = max_ts_of_all_args - least_slack + 1;
+            qbits.whole = entry->whole + offset;
+            qbits.max = entry->max + offset;
+            for(unsigned k = 0; k < entry->slots.size(); k++){
+              int index = entry->slots[k];
+              qbits.at(index) = entry->ts[index] + offset;
             }
           }
           else{ //qbit was passed
             //take the 0th entry and add that to the index entry
-            map<int, uint64_t>::iterator lookUpQbitIt = (*entryIt).second.find(0);
-            assert(lookUpQbitIt!=(*entryIt).second.end()); //there exists entry for 0 in the func table of called func
-            map<int, uint64_t>::iterator currEntryIt = (*mIter).second.find(qg.args[i].index);
-            if(currEntryIt!=(*mIter).second.end())
-              (*currEntryIt).second = max_ts_of_all_args + (*lookUpQbitIt).second - least_slack + 1;
-            else
-              (*mIter).second[qg.args[i].index] = max_ts_of_all_args + (*lookUpQbitIt).second - least_slack + 1;
-
-            //update -2 entry for the array, i.e. max ts over all indices
-            currEntryIt = (*mIter).second.find(-2);
-            if((*currEntryIt).second < max_ts_of_all_args + (*lookUpQbitIt).second)
-              (*currEntryIt).second = max_ts_of_all_args + (*lookUpQbitIt).second- least_slack + 1;	    
+            uint64_t entryTS = entry->get(0);
+            qbits.at(qg.args[i].index) = max_ts_of_all_args + entryTS - least_slack + 1;
+
+            //update max ts over all indices
+            if(qbits.max < max_ts_of_all_args + entryTS)
+              qbits.max = max_ts_of_all_args + entryTS - least_slack + 1;
           }
         } 
       }
@@ -1083,7 +1017,10 @@ void GetClassicalCriticalPath::analyzeCallInst(Function* F, Instruction* pInst){
       for(unsigned int vb=0; vb<allDepQbit.size(); vb++){
         if(allDepQbit[vb].argPtr){
           qGateArg param =  allDepQbit[vb];       
-          thisGate.args[thisGate.numArgs].name = param.argPtr->getName();
+          int id = vectQbit.lookup(param.argPtr);
+          if(id < 0) //traced back to a cbit
+            continue;
+          thisGate.args[thisGate.numArgs].id = id;
           if(!param.isPtr)
             thisGate.args[thisGate.numArgs].index = param.valOrIndex;
           thisGate.numArgs++;
@@ -1098,31 +1035,26 @@ void GetClassicalCriticalPath::analyzeCallInst(Function* F, Instruction* pInst){
 }
 
 
-void GetClassicalCriticalPath::saveTableFuncQbits(Function* F){
-  map<unsigned int, map<int, uint64_t> > tmpFuncQbitsMap;
+void GetClassicalCriticalPath::saveTable(Function* F, vector<critpath::QbitArray> &qbits, critpath::ArgQbits &table){
+  table.arrays.assign(F->arg_size(), critpath::QbitArray());
+  table.isQbit.assign(F->arg_size(), false);
 
-  for(map<string, map<int, uint64_t> >::iterator mapIt = funcQbits.begin(); mapIt!=funcQbits.end(); ++mapIt){
-    map<string, unsigned int>::iterator argIt = funcArgs.find((*mapIt).first);
-    if(argIt!=funcArgs.end()){
-      unsigned int argNum = (*argIt).second;
-      tmpFuncQbitsMap[argNum] = (*mapIt).second;
+  for(unsigned id = 0; id < qbits.size(); id++){
+    if(funcArgs[id] >= 0){
+      unsigned int argNum = funcArgs[id];
+      table.arrays[argNum] = qbits[id];
+      table.isQbit[argNum] = true;
     }
   }
-  tableFuncQbits[F] = tmpFuncQbitsMap;
 }
 
+void GetClassicalCriticalPath::saveTableFuncQbits(Function* F){
+  saveTable(F, funcQbits, tableFuncQbits[F]);
+}
 
-void GetClassicalCriticalPath::saveTableFuncQbitsStart(Function* F){
-  map<unsigned int, map<int, uint64_t> > tmpFuncQbitsMap;
 
-  for(map<string, map<int, uint64_t> >::iterator mapIt = funcQbitsHalf.begin(); mapIt!=funcQbitsHalf.end(); ++mapIt){
-    map<string, unsigned int>::iterator argIt = funcArgs.find((*mapIt).first);
-    if(argIt!=funcArgs.end()){
-      unsigned int argNum = (*argIt).second;
-      tmpFuncQbitsMap[argNum] = (*mapIt).second;
-    }
-  }
-  tableFuncQbitsStart[F] = tmpFuncQbitsMap;
+void GetClassicalCriticalPath::saveTableFuncQbitsStart(Function* F){
+  saveTable(F, funcQbitsHalf, tableFuncQbitsStart[F]);
 }
 
 
@@ -1130,15 +1062,9 @@ void GetClassicalCriticalPath::init_funcQbitsHalf(uint64_t i){
   //copy all entries of funcQbit
   //print_funcQbitsHalf();
 
-  for(map<string, map<int,uint64_t> >::iterator inItr = funcQbits.begin(); inItr!=funcQbits.end(); ++inItr){
-    //find string in funcQbitsHalf
-    //errs() << "Looking for string " << (*inItr).first << "\n";
-    map<string, map<int,uint64_t> >::iterator outItr = funcQbitsHalf.find((*inItr).first);
-    assert(outItr != funcQbitsHalf.end() && "funcQbitsHalf does not have entry");
-
-    for(map<int,uint64_t>::iterator in2Itr = (*inItr).second.begin(); in2Itr!=(*inItr).second.end(); ++in2Itr){
-      (*outItr).second[(*in2Itr).first] = i;
-    }
+  for(unsigned id = 0; id < funcQbits.size(); id++){
+    funcQbitsHalf[id] = funcQbits[id];
+    funcQbitsHalf[id].setAll(i);
   }
 
 }
@@ -1146,23 +1072,18 @@ void GetClassicalCriticalPath::init_funcQbitsHalf(uint64_t i){
 void GetClassicalCriticalPath::gen_half_funcQbits(uint64_t ct, uint64_t hct){
   init_funcQbitsHalf(ct);
 
-  for(uint64_t i=hct+1; i<ct; i++){
-    map<uint64_t, vector<qGate> >::iterator mit=tsGates.find(i);
-    for(vector<qGate>::iterator vit = (*mit).second.begin(); vit!=(*mit).second.end(); ++vit){
+  for(uint64_t i=hct+1; i<ct && i<tsGates.size(); i++){
+    for(vector<qGate>::iterator vit = tsGates[i].begin(); vit!=tsGates[i].end(); ++vit){
       //iterate over the args
       for(int j=0; j<(*vit).numArgs; j++){
-        string argName = (*vit).args[j].name;
         int argIndex = (*vit).args[j].index;
-        map<string, map<int,uint64_t> >::iterator fit = funcQbitsHalf.find(argName);
-        assert(fit!=funcQbitsHalf.end() && "arg not found in funQbitsHalf");
 
         assert(argIndex != -1 && "argindex is -1");
 
-        map<int,uint64_t>::iterator mfit = (*fit).second.find(argIndex);
-        assert(mfit != (*fit).second.end() && "arg index not found in funcQbitsHalf");
+        uint64_t &halfTS = funcQbitsHalf[(*vit).args[j].id].at(argIndex);
 
-        if(i < (*mfit).second){ //gate scheduled in TS=i
-          (*mfit).second = i;	  
+        if(i < halfTS){ //gate scheduled in TS=i
+          halfTS = i;	  
         }
 
       }
@@ -1180,17 +1101,15 @@ void GetClassicalCriticalPath::schedule_alap_insts(uint64_t ct, uint64_t hct){
   assert(hct!=0 && "ZERO hct");
 
   for(uint64_t i=hct; i>=1; i--){
-    map<uint64_t, vector<qGate> >::iterator mit=tsGates.find(i);
-    for(vector<qGate>::iterator vit = (*mit).second.begin(); vit!=(*mit).second.end(); ++vit){
+    if(i >= tsGates.size())
+      continue;
+    for(vector<qGate>::iterator vit = tsGates[i].begin(); vit!=tsGates[i].end(); ++vit){
       //iterate over the args and get ALAP num
       uint64_t min_ts_of_all_args = ct;
 
       for(int j=0; j<(*vit).numArgs; j++){
-        string argName = (*vit).args[j].name;
         int argIndex = (*vit).args[j].index;
 
-        map<string, map<int,uint64_t> >::iterator fit = funcQbitsHalf.find(argName);
-        assert(fit!=funcQbitsHalf.end() && "arg not found in funQbitsHalf");
         assert(argIndex != -1 && "argIndex = -1 in sched_alap");
 
         //if(argIndex == -1) //operation on entire array
@@ -1202,11 +1121,10 @@ void GetClassicalCriticalPath::schedule_alap_insts(uint64_t ct, uint64_t hct){
         //}
         //else
         //{
-        map<int,uint64_t>::iterator mfit = (*fit).second.find(argIndex);
-        assert(mfit != (*fit).second.end() && "arg index not found in funcQbitsHalf");
+        uint64_t halfTS = funcQbitsHalf[(*vit).args[j].id].at(argIndex);
 
-        if((*mfit).second < min_ts_of_all_args)
-          min_ts_of_all_args = (*mfit).second;
+        if(halfTS < min_ts_of_all_args)
+          min_ts_of_all_args = halfTS;
         //}
       }
       //print_qgate((*vit));
@@ -1218,25 +1136,20 @@ void GetClassicalCriticalPath::schedule_alap_insts(uint64_t ct, uint64_t hct){
 
       //find last timestep for all arguments of qgate
       for(int j=0;j<(*vit).numArgs; j++){
-        map<string, map<int,uint64_t> >::iterator mIter = funcQbitsHalf.find((*vit).args[j].name);
+        critpath::QbitArray &halfQbits = funcQbitsHalf[(*vit).args[j].id];
 
         int argIndex = (*vit).args[j].index;
 
         if(argIndex == -1){
-          for(map<int,uint64_t>::iterator entryIter = (*mIter).second.begin(); entryIter!=(*mIter).second.end();++entryIter){
-            (*entryIter).second = min_ts_of_all_args - 1;
-          }
-
+          halfQbits.setAll(min_ts_of_all_args - 1);
         }
         else{
           //update the timestep number for that argument
-          map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-          (*indexIter).second =  min_ts_of_all_args - 1;
+          halfQbits.at(argIndex) =  min_ts_of_all_args - 1;
 
-          //update -2 entry for the array, i.e. min ts over all indices
-          indexIter = (*mIter).second.find(-2);
-          if((*indexIter).second > min_ts_of_all_args - 1)
-            (*indexIter).second = min_ts_of_all_args - 1;
+          //update min ts over all indices
+          if(halfQbits.max > min_ts_of_all_args - 1)
+            halfQbits.max = min_ts_of_all_args - 1;
         }  
       }
     }
@@ -1353,7 +1266,9 @@ bool GetClassicalCriticalPath::runOnModule (Module &M) {
 
         funcQbits.clear();
         funcQbitsHalf.clear();
+        qbitValue.clear();
         funcArgs.clear();
+        vectQbit.clear();
 
         getFunctionArguments(F);
 
@@ -18,6 +18,7 @@
 #include "llvm/Instructions.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/PassAnalysisSupport.h"
 #include "llvm/Analysis/CallGraph.h"
@@ -27,6 +28,7 @@
 #include "llvm/ADT/ilist.h"
 #include "llvm/Constants.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/Transforms/Scaffold/QbitTimesteps.h"
 
 
 using namespace llvm;
@@ -70,9 +72,9 @@ namespace {
   };
   
 struct qArgInfo{
-  string name;
+  int id; //qbit array of the current function
   int index;
-  qArgInfo(): name("none"), index(-1){ }
+  qArgInfo(): id(-1), index(-1){ }
 };
 
 struct qGate{
@@ -105,7 +107,7 @@ struct qGate{
     
     string gate_name[NUM_QGATES];
     vector<qGateArg> tmpDepQbit;
-    vector<Value*> vectQbit;
+    DenseMap<Value*, int> vectQbit; //qbit array id, -1 for cbits
     
     int btCount; //backtrace count
 
@@ -117,9 +119,10 @@ struct qGate{
     map<string, allTSParallelism > funcParallelFactor; //string is function name
     map<string, MaxInfo> funcMaxParallelFactor;
 
-    map<string, map<int,uint64_t> > funcQbits; //qbits in current function
-    map<Function*, map<unsigned int, map<int,uint64_t> > > tableFuncQbits;
-    map<string, unsigned int> funcArgs;
+    vector<critpath::QbitArray> funcQbits; //qbits in current function, by id
+    vector<Value*> qbitValue; //id -> qbit array
+    vector<int> funcArgs; //id -> argument number, -1 for allocas
+    map<Function*, critpath::ArgQbits> tableFuncQbits;
 
     map<Function*, uint64_t> funcCritPath;
     allTSParallelism currTS;
@@ -130,6 +133,7 @@ struct qGate{
     ModCriticalPath() : ModulePass(ID) {}
     
     bool backtraceOperand(Value* opd, int opOrIndex);
+    void addQbitArray(Value* V, int argNum);
     void analyzeAllocInst(Function* F,Instruction* pinst);
     void analyzeCallInst(Function* F,Instruction* pinst);
     void getFunctionArguments(Function *F);
@@ -229,7 +233,6 @@ void ModCriticalPath::getFunctionArguments(Function* F)
     {    
       //if(ait) errs() << "Argument: "<<ait->getName()<< " ";
 
-      string argName = (ait->getName()).str();
       Type* argType = ait->getType();
       unsigned int argNum=ait->getArgNo();         
 
@@ -243,15 +246,7 @@ void ModCriticalPath::getFunctionArguments(Function* F)
 	Type *elementType = argType->getPointerElementType();
 	if (elementType->isIntegerTy(16)){ //qbit*
 	  tmpQArg.isQbit = true;
-	  vectQbit.push_back(ait);
-	  
-	  map<int,uint64_t> tmpMap;
-	  tmpMap[-1] = 0; //add entry for entire array
-	  tmpMap[-2] = 0; //add entry for max
-	  funcQbits[argName]=tmpMap;
-
-	  funcArgs[argName] = argNum;
-
+	  addQbitArray(ait, argNum);
 	}
 	else if (elementType->isIntegerTy(1)){ //cbit*
 	  tmpQArg.isCbit = true;
@@ -261,13 +256,7 @@ void ModCriticalPath::getFunctionArguments(Function* F)
       }
       else if (argType->isIntegerTy(16)){ //qbit
 	tmpQArg.isQbit = true;
-	vectQbit.push_back(ait);
-
-	  map<int,uint64_t> tmpMap;
-	  tmpMap[-1] = 0; //add entry for entire array
-	  tmpMap[-2] = 0; //add entry for max
-	  funcQbits[argName]=tmpMap;
-	  funcArgs[argName] = argNum;
+	addQbitArray(ait, argNum);
       }
       else if (argType->isIntegerTy(1)){ //cbit
 	tmpQArg.isCbit = true;
@@ -278,13 +267,21 @@ void ModCriticalPath::getFunctionArguments(Function* F)
     }
 }
 
+void ModCriticalPath::addQbitArray(Value* V, int argNum)
+{
+  //number the qbit array; its timesteps all start at 0
+  vectQbit[V] = funcQbits.size();
+  funcQbits.push_back(critpath::QbitArray());
+  qbitValue.push_back(V);
+  funcArgs.push_back(argNum);
+}
+
 bool ModCriticalPath::backtraceOperand(Value* opd, int opOrIndex)
 {
   if(opOrIndex == 0) //backtrace for operand
     {
-      //search for opd in qbit/cbit vector
-      vector<Value*>::iterator vIter=find(vectQbit.begin(),vectQbit.end(),opd);
-      if(vIter != vectQbit.end()){
+      //search for opd in qbit/cbit map
+      if(vectQbit.count(opd)){
 	tmpDepQbit[0].argPtr = opd;
 	
 	return true;
@@ -411,20 +408,14 @@ void ModCriticalPath::analyzeAllocInst(Function* F, Instruction* pInst){
       Type *elementType = arrayType->getElementType();
       uint64_t arraySize = arrayType->getNumElements();
       if (elementType->isIntegerTy(16)){
-	vectQbit.push_back(AI);
+	addQbitArray(AI, -1); //add qbit to funcQbits
 	tmpQArg.isQbit = true;
 	tmpQArg.argPtr = AI;
 	tmpQArg.valOrIndex = arraySize;
-
-	map<int,uint64_t> tmpMap; //add qbit to funcQbits
-	tmpMap[-1] = 0; //entry for entire array
-	tmpMap[-2] = 0; //entry for max
-	funcQbits[AI->getName()]=tmpMap;
-
       }
       
       if (elementType->isIntegerTy(1)){
-	vectQbit.push_back(AI); //Cbit added here
+	vectQbit[AI] = -1; //Cbit added here
 	tmpQArg.isCbit = true;
 	tmpQArg.argPtr = AI;
 	tmpQArg.valOrIndex = arraySize;
@@ -461,11 +452,15 @@ void ModCriticalPath::init_critical_path_algo(Function* F){
 }
 
 void ModCriticalPath::print_funcQbits(){
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbits.begin(); mIter!=funcQbits.end(); ++mIter){
-    errs() << "Var "<< (*mIter).first << " ---> ";
-    for(map<int,uint64_t>::iterator indexIter  = (*mIter).second.begin(); indexIter!=(*mIter).second.end(); ++indexIter){
-      errs() << (*indexIter).first << ":"<<(*indexIter).second<< "  ";
-    }
+  //print in order of name
+  vector<pair<string, int> > byName;
+  for(unsigned id = 0; id < funcQbits.size(); id++)
+    byName.push_back(make_pair(qbitValue[id]->getName().str(), (int)id));
+  stable_sort(byName.begin(), byName.end());
+
+  for(unsigned i = 0; i < byName.size(); i++){
+    errs() << "Var "<< byName[i].first << " ---> ";
+    funcQbits[byName[i].second].print(errs());
     errs() << "\n";
   }
 }
@@ -474,7 +469,7 @@ void ModCriticalPath::print_funcQbits(){
 void ModCriticalPath::print_qgate(qGate qg){
   errs() << qg.qFunc->getName() << " : ";
   for(int i=0;i<qg.numArgs;i++){
-    errs() << qg.args[i].name << qg.args[i].index << ", "  ;
+    errs() << qbitValue[qg.args[i].id]->getName() << qg.args[i].index << ", "  ;
   }
   errs() << "\n";
 }
@@ -545,10 +540,9 @@ void ModCriticalPath::update_critical_info(string currFunc, uint64_t ts, string
 
 uint64_t ModCriticalPath::find_max_funcQbits(){
   uint64_t max_timesteps = 0;
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbits.begin(); mIter!=funcQbits.end(); ++mIter){
-    map<int,uint64_t>::iterator arrIter = (*mIter).second.find(-2);
-    if((*arrIter).second > max_timesteps)
-      max_timesteps = (*arrIter).second;
+  for(unsigned id = 0; id < funcQbits.size(); id++){
+    if(funcQbits[id].max > max_timesteps)
+      max_timesteps = funcQbits[id].max;
   }
 
   return max_timesteps;
@@ -556,10 +550,8 @@ uint64_t ModCriticalPath::find_max_funcQbits(){
 }
 
 void ModCriticalPath::memset_funcQbits(uint64_t val){
-  for(map<string, map<int,uint64_t> >::iterator mIter = funcQbits.begin(); mIter!=funcQbits.end(); ++mIter){
-    for(map<int,uint64_t>::iterator arrIter = (*mIter).second.begin(); arrIter!=(*mIter).second.end();++arrIter)
-      (*arrIter).second = val;
-  }
+  for(unsigned id = 0; id < funcQbits.size(); id++)
+    funcQbits[id].setAll(val);
 }
 
 void ModCriticalPath::print_scheduled_gate(qGate qg, uint64_t ts){
@@ -569,7 +561,7 @@ void ModCriticalPath::print_scheduled_gate(qGate qg, uint64_t ts){
   errs() << ts << " : " << tmpGateName;
   for(int i = 0; i<qg.numArgs; i++){
     //if(qg.args[i].index != -1)
-      errs() << " " << qg.args[i].name << qg.args[i].index;
+      errs() << " " << qbitValue[qg.args[i].id]->getName() << qg.args[i].index;
   }
 
   if(tmpGateName == "PrepX" || tmpGateName == "PrepZ"){
@@ -585,12 +577,19 @@ void ModCriticalPath::print_scheduled_gate(qGate qg, uint64_t ts){
 }
 
 void ModCriticalPath::print_tableFuncQbits(){
-  for(map<Function*, map<unsigned int, map<int, uint64_t> > >::iterator m1 = tableFuncQbits.begin(); m1!=tableFuncQbits.end(); ++m1){
+  for(map<Function*, critpath::ArgQbits>::iterator m1 = tableFuncQbits.begin(); m1!=tableFuncQbits.end(); ++m1){
     errs() << "Function " << (*m1).first->getName() << " \n  ";
-    for(map<unsigned int, map<int, uint64_t> >::iterator m2 = (*m1).second.begin(); m2!=(*m1).second.end(); ++m2){
-      errs() << "\tArg# "<< (*m2).first << " -- ";
-      for(map<int, uint64_t>::iterator m3 = (*m2).second.begin(); m3!=(*m2).second.end(); ++m3){
-	errs() << " ; " << (*m3).first << " : " << (*m3).second;
+    for(unsigned int argNum = 0; argNum < (*m1).second.arrays.size(); argNum++){
+      const critpath::QbitArray *entry = (*m1).second.lookup(argNum);
+      if(!entry)
+	continue;
+      errs() << "\tArg# "<< argNum << " -- ";
+      errs() << " ; " << -2 << " : " << entry->max;
+      errs() << " ; " << -1 << " : " << entry->whole;
+      vector<int> sorted(entry->slots);
+      sort(sorted.begin(), sorted.end());
+      for(unsigned k = 0; k < sorted.size(); k++){
+	errs() << " ; " << sorted[k] << " : " << entry->ts[sorted[k]];
       }
       errs() << "\n";
     }
@@ -641,17 +640,17 @@ void ModCriticalPath::calc_critical_time(Function* F, qGate qg){
     //--print_scheduled_gate(qg,maxFQ+1);
 
 
-    map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[0].name);
-	
-    int argIndex = qg.args[0].index;
-    
-    //update the timestep number for that argument
-    map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-    (*indexIter).second =  maxFQ + 1;
-    
-    //update -2 entry for the array, i.e. max ts over all indices
-    indexIter = (*mIter).second.find(-2);
-    (*indexIter).second = maxFQ + 1;
+    if(qg.numArgs > 0){
+      critpath::QbitArray &qbits = funcQbits[qg.args[0].id];
+
+      int argIndex = qg.args[0].index;
+
+      //update the timestep number for that argument
+      qbits.at(argIndex) =  maxFQ + 1;
+
+      //update max ts over all indices
+      qbits.max = maxFQ + 1;
+    }
 
     //update_critical_info(F->getName().str(), maxFQ, qg.qFunc->getName(), qg.angle);   
     isFirstMeas = false;
@@ -661,35 +660,22 @@ void ModCriticalPath::calc_critical_time(Function* F, qGate qg){
     
     //find last timestep for all arguments of qgate
     for(int i=0;i<qg.numArgs; i++){
-      map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
-      assert(mIter!=funcQbits.end()); //should already have an entry for the name of the qbit
+      critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
       
       int argIndex = qg.args[i].index;
       
-      //find the index of argument in the map<int,int>
       if(argIndex == -1) //operation on entire array
 	{
 	  //find max for the array
-	  map<int,uint64_t>::iterator indexIter = (*mIter).second.find(-2);
-	  if((*indexIter).second > max_ts_of_all_args)
-	    max_ts_of_all_args = (*indexIter).second;	  
+	  if(qbits.max > max_ts_of_all_args)
+	    max_ts_of_all_args = qbits.max;
 	}
       else
 	{
-	  map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-	  if(indexIter!=(*mIter).second.end()){
-	    if((*indexIter).second > max_ts_of_all_args)
-	      max_ts_of_all_args = (*indexIter).second;
-	  }
-	  else{
-	    //find the value for entire array
-	    map<int,uint64_t>::iterator fullArrayIndexIter = (*mIter).second.find(-1);
-	    
-	    ((*mIter).second)[argIndex] = (*fullArrayIndexIter).second;
-	    if((*fullArrayIndexIter).second > max_ts_of_all_args)
-	      max_ts_of_all_args = (*fullArrayIndexIter).second;
-	    //((*mIter).second)[argIndex] = 0;
-	  }
+	  //an index not seen before takes the value for entire array
+	  uint64_t ts = qbits.at(argIndex);
+	  if(ts > max_ts_of_all_args)
+	    max_ts_of_all_args = ts;
 	}
     }
     
@@ -708,25 +694,20 @@ void ModCriticalPath::calc_critical_time(Function* F, qGate qg){
       
       //find last timestep for all arguments of qgate
       for(int i=0;i<qg.numArgs; i++){
-	map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
+	critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
 	
 	int argIndex = qg.args[i].index;
 	
 	if(argIndex == -1){
-	  for(map<int,uint64_t>::iterator entryIter = (*mIter).second.begin(); entryIter!=(*mIter).second.end();++entryIter){
-	    (*entryIter).second = max_ts_of_all_args + 1;
-	  }
-	  
+	  qbits.setAll(max_ts_of_all_args + 1);
 	}
 	else{
 	  //update the timestep number for that argument
-	  map<int,uint64_t>::iterator indexIter = (*mIter).second.find(argIndex);
-	  (*indexIter).second =  max_ts_of_all_args + 1;
+	  qbits.at(argIndex) =  max_ts_of_all_args + 1;
 	  
-	  //update -2 entry for the array, i.e. max ts over all indices
-	  indexIter = (*mIter).second.find(-2);
-	  if((*indexIter).second < max_ts_of_all_args + 1)
-	    (*indexIter).second = max_ts_of_all_args + 1;
+	  //update max ts over all indices
+	  if(qbits.max < max_ts_of_all_args + 1)
+	    qbits.max = max_ts_of_all_args + 1;
 	}  
       }
     } //intrinsic func
@@ -740,28 +721,20 @@ void ModCriticalPath::calc_critical_time(Function* F, qGate qg){
       uint64_t lenCritPath = (*cpit).second;
       
       for(int i=0;i<qg.numArgs; i++){
-	map<string, map<int,uint64_t> >::iterator mIter = funcQbits.find(qg.args[i].name);
-	assert(mIter!=funcQbits.end()); //should already have an entry for the name of the qbit
+	critpath::QbitArray &qbits = funcQbits[qg.args[i].id];
 	
 	//differentiate for qbit and qbit*
 	
 	if(qg.args[i].index == -1){ //qbit*
-	  for(map<int,uint64_t>::iterator entryIter = (*mIter).second.begin(); entryIter!=(*mIter).second.end();++entryIter){
-	    (*entryIter).second = max_ts_of_all_args + lenCritPath;
-	  }
+	  qbits.setAll(max_ts_of_all_args + lenCritPath);
 	}
       
 	else{ //qbit was passed
-	  map<int, uint64_t>::iterator currEntryIt = (*mIter).second.find(qg.args[i].index);
-	  if(currEntryIt!=(*mIter).second.end())
-	    (*currEntryIt).second = max_ts_of_all_args + lenCritPath;
-	  else
-	    (*mIter).second[qg.args[i].index] = max_ts_of_all_args + lenCritPath;
+	  qbits.at(qg.args[i].index) = max_ts_of_all_args + lenCritPath;
 	  
-	  //update -2 entry for the array, i.e. max ts over all indices
-	  currEntryIt = (*mIter).second.find(-2);
-	  if((*currEntryIt).second < max_ts_of_all_args + lenCritPath)
-	    (*currEntryIt).second = max_ts_of_all_args + lenCritPath;
+	  //update max ts over all indices
+	  if(qbits.max < max_ts_of_all_args + lenCritPath)
+	    qbits.max = max_ts_of_all_args + lenCritPath;
 	  
 	}
       }
@@ -868,7 +841,10 @@ void ModCriticalPath::analyzeCallInst(Function* F, Instruction* pInst){
        for(unsigned int vb=0; vb<allDepQbit.size(); vb++){
             if(allDepQbit[vb].argPtr){
                 qGateArg param =  allDepQbit[vb];       
-                thisGate.args[thisGate.numArgs].name = param.argPtr->getName();
+                int id = vectQbit.lookup(param.argPtr);
+                if(id < 0) //traced back to a cbit
+                  continue;
+                thisGate.args[thisGate.numArgs].id = id;
 		if(!param.isPtr)
 		  thisGate.args[thisGate.numArgs].index = param.valOrIndex;
                 thisGate.numArgs++;
@@ -884,19 +860,21 @@ void ModCriticalPath::analyzeCallInst(Function* F, Instruction* pInst){
 
 
 void ModCriticalPath::saveTableFuncQbits(Function* F){
-  map<unsigned int, map<int, uint64_t> > tmpFuncQbitsMap;
+  critpath::ArgQbits &table = tableFuncQbits[F];
 
   if(F->getName() == "PARSENODEROOT")
     print_funcQbits();
 
-  for(map<string, map<int, uint64_t> >::iterator mapIt = funcQbits.begin(); mapIt!=funcQbits.end(); ++mapIt){
-    map<string, unsigned int>::iterator argIt = funcArgs.find((*mapIt).first);
-    if(argIt!=funcArgs.end()){
-      unsigned int argNum = (*argIt).second;
-      tmpFuncQbitsMap[argNum] = (*mapIt).second;
+  table.arrays.assign(F->arg_size(), critpath::QbitArray());
+  table.isQbit.assign(F->arg_size(), false);
+
+  for(unsigned id = 0; id < funcQbits.size(); id++){
+    if(funcArgs[id] >= 0){
+      unsigned int argNum = funcArgs[id];
+      table.arrays[argNum] = funcQbits[id];
+      table.isQbit[argNum] = true;
     }
   }
-  tableFuncQbits[F] = tmpFuncQbitsMap;
 }
 
 void ModCriticalPath::CountCriticalFunctionResources (Function *F) {
@@ -968,8 +946,9 @@ bool ModCriticalPath::runOnModule (Module &M) {
 	  debugModCriticalPath = true;
 
 	funcQbits.clear();
-	//errs() << "Pt2 \n";
+	qbitValue.clear();
 	funcArgs.clear();
+	vectQbit.clear();
 
 	//errs() << "pt3 \n";
 	getFunctionArguments(F);
@@ -22,10 +22,15 @@
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/ADT/SCCIterator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Scaffold/ResourceTable.h"
 
 
 using namespace llvm;
 
+// Defined in ResourceCount.cpp
+extern cl::opt<unsigned> ResourceThreads;
+
 // An anonymous namespace for the pass. Things declared inside it are
 // only visible to the current file.
 namespace {
@@ -40,112 +45,23 @@ namespace {
       AU.addRequired<CallGraph>();    
     }
     
-    void CountFunctionResources (Function *F, std::map <Function*, unsigned long long* > FunctionResources) const {
-      // Traverse instruction by instruction
-      for (inst_iterator I = inst_begin(*F), E = inst_end(*F); I != E; ++I) {
-        Instruction *Inst = &*I;                            // Grab pointer to instruction reference
-
-        // Qubits?
-        if (AllocaInst *AI = dyn_cast<AllocaInst>(Inst)) {                  // Filter Allocation Instructions
-          Type *allocatedType = AI->getAllocatedType();
-
-          if (ArrayType *arrayType = dyn_cast<ArrayType>(allocatedType)) { // Filter allocation of arrays
-            Type *elementType = arrayType->getElementType();
-            if (elementType->isIntegerTy(16)) {                           // Filter allocation Type (qbit=i16)
-              uint64_t arraySize = arrayType->getNumElements();            
-              FunctionResources[F][0] += arraySize;                
-            }
-          }
-        }
-
-        // Gates?
-        if (CallInst *CI = dyn_cast<CallInst>(Inst)) {      // Filter Call Instructions
-          Function *callee = CI->getCalledFunction();
-          if (callee->isIntrinsic()) {                      // Intrinsic (Gate) Functions calls
-            if (callee->getName().str() == "llvm.X") 
-              FunctionResources[F][1]++;
-            else if (callee->getName().str() == "llvm.Z") 
-              FunctionResources[F][2]++;
-            else if (callee->getName().str() == "llvm.H") 
-              FunctionResources[F][3]++;
-            else if (callee->getName().str() == "llvm.T") {
-              FunctionResources[F][4]++;
-	      //errs() << "CI: " << *CI << "\n";
-	      //errs() << "Tcount = " << FunctionResources[F][4] << "\n";
-	    }
-            else if (callee->getName().str() == "llvm.Tdag")
-              FunctionResources[F][5]++;
-            else if (callee->getName().str() == "llvm.S") 
-              FunctionResources[F][6]++;
-            else if (callee->getName().str() == "llvm.Sdag")
-              FunctionResources[F][7]++;
-            else if (callee->getName().str() == "llvm.CNOT")
-              FunctionResources[F][8]++;            
-            else if (callee->getName().str() == "llvm.PrepZ") 
-              FunctionResources[F][9]++;
-            else if (callee->getName().str() == "llvm.MeasZ") 
-              FunctionResources[F][10]++;
-          }
-
-          else {                                              // Non-intrinsic Function Calls
-            // Resource numbers must be previously entered
-            // for this call. Look them up and add to this function's numbers.
-            if (FunctionResources.find(callee) != FunctionResources.end()) {
-              unsigned long long* callee_numbers = FunctionResources.find(callee)->second;
-              for (int l=0; l<11; l++)
-                FunctionResources[F][l] += callee_numbers[l];
-            }
-          }
-
-        }
-
-      }
-    }
-
     virtual bool runOnModule (Module &M) {
-      // Function* ---> Qubits | X | Z | H | T | CNOT | Toffoli | PrepZ | MeasZ | Rz | Ry
-      std::map <Function*, unsigned long long*> FunctionResources;
+      // Function ---> Qubit | X | Z | H | T | T_dag | S | S_dag | CNOT | PrepZ | MeasZ
+      //               | Y | Rx | Ry | Rz | Toffoli | Fredkin | PrepX | MeasX
+      resources::ResourceTable Table(M);
 
-      // iterate over all functions, and over all instructions in those functions
-      // find call sites that have constant integer values. In Post-Order.
-      CallGraphNode* rootNode = getAnalysis<CallGraph>().getRoot();
-      
       //fill in the gate count bottom-up in the call graph
-      for (scc_iterator<CallGraphNode*> sccIb = scc_begin(rootNode), E = scc_end(rootNode); sccIb != E; ++sccIb) {
-        const std::vector<CallGraphNode*> &nextSCC = *sccIb;
-        //errs() << "\nSCC #" << ++sccNum << " : ";      
-        for (std::vector<CallGraphNode*>::const_iterator nsccI = nextSCC.begin(), E = nextSCC.end(); nsccI != E; ++nsccI) {
-          Function *F = (*nsccI)->getFunction();	  
-          if (F && !F->isDeclaration()) {
-
-	    //errs() << "--Function: " << F->getName() << "\n";
-            // dynamically create array holding gate numbers for this function
-            unsigned long long* ResourceNumbers = new unsigned long long[11];
-            for (int k=0; k<11; k++)
-              ResourceNumbers[k] = 0;
-            FunctionResources.insert(std::make_pair(F, ResourceNumbers));
-
-            // count the gates of this function 
-            CountFunctionResources(F, FunctionResources);
-          }
-        }
+      Table.countCallGraph(getAnalysis<CallGraph>(), ResourceThreads);
+
+      // print results
+      for (unsigned i=0; i<Table.size(); i++) {
+        if (!Table.isCounted(i))
+          continue;
+        errs() << Table.getFunction(i)->getName() << ": \t";
+        errs() << resources::totalGates(Table.getRow(i)) << "\n";
+        //errs() << Table.getRow(i)[resources::T] << "\n"; // T Gates
       }
 
-      // print results      
-      for (std::map<Function*, unsigned long long*>::iterator i = FunctionResources.begin(), e = FunctionResources.end(); i!=e; ++i) {
-        errs() << i->first->getName() << ": \t";
-	unsigned long long function_total_gates = 0;
-        for (int j=1; j<11; j++)
-          function_total_gates += (i->second)[j];
-        errs() << function_total_gates <<"\n"; //<< " \t";
-        //errs() << (i->second)[4] << "\n"; // T Gates
-      }
-
-      // free memory
-      for (std::map<Function*, unsigned long long*>::iterator i = FunctionResources.begin(), e = FunctionResources.end(); i!=e; ++i)
-        delete [] i->second;
-
-
       return false;
     } // End runOnModule
   }; // End of struct ResourceCount2
@@ -0,0 +1,760 @@
+//===------------------------ ResourceCountSymbolic.cpp ----------------------===//
+// This file implements the Scaffold Pass of counting the number of qbits and
+// gates in a program without unrolling its loops first.
+//
+// Every function is summarized once: the gates of each basic block, the loops
+// around it and their backedge-taken counts as computed by ScalarEvolution.
+// The counts are kept as expressions over the function arguments and the
+// iterations of enclosing loops, so a function is counted separately for each
+// set of constant arguments it is called with, the way -FunctionClone would
+// have specialized it. A call whose arguments change from one iteration to
+// the next is counted once per iteration; everything else is multiplied by
+// the trip count.
+//
+// Loops whose trip count is still unknown are counted once, and so are blocks
+// that a branch inside a loop may skip, since the branch is not evaluated.
+// With -symbolic-unroll-fallback (the default) the functions containing them,
+// and their callers, are fully unrolled and the module is counted again; the
+// other functions keep their loops.
+//
+// The output has the same layout as -ResourceCount.
+//
+//        This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "ResourceCountSymbolic"
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <set>
+#include "llvm/Pass.h"
+#include "llvm/PassManager.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/Instruction.h"
+#include "llvm/Instructions.h"
+#include "llvm/Intrinsics.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scaffold/ResourceTable.h"
+
+using namespace llvm;
+
+STATISTIC(NumLoopsMultiplied, "Number of loops counted from their trip count");
+STATISTIC(NumLoopsUnknown, "Number of loops counted once, trip count unknown");
+STATISTIC(NumBlocksGuarded, "Number of blocks counted once, guarded inside a loop");
+STATISTIC(NumContexts, "Number of (function, constant arguments) pairs counted");
+STATISTIC(NumFallbackUnrolls, "Number of functions unrolled as a fallback");
+
+static cl::opt<bool>
+SymbolicUnrollFallback("symbolic-unroll-fallback", cl::init(true),
+  cl::desc("Fully unroll functions whose loop trip counts are unknown and "
+           "count them again"));
+
+static cl::opt<unsigned>
+SymbolicUnrollThreshold("symbolic-unroll-threshold", cl::init(100000000),
+  cl::Hidden, cl::desc("Loop unroll threshold of the fallback unrolling"));
+
+static cl::opt<unsigned>
+SymbolicMaxIterations("symbolic-max-iterations", cl::init(1000000),
+  cl::Hidden, cl::desc("Most iterations of a loop counted one at a time; "
+                       "longer loops are counted with the iteration unknown"));
+
+// An anonymous namespace for the pass. Things declared inside it are
+// only visible to the current file.
+namespace {
+
+  struct Resources {
+    unsigned long long N[resources::NumKinds];
+
+    Resources() {
+      for (unsigned k = 0; k < resources::NumKinds; k++)
+        N[k] = 0;
+    }
+
+    void add(const Resources &R, unsigned long long Times = 1) {
+      for (unsigned k = 0; k < resources::NumKinds; k++)
+        N[k] += R.N[k] * Times;
+    }
+  };
+
+  // A trip count or a call argument, translated from a SCEV so that it can
+  // still be evaluated once the ScalarEvolution of its function is gone
+  struct Expr {
+    enum KindTy { Const, Arg, Add, Mul, UDiv, SMax, UMax, Trunc, ZExt, SExt, AddRec };
+    KindTy Kind;
+    unsigned Width;                 // bits of the value
+    APInt Value;                    // Const
+    unsigned Index;                 // Arg: argument number, AddRec: loop number
+    std::vector<const Expr*> Ops;
+
+    Expr(KindTy K, unsigned W) : Kind(K), Width(W), Index(0) {}
+  };
+
+  struct LoopSummary {
+    int Parent;                     // enclosing loop, -1 at the top level
+    const Expr *BackedgeTaken;      // null when ScalarEvolution gives up
+    bool HeaderExits;               // exit test at the top: the body runs once less
+    BasicBlock *Header;
+  };
+
+  struct CallSummary {
+    Function *Callee;
+    std::vector<const Expr*> Args;  // null for arguments that are not integers
+  };
+
+  struct BlockSummary {
+    BasicBlock *BB;
+    std::vector<int> Nest;          // enclosing loops, outermost first
+    std::vector<bool> Varies;       // per Nest entry: needs the iteration number
+    std::vector<bool> Guarded;      // per Nest entry: not run on every iteration
+    Resources Local;                // qubits and gates of the block itself
+    std::vector<CallSummary> Calls;
+  };
+
+  struct FunctionSummary {
+    std::vector<LoopSummary> Loops;
+    std::vector<BlockSummary> Blocks; // only blocks with gates, qubits or calls
+    std::vector<bool> Relevant;       // arguments some trip count depends on
+    std::vector<Expr*> Nodes;
+
+    ~FunctionSummary() { DeleteContainerPointers(Nodes); }
+  };
+
+  // value of an integer argument, if it is a known constant
+  typedef std::pair<bool, int64_t> ArgValue;
+  typedef std::pair<Function*, std::vector<ArgValue> > Context;
+
+  // Derived from ModulePass to count qbits in functions
+  struct ResourceCountSymbolic : public ModulePass {
+    static char ID; // Pass identification
+    ResourceCountSymbolic() : ModulePass(ID), Noting(false) {}
+
+    std::map<Function*, FunctionSummary*> Summaries;
+    std::map<Context, Resources> Counted;
+    std::vector<Function*> Stack;                        // functions being counted
+    std::set<std::pair<Function*, BasicBlock*> > Unknown; // loops counted once
+    std::set<std::pair<Function*, BasicBlock*> > Guarded; // blocks counted once
+    std::set<Function*> Recursive;                       // calls counted as empty
+    std::set<Function*> ToUnroll;
+    bool Noting;                                         // record unknown loops
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<DominatorTree>();
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+    }
+
+    virtual void releaseMemory() {
+      clear();
+    }
+
+    void clear() {
+      for (std::map<Function*, FunctionSummary*>::iterator i = Summaries.begin(), e = Summaries.end(); i != e; ++i)
+        delete i->second;
+      Summaries.clear();
+      Counted.clear();
+      Stack.clear();
+      Unknown.clear();
+      Guarded.clear();
+      Recursive.clear();
+      ToUnroll.clear();
+    }
+
+    //===------------------------------------------------------------------===//
+    // Summaries
+    //===------------------------------------------------------------------===//
+
+    const Expr *translate(const SCEV *S, ScalarEvolution &SE,
+                          const DenseMap<const Loop*, unsigned> &LoopNumbers,
+                          FunctionSummary &FS) {
+      unsigned Width = SE.getTypeSizeInBits(S->getType());
+      Expr *E = 0;
+      switch (S->getSCEVType()) {
+        case scConstant:
+          E = new Expr(Expr::Const, Width);
+          E->Value = cast<SCEVConstant>(S)->getValue()->getValue();
+          break;
+        case scUnknown: {
+          Value *V = cast<SCEVUnknown>(S)->getValue();
+          if (Argument *A = dyn_cast<Argument>(V)) {
+            E = new Expr(Expr::Arg, Width);
+            E->Index = A->getArgNo();
+          } else if (ConstantInt *C = dyn_cast<ConstantInt>(V)) {
+            E = new Expr(Expr::Const, Width);
+            E->Value = C->getValue();
+          } else
+            return 0;
+          break;
+        }
+        case scTruncate:
+        case scZeroExtend:
+        case scSignExtend: {
+          const Expr *Op = translate(cast<SCEVCastExpr>(S)->getOperand(), SE, LoopNumbers, FS);
+          if (!Op)
+            return 0;
+          E = new Expr(S->getSCEVType() == scTruncate ? Expr::Trunc :
+                       S->getSCEVType() == scZeroExtend ? Expr::ZExt : Expr::SExt, Width);
+          E->Ops.push_back(Op);
+          break;
+        }
+        case scUDivExpr: {
+          const SCEVUDivExpr *D = cast<SCEVUDivExpr>(S);
+          const Expr *L = translate(D->getLHS(), SE, LoopNumbers, FS);
+          const Expr *R = translate(D->getRHS(), SE, LoopNumbers, FS);
+          if (!L || !R)
+            return 0;
+          E = new Expr(Expr::UDiv, Width);
+          E->Ops.push_back(L);
+          E->Ops.push_back(R);
+          break;
+        }
+        case scAddExpr:
+        case scMulExpr:
+        case scSMaxExpr:
+        case scUMaxExpr:
+        case scAddRecExpr: {
+          const SCEVNAryExpr *N = cast<SCEVNAryExpr>(S);
+          std::vector<const Expr*> Ops;
+          for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i) {
+            const Expr *Op = translate(N->getOperand(i), SE, LoopNumbers, FS);
+            if (!Op)
+              return 0;
+            Ops.push_back(Op);
+          }
+          unsigned LoopNumber = 0;
+          if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+            DenseMap<const Loop*, unsigned>::const_iterator I = LoopNumbers.find(AR->getLoop());
+            if (I == LoopNumbers.end())
+              return 0;
+            LoopNumber = I->second;
+          }
+          switch (S->getSCEVType()) {
+            case scAddExpr: E = new Expr(Expr::Add, Width); break;
+            case scMulExpr: E = new Expr(Expr::Mul, Width); break;
+            case scSMaxExpr: E = new Expr(Expr::SMax, Width); break;
+            case scUMaxExpr: E = new Expr(Expr::UMax, Width); break;
+            default: E = new Expr(Expr::AddRec, Width); E->Index = LoopNumber; break;
+          }
+          E->Ops = Ops;
+          break;
+        }
+        default:
+          return 0;
+      }
+      FS.Nodes.push_back(E);
+      return E;
+    }
+
+    // number the loops of a nest, parents before their subloops
+    void addLoop(Loop *L, int Parent, ScalarEvolution &SE,
+                 DenseMap<const Loop*, unsigned> &LoopNumbers, FunctionSummary &FS) {
+      unsigned Number = FS.Loops.size();
+      LoopNumbers[L] = Number;
+      LoopSummary LS;
+      LS.Parent = Parent;
+      LS.BackedgeTaken = 0;
+      LS.HeaderExits = L->getExitingBlock() == L->getHeader();
+      LS.Header = L->getHeader();
+      FS.Loops.push_back(LS);
+      for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I)
+        addLoop(*I, Number, SE, LoopNumbers, FS);
+    }
+
+    // true if BB runs on every iteration of L: it dominates every backedge
+    static bool runsEveryIteration(BasicBlock *BB, Loop *L, DominatorTree &DT) {
+      BasicBlock *Header = L->getHeader();
+      for (pred_iterator P = pred_begin(Header), E = pred_end(Header); P != E; ++P)
+        if (L->contains(*P) && !DT.dominates(BB, *P))
+          return false;
+      return true;
+    }
+
+    FunctionSummary *summarize(Function *F) {
+      DominatorTree &DT = getAnalysis<DominatorTree>(*F);
+      LoopInfo &LI = getAnalysis<LoopInfo>(*F);
+      ScalarEvolution &SE = getAnalysis<ScalarEvolution>(*F);
+      FunctionSummary *FS = new FunctionSummary();
+      FS->Relevant.assign(F->arg_size(), false);
+
+      DenseMap<const Loop*, unsigned> LoopNumbers;
+      for (LoopInfo::iterator I = LI.begin(), E = LI.end(); I != E; ++I)
+        addLoop(*I, -1, SE, LoopNumbers, *FS);
+      // trip counts may refer to enclosing loops, so translate them once
+      // every loop has its number
+      for (DenseMap<const Loop*, unsigned>::iterator I = LoopNumbers.begin(), E = LoopNumbers.end(); I != E; ++I) {
+        const SCEV *BTC = SE.getBackedgeTakenCount(I->first);
+        if (!isa<SCEVCouldNotCompute>(BTC))
+          FS->Loops[I->second].BackedgeTaken = translate(BTC, SE, LoopNumbers, *FS);
+      }
+
+      for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+        BlockSummary BS;
+        BS.BB = BB;
+        for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+          if (!resources::countInstruction(*I, BS.Local.N))
+            continue;
+          CallInst *CI = cast<CallInst>(I);
+          Function *callee = CI->getCalledFunction();
+          if (callee->isDeclaration())
+            continue;
+          CallSummary CS;
+          CS.Callee = callee;
+          for (unsigned a = 0, ae = CI->getNumArgOperands(); a != ae; ++a) {
+            Value *V = CI->getArgOperand(a);
+            const Expr *Arg = 0;
+            if (V->getType()->isIntegerTy() && SE.isSCEVable(V->getType()))
+              Arg = translate(SE.getSCEV(V), SE, LoopNumbers, *FS);
+            CS.Args.push_back(Arg);
+          }
+          BS.Calls.push_back(CS);
+        }
+
+        bool Interesting = !BS.Calls.empty();
+        for (unsigned k = 0; k < resources::NumKinds; k++)
+          Interesting |= BS.Local.N[k] != 0;
+        if (!Interesting)
+          continue;
+        // a loop runs the block on every iteration if the block, or the
+        // header of the next loop inside it, dominates its backedges
+        BasicBlock *Inner = BB;
+        for (Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop()) {
+          BS.Nest.insert(BS.Nest.begin(), LoopNumbers[L]);
+          BS.Guarded.insert(BS.Guarded.begin(), !runsEveryIteration(Inner, L, DT));
+          Inner = L->getHeader();
+        }
+        FS->Blocks.push_back(BS);
+      }
+      return FS;
+    }
+
+    static void collectArgs(const Expr *E, std::vector<bool> &Args) {
+      if (E->Kind == Expr::Arg) {
+        if (E->Index < Args.size())
+          Args[E->Index] = true;
+        return;
+      }
+      for (unsigned i = 0; i < E->Ops.size(); i++)
+        collectArgs(E->Ops[i], Args);
+    }
+
+    static bool mentionsLoop(const Expr *E, unsigned Loop) {
+      if (E->Kind == Expr::AddRec && E->Index == Loop)
+        return true;
+      for (unsigned i = 0; i < E->Ops.size(); i++)
+        if (mentionsLoop(E->Ops[i], Loop))
+          return true;
+      return false;
+    }
+
+    // An argument is relevant if a trip count depends on it, directly or
+    // through a relevant argument of a callee. Irrelevant arguments are left
+    // out of the context so that, e.g., a qubit index does not cause a
+    // function to be counted again for every value it is called with.
+    void findRelevantArguments() {
+      for (std::map<Function*, FunctionSummary*>::iterator i = Summaries.begin(), e = Summaries.end(); i != e; ++i) {
+        FunctionSummary &FS = *i->second;
+        for (unsigned l = 0; l < FS.Loops.size(); l++)
+          if (FS.Loops[l].BackedgeTaken)
+            collectArgs(FS.Loops[l].BackedgeTaken, FS.Relevant);
+      }
+
+      bool Changed = true;
+      while (Changed) {
+        Changed = false;
+        for (std::map<Function*, FunctionSummary*>::iterator i = Summaries.begin(), e = Summaries.end(); i != e; ++i) {
+          FunctionSummary &FS = *i->second;
+          std::vector<bool> Relevant = FS.Relevant;
+          for (unsigned b = 0; b < FS.Blocks.size(); b++)
+            for (unsigned c = 0; c < FS.Blocks[b].Calls.size(); c++) {
+              const CallSummary &CS = FS.Blocks[b].Calls[c];
+              const FunctionSummary &Callee = *Summaries[CS.Callee];
+              for (unsigned a = 0; a < CS.Args.size() && a < Callee.Relevant.size(); a++)
+                if (CS.Args[a] && Callee.Relevant[a])
+                  collectArgs(CS.Args[a], Relevant);
+            }
+          if (Relevant != FS.Relevant) {
+            FS.Relevant = Relevant;
+            Changed = true;
+          }
+        }
+      }
+
+      // a block needs the iteration number of a loop if a relevant call
+      // argument or the trip count of a loop inside it depends on it
+      for (std::map<Function*, FunctionSummary*>::iterator i = Summaries.begin(), e = Summaries.end(); i != e; ++i) {
+        FunctionSummary &FS = *i->second;
+        for (unsigned b = 0; b < FS.Blocks.size(); b++) {
+          BlockSummary &BS = FS.Blocks[b];
+          BS.Varies.assign(BS.Nest.size(), false);
+          for (unsigned d = 0; d < BS.Nest.size(); d++) {
+            for (unsigned inner = d + 1; inner < BS.Nest.size() && !BS.Varies[d]; inner++) {
+              const Expr *BTC = FS.Loops[BS.Nest[inner]].BackedgeTaken;
+              if (BTC && mentionsLoop(BTC, BS.Nest[d]))
+                BS.Varies[d] = true;
+            }
+            for (unsigned c = 0; c < BS.Calls.size() && !BS.Varies[d]; c++) {
+              const CallSummary &CS = BS.Calls[c];
+              const FunctionSummary &Callee = *Summaries[CS.Callee];
+              for (unsigned a = 0; a < CS.Args.size() && a < Callee.Relevant.size(); a++)
+                if (CS.Args[a] && Callee.Relevant[a] && mentionsLoop(CS.Args[a], BS.Nest[d]))
+                  BS.Varies[d] = true;
+            }
+          }
+        }
+      }
+    }
+
+    //===------------------------------------------------------------------===//
+    // Evaluation
+    //===------------------------------------------------------------------===//
+
+    struct Env {
+      const std::vector<ArgValue> *Args;
+      std::vector<int64_t> Iteration;   // per loop, -1 when not enumerated
+    };
+
+    static bool evaluate(const Expr *E, const Env &Ev, APInt &V) {
+      switch (E->Kind) {
+        case Expr::Const:
+          V = E->Value;
+          return true;
+        case Expr::Arg:
+          if (E->Index >= Ev.Args->size() || !(*Ev.Args)[E->Index].first)
+            return false;
+          V = APInt(E->Width, (*Ev.Args)[E->Index].second, true);
+          return true;
+        case Expr::Trunc:
+        case Expr::ZExt:
+        case Expr::SExt:
+          if (!evaluate(E->Ops[0], Ev, V))
+            return false;
+          V = E->Kind == Expr::Trunc ? V.trunc(E->Width) :
+              E->Kind == Expr::ZExt ? V.zext(E->Width) : V.sext(E->Width);
+          return true;
+        case Expr::UDiv: {
+          APInt R;
+          if (!evaluate(E->Ops[0], Ev, V) || !evaluate(E->Ops[1], Ev, R) || !R)
+            return false;
+          V = V.udiv(R);
+          return true;
+        }
+        case Expr::AddRec: {
+          // {Op0,+,Op1,+,...,+,Opn} at iteration i is sum Opk * binomial(i, k)
+          int64_t It = Ev.Iteration[E->Index];
+          if (It < 0)
+            return false;
+          APInt Binomial(128, 1), Sum(E->Width, 0), Op;
+          for (unsigned k = 0; k < E->Ops.size(); k++) {
+            if (k > 0)
+              Binomial = (Binomial * APInt(128, It - (k - 1))).udiv(APInt(128, k));
+            if (!evaluate(E->Ops[k], Ev, Op))
+              return false;
+            Sum += Op * Binomial.trunc(E->Width);
+          }
+          V = Sum;
+          return true;
+        }
+        default: {
+          if (!evaluate(E->Ops[0], Ev, V))
+            return false;
+          APInt Op;
+          for (unsigned i = 1; i < E->Ops.size(); i++) {
+            if (!evaluate(E->Ops[i], Ev, Op))
+              return false;
+            switch (E->Kind) {
+              case Expr::Add: V += Op; break;
+              case Expr::Mul: V *= Op; break;
+              case Expr::SMax: if (Op.sgt(V)) V = Op; break;
+              case Expr::UMax: if (Op.ugt(V)) V = Op; break;
+              default: return false;
+            }
+          }
+          return true;
+        }
+      }
+    }
+
+    // how often BB runs each time loop l is entered
+    bool tripCount(const FunctionSummary &FS, unsigned l, BasicBlock *BB,
+                   const Env &Ev, unsigned long long &N) {
+      const LoopSummary &LS = FS.Loops[l];
+      APInt BTC;
+      if (!LS.BackedgeTaken || !evaluate(LS.BackedgeTaken, Ev, BTC))
+        return false;
+      // ScalarEvolution relies on the guard in front of the loop when it
+      // builds the count; a negative count means the guard keeps it from
+      // being entered with these arguments
+      if (BTC.isNegative()) {
+        N = 0;
+        return true;
+      }
+      if (BTC.getActiveBits() > 63)
+        return false;
+      N = BTC.getZExtValue();
+      if (!LS.HeaderExits || BB == LS.Header)
+        N++;
+      return true;
+    }
+
+    void noteUnknown(Function *F, const LoopSummary &LS) {
+      if (!Noting)
+        return;
+      if (Unknown.insert(std::make_pair(F, LS.Header)).second)
+        ++NumLoopsUnknown;
+      // unrolling F helps when ScalarEvolution gave up on the loop; when
+      // the trip count depends on an argument it is the callers that need it
+      ToUnroll.insert(F);
+      if (LS.BackedgeTaken)
+        ToUnroll.insert(Stack.begin(), Stack.end());
+    }
+
+    void noteGuarded(Function *F, const BlockSummary &BS, const LoopSummary &LS) {
+      if (!Noting)
+        return;
+      if (Guarded.insert(std::make_pair(F, BS.BB)).second)
+        ++NumBlocksGuarded;
+      // the branch folds once F is unrolled, if the trip count does not
+      // depend on its arguments
+      ToUnroll.insert(F);
+      std::vector<bool> Args(F->arg_size(), false);
+      if (LS.BackedgeTaken)
+        collectArgs(LS.BackedgeTaken, Args);
+      if (std::find(Args.begin(), Args.end(), true) != Args.end())
+        ToUnroll.insert(Stack.begin(), Stack.end());
+    }
+
+    Resources countBlock(Function *F, const FunctionSummary &FS, const BlockSummary &BS,
+                         unsigned Depth, Env &Ev) {
+      Resources R;
+      if (Depth == BS.Nest.size()) {
+        R.add(BS.Local);
+        for (unsigned c = 0; c < BS.Calls.size(); c++)
+          R.add(countCall(BS.Calls[c], Ev));
+        return R;
+      }
+
+      unsigned l = BS.Nest[Depth];
+      unsigned long long N;
+      if (!tripCount(FS, l, BS.BB, Ev, N)) {
+        noteUnknown(F, FS.Loops[l]);
+        N = 1;
+      }
+      if (BS.Guarded[Depth]) {
+        noteGuarded(F, BS, FS.Loops[l]);
+        N = std::min(N, 1ULL);
+      }
+      // otherwise the iteration stays unknown, and so do the trip counts
+      // and call arguments that depend on it
+      if (BS.Varies[Depth] && !BS.Guarded[Depth] && N <= SymbolicMaxIterations) {
+        for (unsigned long long i = 0; i < N; i++) {
+          Ev.Iteration[l] = i;
+          R.add(countBlock(F, FS, BS, Depth + 1, Ev));
+        }
+        Ev.Iteration[l] = -1;
+      } else
+        R.add(countBlock(F, FS, BS, Depth + 1, Ev), N);
+      return R;
+    }
+
+    Resources countCall(const CallSummary &CS, const Env &Ev) {
+      const FunctionSummary &Callee = *Summaries[CS.Callee];
+      std::vector<ArgValue> Args(CS.Callee->arg_size(), ArgValue(false, 0));
+      for (unsigned a = 0; a < CS.Args.size() && a < Args.size(); a++) {
+        APInt V;
+        if (CS.Args[a] && Callee.Relevant[a] && evaluate(CS.Args[a], Ev, V) &&
+            V.getMinSignedBits() <= 64)
+          Args[a] = ArgValue(true, V.getSExtValue());
+      }
+      return count(CS.Callee, Args);
+    }
+
+    Resources count(Function *F, const std::vector<ArgValue> &Args) {
+      Context C(F, Args);
+      std::map<Context, Resources>::iterator Done = Counted.find(C);
+      if (Done != Counted.end())
+        return Done->second;
+      // recursion: the inner call contributes nothing, as in -ResourceCount,
+      // whatever its arguments are; an argument that counts down would
+      // otherwise give every level a context of its own
+      if (std::find(Stack.begin(), Stack.end(), F) != Stack.end()) {
+        if (Noting)
+          Recursive.insert(F);
+        return Resources();
+      }
+      ++NumContexts;
+
+      const FunctionSummary &FS = *Summaries[F];
+      Env Ev;
+      Ev.Args = &Args;
+      Ev.Iteration.assign(FS.Loops.size(), -1);
+
+      Stack.push_back(F);
+      Resources R;
+      for (unsigned b = 0; b < FS.Blocks.size(); b++)
+        R.add(countBlock(F, FS, FS.Blocks[b], 0, Ev));
+      Stack.pop_back();
+
+      Counted[C] = R;
+      return R;
+    }
+
+    //===------------------------------------------------------------------===//
+    // Driver
+    //===------------------------------------------------------------------===//
+
+    void countModule(Module &M) {
+      clear();
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+        if (!F->isDeclaration())
+          Summaries[F] = summarize(F);
+      findRelevantArguments();
+
+      // count from main so that only the loops it reaches are reported and
+      // unrolled; functions it does not call get a row without known arguments
+      Function *Main = M.getFunction("main");
+      Noting = true;
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+        if (!F->isDeclaration() && (!Main || &*F == Main))
+          count(F, std::vector<ArgValue>(F->arg_size(), ArgValue(false, 0)));
+      Noting = false;
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+        if (F->isDeclaration())
+          continue;
+        std::map<Context, Resources>::iterator i =
+          Counted.lower_bound(Context(F, std::vector<ArgValue>()));
+        if (i == Counted.end() || i->first.first != F)
+          count(F, std::vector<ArgValue>(F->arg_size(), ArgValue(false, 0)));
+      }
+
+      for (std::map<Function*, FunctionSummary*>::iterator i = Summaries.begin(), e = Summaries.end(); i != e; ++i)
+        for (unsigned l = 0; l < i->second->Loops.size(); l++)
+          if (!Unknown.count(std::make_pair(i->first, i->second->Loops[l].Header)))
+            ++NumLoopsMultiplied;
+    }
+
+    // fully unroll the functions in ToUnroll; false if nothing changed
+    bool unroll(Module &M) {
+      FunctionPassManager FPM(&M);
+      if (!M.getDataLayout().empty())
+        FPM.add(new TargetData(M.getDataLayout()));
+      FPM.add(createLoopSimplifyPass());
+      FPM.add(createLoopRotatePass());
+      FPM.add(createLCSSAPass());
+      FPM.add(createLoopUnrollPass(SymbolicUnrollThreshold));
+      FPM.add(createSCCPPass());
+      FPM.add(createCFGSimplificationPass());
+
+      bool Changed = false;
+      FPM.doInitialization();
+      for (std::set<Function*>::iterator i = ToUnroll.begin(), e = ToUnroll.end(); i != e; ++i) {
+        DEBUG(dbgs() << "ResourceCountSymbolic: unrolling " << (*i)->getName() << "\n");
+        if (FPM.run(**i)) {
+          ++NumFallbackUnrolls;
+          Changed = true;
+        }
+      }
+      FPM.doFinalization();
+      return Changed;
+    }
+
+    void print(Module &M) {
+      for (unsigned k = 0; k < resources::NumKinds; k++)
+        errs() << "\t" << resources::getName(k);
+      errs() << "\n";
+
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+        if (F->isDeclaration())
+          continue;
+        std::map<Context, Resources>::iterator i =
+          Counted.lower_bound(Context(F, std::vector<ArgValue>()));
+        for (; i != Counted.end() && i->first.first == F; ++i) {
+          const std::vector<ArgValue> &Args = i->first.second;
+          errs() << "Function: " << F->getName();
+          bool Known = false;
+          for (unsigned a = 0; a < Args.size(); a++)
+            Known |= Args[a].first;
+          if (Known) {
+            errs() << "(";
+            for (unsigned a = 0; a < Args.size(); a++) {
+              if (a)
+                errs() << ", ";
+              if (Args[a].first)
+                errs() << Args[a].second;
+              else
+                errs() << "?";
+            }
+            errs() << ")";
+          }
+          errs() << "\n";
+          for (unsigned j = 0; j < resources::NumKinds; j++)
+            errs() << "\t" << i->second.N[j];
+          errs() << "\n";
+        }
+      }
+
+      if (Function *Main = M.getFunction("main")) {
+        const Resources &R = Counted[Context(Main, std::vector<ArgValue>(Main->arg_size(), ArgValue(false, 0)))];
+        errs() << "\ntotal_gates = " << resources::totalGates(R.N) << "\n";
+      }
+
+      if (!Unknown.empty()) {
+        errs() << "\nLoops counted once, trip count unknown:\n";
+        for (std::set<std::pair<Function*, BasicBlock*> >::iterator i = Unknown.begin(), e = Unknown.end(); i != e; ++i)
+          errs() << "\t" << i->first->getName() << ": " << i->second->getName() << "\n";
+      }
+
+      if (!Guarded.empty()) {
+        errs() << "\nBlocks counted once, behind a branch inside a loop:\n";
+        for (std::set<std::pair<Function*, BasicBlock*> >::iterator i = Guarded.begin(), e = Guarded.end(); i != e; ++i)
+          errs() << "\t" << i->first->getName() << ": " << i->second->getName() << "\n";
+      }
+
+      if (!Recursive.empty()) {
+        errs() << "\nRecursive calls counted as empty:\n";
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+          if (Recursive.count(F))
+            errs() << "\t" << F->getName() << "\n";
+      }
+    }
+
+    virtual bool runOnModule (Module &M) {
+      bool Changed = false;
+      countModule(M);
+      // stop as soon as unrolling no longer gets rid of unknown loops or
+      // guarded blocks
+      while (Unknown.size() + Guarded.size() > 0 && SymbolicUnrollFallback) {
+        size_t Before = Unknown.size() + Guarded.size();
+        if (!unroll(M))
+          break;
+        Changed = true;
+        countModule(M);
+        if (Unknown.size() + Guarded.size() >= Before)
+          break;
+      }
+      print(M);
+      return Changed;
+    } // End runOnModule
+  }; // End of struct ResourceCountSymbolic
+} // End of anonymous namespace
+
+
+
+char ResourceCountSymbolic::ID = 0;
+static RegisterPass<ResourceCountSymbolic> X("ResourceCountSymbolic",
+  "Resource Counter Pass using loop trip counts instead of unrolling");
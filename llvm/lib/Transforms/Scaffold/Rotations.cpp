@@ -3,11 +3,25 @@
 // sequences of clifford+T gates
 //
 
+#define DEBUG_TYPE "Rotations"
+
+#include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <queue>
 #include <sstream>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <unistd.h>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 
 #include "llvm/Constants.h"
 #include "llvm/Function.h"
@@ -19,9 +33,14 @@
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/InstVisitor.h"
+#include "llvm/Support/IRBuilder.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/PathV2.h"
 
+#include "llvm/Transforms/Scaffold/RotationDistance.h"
+#include "llvm/Transforms/Scaffold/SKDecomp.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 using namespace llvm;
@@ -30,49 +49,421 @@ static cl::opt<unsigned>
 SqctLevels("sqct-levels", cl::init(1), cl::Hidden,
   cl::desc("The rotation decomposition precision"));
 
+static cl::opt<std::string>
+RotationCacheFile("rotation-cache", cl::init(""), cl::value_desc("filename"),
+  cl::desc("File of rotation decompositions reused across compilations"));
+
+static cl::opt<unsigned>
+RotationThreads("rotation-threads", cl::init(0),
+  cl::desc("Decomposer processes to run at a time (default: one per core; "
+           "-sqct-lib runs on one thread)"));
+
+static cl::opt<std::string>
+SqctLib("sqct-lib", cl::init(""), cl::value_desc("library"),
+  cl::desc("Decompose rotations in process with the sqct library "
+           "(libskdecomp.so) instead of running ROTATIONPATH; "
+           "defaults to $SQCT_LIB"));
+
+static cl::opt<double>
+RotationErrorBudget("rotation-error-budget", cl::init(0.0),
+  cl::desc("Total synthesis error allowed over all executed rotations; "
+           "chooses the precision of each angle (default: off)"));
+
+static cl::opt<std::string>
+RotationFreqFile("rotation-freq", cl::init(""), cl::value_desc("filename"),
+  cl::desc("Profile (.freq) giving how often each function is called, for "
+           "-rotation-error-budget (default: every rotation runs once)"));
+
+static cl::list<unsigned>
+RotationPrecisions("rotation-precisions", cl::CommaSeparated,
+  cl::value_desc("precision,..."),
+  cl::desc("Precisions -rotation-error-budget chooses from: sqct levels "
+           "(default 0,1,2,3) or gridsynth digits (default 2 to 10)"));
+
+static cl::opt<bool>
+RotationSeq("rotation-seq", cl::init(false),
+  cl::desc("Give each decomposition one llvm.CliffordTSeq call carrying its "
+           "gates as a string, instead of one call per gate"));
+
+STATISTIC(NumDecomposed, "Number of rotations sent to the decomposer");
+STATISTIC(NumCacheHits, "Number of rotations found in the rotation cache");
+STATISTIC(NumShared, "Number of rotations that reuse the decomposition of another angle");
+STATISTIC(NumExact, "Number of rotations that are exactly Clifford+T");
+
+namespace {
+	// Decompositions from earlier compilations, one line per decomposition:
+	//   tool <tab> axis <tab> precision <tab> angle <tab> gates
+	// where angle is spelled exactly as it was passed to the tool. The file is
+	// only ever appended to, under an exclusive flock; readers take a shared
+	// one, so concurrent compilations can share it. A line left incomplete by
+	// a killed compilation is ignored.
+	class RotationCache {
+		std::string Path;
+		StringMap<std::string> Entries;
+
+	public:
+		void open(const std::string &File) {
+			Path = File;
+			Entries.clear();
+			if (Path.empty()) return;
+			int FD = ::open(Path.c_str(), O_RDONLY);
+			if (FD < 0) return;
+			flock(FD, LOCK_SH);
+			std::string Contents;
+			char Buf[1 << 16];
+			ssize_t N;
+			while ((N = read(FD, Buf, sizeof(Buf))) > 0)
+				Contents.append(Buf, N);
+			close(FD);
+
+			StringRef Rest(Contents);
+			while (!Rest.empty()) {
+				std::pair<StringRef, StringRef> Line = Rest.split('\n');
+				bool Complete = Line.first.size() < Rest.size();
+				Rest = Line.second;
+				size_t Split = Line.first.rfind('\t');
+				if (!Complete || Line.first.count('\t') != 4) continue;
+				Entries[Line.first.substr(0, Split)] = Line.first.substr(Split + 1);
+			}
+		}
+
+		bool lookup(const std::string &Key, std::string &Gates) const {
+			StringMap<std::string>::const_iterator I = Entries.find(Key);
+			if (I == Entries.end()) return false;
+			Gates = I->second;
+			return true;
+		}
+
+		void insert(const std::string &Key, const std::string &Gates) {
+			Entries[Key] = Gates;
+			if (Path.empty()) return;
+			bool Existed;
+			StringRef Dir = sys::path::parent_path(Path);
+			if (!Dir.empty()) sys::fs::create_directories(Dir, Existed);
+			int FD = ::open(Path.c_str(), O_RDWR | O_APPEND | O_CREAT, 0666);
+			if (FD < 0) {
+				errs() << "Cannot write rotation cache " << Path << "\n";
+				Path.clear();
+				return;
+			}
+			flock(FD, LOCK_EX);
+			// Terminate a line left incomplete by a killed writer
+			std::string Line = Key + "\t" + Gates + "\n";
+			char Last = '\n';
+			if (lseek(FD, -1, SEEK_END) >= 0 && read(FD, &Last, 1) == 1 && Last != '\n')
+				Line = "\n" + Line;
+			if (write(FD, Line.data(), Line.size()) != (ssize_t)Line.size())
+				errs() << "Cannot write rotation cache " << Path << "\n";
+			close(FD);
+		}
+	};
+} // namespace
+
 
 namespace {
+	// Run cmd and capture its output; false if it could not be run or did not
+	// exit cleanly
+	bool exec(const char* cmd, std::string &result) {
+		result = "";
+		FILE* pipe = popen(cmd, "r");
+		if (!pipe) {
+			result = "ERROR";
+			return false;
+		}
+		char buffer[128];
+		while(!feof(pipe)) {
+			if (fgets(buffer, 128, pipe) != NULL)
+				result += buffer;
+		}
+		return pclose(pipe) == 0;
+	} // exec()
+
+	// The sqct library (SKDecomp.h), opened on first use and kept for the
+	// rest of the process so that its epsilon-net is only loaded once
+	class SqctLibrary {
+		skdecomp *Decomposer;
+		skdecomp_rotation_fn Rotation;
+
+		SqctLibrary() : Decomposer(0), Rotation(0) {}
+
+		bool load(const std::string &Path) {
+			void *Handle = dlopen(Path.c_str(), RTLD_NOW | RTLD_LOCAL);
+			if (!Handle) {
+				errs() << "Cannot load sqct library: " << dlerror() << "\n";
+				return false;
+			}
+			skdecomp_api_version_fn Version =
+				(skdecomp_api_version_fn)dlsym(Handle, "skdecomp_api_version");
+			skdecomp_create_fn Create =
+				(skdecomp_create_fn)dlsym(Handle, "skdecomp_create");
+			Rotation = (skdecomp_rotation_fn)dlsym(Handle, "skdecomp_rotation");
+			if (!Version || !Create || !Rotation ||
+			    Version() != SKDECOMP_API_VERSION) {
+				errs() << "Incompatible sqct library " << Path << "\n";
+				return false;
+			}
+			// rotZ generates and loads the layers up to 30
+			Decomposer = Create(30);
+			if (!Decomposer) {
+				errs() << "sqct library " << Path << " failed to load its epsilon-net\n";
+				return false;
+			}
+			return true;
+		}
+
+	public:
+		// The library named by -sqct-lib or $SQCT_LIB, or null if there is
+		// none or it cannot be used
+		static SqctLibrary *get() {
+			static bool Loaded = false;
+			static SqctLibrary *Lib = 0;
+			if (!Loaded) {
+				Loaded = true;
+				std::string Path = SqctLib;
+				if (Path.empty() && getenv("SQCT_LIB"))
+					Path = getenv("SQCT_LIB");
+				if (!Path.empty()) {
+					Lib = new SqctLibrary();
+					if (!Lib->load(Path)) {
+						delete Lib;
+						Lib = 0;
+					}
+				}
+			}
+			return Lib;
+		}
+
+		// Same result as running rotZ <angle> <axis> <iterations>
+		bool decompose(char Axis, double Angle, int Iterations, std::string &result) {
+			std::vector<char> Buf(4096);
+			int N = Rotation(Decomposer, Axis, Angle, Iterations, &Buf[0], Buf.size());
+			if (N >= (int)Buf.size()) {
+				Buf.resize(N + 1);
+				N = Rotation(Decomposer, Axis, Angle, Iterations, &Buf[0], Buf.size());
+			}
+			if (N < 0) {
+				result = "ERROR";
+				return false;
+			}
+			result.assign(&Buf[0], N);
+			return true;
+		}
+	};
+
+	// One run of the decomposer
+	struct DecompositionJob {
+		std::string Name;       // DecomposeRotation_* function
+		std::string Key;        // RotationCache key
+		std::string Command;    // tool command line, if not in process
+		char Axis;              // in process: arguments of rotZ
+		double ToolAngle;
+		unsigned Precision;
+		std::string Circuit;    // captured output
+		bool Ok;
+	};
+
+	// The decomposer runs are independent, so a few threads each take the
+	// next job until none are left
+	struct JobQueue {
+		std::vector<DecompositionJob> *Jobs;
+		SqctLibrary *Lib;
+		size_t Next;
+		pthread_mutex_t Lock;
+	};
+
+	void *runJobs(void *Arg) {
+		JobQueue *Q = static_cast<JobQueue*>(Arg);
+		for (;;) {
+			pthread_mutex_lock(&Q->Lock);
+			size_t i = Q->Next++;
+			pthread_mutex_unlock(&Q->Lock);
+			if (i >= Q->Jobs->size()) return 0;
+			DecompositionJob &J = (*Q->Jobs)[i];
+			if (Q->Lib)
+				J.Ok = Q->Lib->decompose(J.Axis, J.ToolAngle, J.Precision, J.Circuit);
+			else
+				J.Ok = exec(J.Command.c_str(), J.Circuit);
+		}
+	}
+
+	void runJobsInParallel(std::vector<DecompositionJob> &Jobs, SqctLibrary *Lib,
+	                       unsigned Threads) {
+		JobQueue Q;
+		Q.Jobs = &Jobs;
+		Q.Lib = Lib;
+		Q.Next = 0;
+		pthread_mutex_init(&Q.Lock, 0);
+		if (Threads == 0) {
+			long Cores = sysconf(_SC_NPROCESSORS_ONLN);
+			Threads = Cores > 0 ? Cores : 1;
+		}
+		// There is one in-process decomposer and it is not reentrant, so only
+		// the tool processes run side by side
+		if (Lib) Threads = 1;
+		if (Threads > Jobs.size()) Threads = Jobs.size();
+		// The calling thread is one of the workers
+		std::vector<pthread_t> Pool;
+		for (unsigned t = 1; t < Threads; t++) {
+			pthread_t Thread;
+			if (pthread_create(&Thread, 0, runJobs, &Q) == 0)
+				Pool.push_back(Thread);
+		}
+		runJobs(&Q);
+		for (unsigned t = 0; t < Pool.size(); t++)
+			pthread_join(Pool[t], 0);
+		pthread_mutex_destroy(&Q.Lock);
+	}
+
+	// Rotations by multiples of pi/4 are Clifford+T, so R(theta) is decomposed
+	// as R(r) R(k pi/4) with r in [0, pi/4). An r above pi/8 is folded to
+	// pi/4 - r through R(-r), whose decomposition is that of R(r) with every
+	// gate complex conjugated (X and Z axes) or conjugated by X (Y axis). All
+	// angles with the same representative share one decomposer run.
+	struct CanonicalAngle {
+		double Angle;            // in [0, pi/8]; 0 if R(theta) is Clifford+T
+		bool Negated;            // R(-Angle) is used
+		std::string Correction;  // gates of R(k pi/4)
+	};
+
+	// Angles closer than this to a multiple of pi/4 are taken as exact
+	const double ExactAngleTolerance = 1e-12;
+
+	CanonicalAngle canonicalize(const std::string &Axis, double Angle) {
+		static const char *TPowers[8] = { "", "T", "P", "PT", "Z", "ZT", "p", "t" };
+		const double PiOver4 = 0.78539816339744830962;
+		double Steps = std::floor(Angle / PiOver4);
+		double R = Angle - Steps * PiOver4;
+		int K = (int)std::fmod(Steps, 8.0);
+		if (K < 0) K += 8;
+		CanonicalAngle C;
+		C.Negated = R > PiOver4 / 2;
+		if (C.Negated) {
+			R = PiOver4 - R;
+			K = (K + 1) % 8;
+		}
+		C.Angle = R < ExactAngleTolerance ? 0.0 : R;
+		// Rz(k pi/4) = T^k, Rx = H Rz H, Ry = S Rx S^+ (up to global phase)
+		std::string TK = TPowers[K];
+		if (TK.empty() || Axis == "Z")
+			C.Correction = TK;
+		else if (Axis == "X")
+			C.Correction = "H" + TK + "H";
+		else
+			C.Correction = "PH" + TK + "Hp";
+		return C;
+	}
+
+	// Gates of R(theta) from the decomposition of its representative
+	std::string applyCanonical(const std::string &Axis, const CanonicalAngle &C,
+	                           const std::string &Circuit) {
+		std::string Gates;
+		if (C.Angle != 0.0)
+			for (unsigned c = 0; c < Circuit.size(); c++)
+				if (strchr("TtPpHXYZ", Circuit[c])) Gates += Circuit[c];
+		if (C.Negated && !Gates.empty()) {
+			if (Axis == "Y")
+				Gates = "X" + Gates + "X";
+			else
+				for (unsigned c = 0; c < Gates.size(); c++)
+					switch (Gates[c]) {
+						case 'T': Gates[c] = 't'; break;
+						case 't': Gates[c] = 'T'; break;
+						case 'P': Gates[c] = 'p'; break;
+						case 'p': Gates[c] = 'P'; break;
+					}
+		}
+		return Gates + C.Correction;
+	}
+
+	// Gates of a rotation about Axis from those of the Rz by the same angle,
+	// as for the corrections in canonicalize
+	std::string fromZ(const std::string &Axis, const std::string &Circuit) {
+		if (Axis == "X")
+			return "H" + Circuit + "H";
+		if (Axis == "Y")
+			return "PH" + Circuit + "Hp";
+		return Circuit;
+	}
+
+	unsigned countT(const std::string &Gates) {
+		unsigned N = 0;
+		for (unsigned g = 0; g < Gates.size(); g++)
+			if (Gates[g] == 'T' || Gates[g] == 't') N++;
+		return N;
+	}
+
+	// How often each function is called, from the 10th column of a .freq
+	// profile (see RuntimeFrequencyEstimation)
+	bool readFrequencies(const std::string &File, StringMap<double> &Freq) {
+		std::ifstream In(File.c_str());
+		if (!In) return false;
+		std::string Line;
+		while (std::getline(In, Line)) {
+			std::istringstream Cols(Line);
+			std::vector<std::string> Col;
+			std::string Tok;
+			while (Cols >> Tok) Col.push_back(Tok);
+			if (Col.size() < 10) continue;
+			Freq[Col[0]] = strtod(Col[9].c_str(), 0);
+		}
+		return true;
+	}
+
+	// A DecomposeRotation_* function waiting for the decompositions of its
+	// representative, one per precision
+	struct PendingRotation {
+		std::string Name;
+		std::string Axis;
+		double Angle;
+		CanonicalAngle Canonical;
+		std::vector<std::string> Keys;   // RotationCache key per precision
+		bool FromZ;                      // Keys hold Rz decompositions (gridsynth)
+		double Executions;
+		unsigned Chosen;                 // index into Keys
+	};
+
+	// A precision upgrade for -rotation-error-budget: how much weighted
+	// error it removes per T gate it adds
+	struct Upgrade {
+		double Gain;
+		unsigned Rotation, From, To;
+		bool operator<(const Upgrade &O) const { return Gain < O.Gain; }
+	};
+
 	// We need to use a ModulePass in order to create new Functions
 	struct Rotations : public ModulePass {
 		static char ID;
 		Rotations() : ModulePass(ID) {}
 
+		// A call to Rx/Ry/Rz with a constant angle
+		struct RotationSite {
+			CallInst *Call;
+			std::string Axis;
+			double Angle;
+		};
+
+		// Collects the rotations of the module in program order; nothing is
+		// changed until all of them are known
 		struct RotationVisitor : public InstVisitor<RotationVisitor> {
-			// All decompositions will be created as Functions in M's FunctionList
-			Module *M;
-			// The constructor is called once per module (in runOnModule)
-			RotationVisitor(Module *module) : M(module) {}
-
-			// private:
-			std::string exec(const char* cmd) {
-				FILE* pipe = popen(cmd, "r");
-				if (!pipe) return "ERROR";
-				char buffer[128];
-				std::string result = "";
-				while(!feof(pipe)) {
-					if (fgets(buffer, 128, pipe) != NULL)
-						result += buffer;
-				}
-				pclose(pipe);
-				return result;
-			} // exec()
-			// public: 
+			std::vector<RotationSite> &Sites;
+			RotationVisitor(std::vector<RotationSite> &sites) : Sites(sites) {}
+
 			void visitCallInst(CallInst &I) {
 				// Determine whether this is an Rz gate
 				Function *CF = I.getCalledFunction();
 				// Is this an intrinsic?
-				if (!CF->isIntrinsic()) return;
+				if (!CF || !CF->isIntrinsic()) return;
 				// If it is a rotation, what is the axis?
 				std::string axis;
 				switch (CF->getIntrinsicID()) {
 					case Intrinsic::Rz:
-						axis = std::string(" Z ");
+						axis = std::string("Z");
 						break;
 					case Intrinsic::Rx:
-						axis = std::string(" X ");
+						axis = std::string("X");
 						break;
 					case Intrinsic::Ry:
-						axis = std::string(" Y ");
+						axis = std::string("Y");
 						break;
 					default:
 						return;
@@ -82,137 +473,409 @@ namespace {
 					errs() << "Unknown rotation angle\n";
 					return;
 				}
-				// Extract the target qubit from the CallInst
-				// Using CallSite
-				// CallSite CS(&I);
-				// Value *Target = CS.getArgument(0);
-				// errs() << *Target << "\n";
-				// END CallSite
-				Value *Target = I.getArgOperand(0);
+				RotationSite Site;
+				Site.Call = &I;
+				Site.Axis = axis;
 				// Extract the rotation angle from the CallInst
-				double Angle = cast<ConstantFP>(I.getArgOperand(1))
+				Site.Angle = cast<ConstantFP>(I.getArgOperand(1))
 					->getValueAPF()
 					.convertToDouble();
+				Sites.push_back(Site);
+			} // visitCallInst()
+
+		}; // struct RotationVisitor
+
+		// Create a unique function name (for lookup later); Z rotations keep
+		// the names they always had
+		static std::string getFunctionName(const std::string &Axis, double Angle) {
+			std::string buf; raw_string_ostream ss(buf);
+			ss << "DecomposeRotation" << (Axis == "Z" ? "" : Axis) << "_" << Angle;
+			std::string FuncName = ss.str();
+			// Sanitize strings
+			for (std::string::iterator iter = FuncName.begin(); iter < FuncName.end(); iter++) {
+				switch (*iter) {
+					case '-': FuncName.replace(iter,iter+1,"n"); break;
+					case '+': FuncName.erase(iter); iter--; break;
+					case '.': FuncName.replace(iter,iter+1,"_"); break;
+					case '"': FuncName.erase(iter); iter--; break;
+				}
+			}
+			return FuncName;
+		}
+
+		static bool isGridsynth(const char *path, SqctLibrary *Lib) {
+			return !Lib && std::string(path).find("gridsynth") != std::string::npos;
+		}
+
+		// The precisions to decompose every angle with: sqct levels or
+		// gridsynth digits
+		static std::vector<unsigned> getPrecisions(const char *path, SqctLibrary *Lib) {
+			std::vector<unsigned> Precisions;
+			if (RotationErrorBudget <= 0.0)
+				Precisions.push_back(isGridsynth(path, Lib) ? 3 : (unsigned)SqctLevels);
+			else if (!RotationPrecisions.empty())
+				Precisions.assign(RotationPrecisions.begin(), RotationPrecisions.end());
+			else if (isGridsynth(path, Lib))
+				for (unsigned d = 2; d <= 10; d++) Precisions.push_back(d);
+			else
+				for (unsigned l = 0; l <= 3; l++) Precisions.push_back(l);
+			return Precisions;
+		}
+
+		// Build the rotation decomposition command for the tool in path (or
+		// the arguments for the sqct library, if Lib is set), and the
+		// RotationCache key of its result; false if the tool is unknown
+		static bool getCommand(const char *path, SqctLibrary *Lib, double Angle,
+		                       const std::string &axis, unsigned Precision,
+		                       DecompositionJob &Job) {
+			std::ostringstream ss2, angle;
+			std::string tool, precision = utostr(Precision), keyAxis = axis;
+          Job.Precision = Precision;
+          if (Lib) {
+            // rotZ sees the angle as printed on its command line
+            angle << Angle;
+            tool = "sqct";
+            Job.Axis = axis[0];
+            Job.ToolAngle = atof(angle.str().c_str());
+          }
+          else if (isGridsynth(path, Lib)) {
+            angle << std::fixed << Angle;
+            tool = "gridsynth";
+            // gridsynth only decomposes Rz; Rx and Ry are built from it
+            // (see fromZ)
+            keyAxis = "Z";
+    			  ss2 << path << " \"(" << angle.str() << ")\"" << " -d " << precision;
+          }
+          else if (std::string(path).find("sqct") != std::string::npos) {
+            angle << Angle;
+            tool = "sqct";
+            ss2 << path << " " << angle.str() << " " << axis << " " << precision;
+          }
+          else
+            return false;
+			Job.Command = ss2.str();
+			Job.Key = tool + "\t" + keyAxis + "\t" + precision + "\t" + angle.str();
+			return true;
+		}
+
+		// Populate DR with the gates of a decomposition
+		static void buildDecomposition(Module *M, Function *DR, const std::string &circuit) {
+			// Create a BasicBlock and insert it at the end of the Function
+			BasicBlock *BB = BasicBlock::Create(getGlobalContext(), "", DR, 0);
+			if (RotationSeq) {
+				// One packed sequence in application order (CliffordTSeq.h)
+				std::string Gates;
+				for (int i = circuit.length() - 1; i >= 0; i--)
+					if (strchr("TtPpHXYZ", circuit[i])) Gates += circuit[i];
+				IRBuilder<> Builder(BB);
+				if (!Gates.empty())
+					Builder.CreateCall2(Intrinsic::getDeclaration(M, Intrinsic::CliffordTSeq),
+						DR->arg_begin(), Builder.CreateGlobalStringPtr(Gates, "gates"));
+				Builder.CreateRetVoid();
+				return;
+			}
+			// For each gate in decomposition:
+			// (the decomposed string is given in the reverse order that ops must be applied)
+			for (int i=circuit.length()-1, e=0; i>=e; i--) {
+				Function *gate = NULL;
+				switch(circuit[i]) {
+					case 'T':
+						gate = Intrinsic::getDeclaration(M, Intrinsic::T);
+						break;
+					case 't':
+						gate = Intrinsic::getDeclaration(M, Intrinsic::Tdag);
+						break;
+					case 'P':
+						// TODO: P NOT YET SUPPORTED
+						gate = Intrinsic::getDeclaration(M, Intrinsic::S);
+						break;
+					case 'p':
+						// TODO: P NOT YET SUPPORTED
+						gate = Intrinsic::getDeclaration(M, Intrinsic::Sdag);
+						break;
+					case 'H':
+						gate = Intrinsic::getDeclaration(M, Intrinsic::H);
+						break;
+					case 'X':
+						gate = Intrinsic::getDeclaration(M, Intrinsic::X);
+						break;
+					case 'Y':
+						gate = Intrinsic::getDeclaration(M, Intrinsic::Y);
+						break;
+					case 'Z':
+						gate = Intrinsic::getDeclaration(M, Intrinsic::Z);
+						break;
+					default:
+						continue;
+				}
+				// Insert at end
+				CallInst::Create(gate, ArrayRef<Value*>(DR->arg_begin()), "", BB);
+			}
+			ReturnInst::Create(getGlobalContext(), 0, BB);
+		}
+
+		// Pick a precision for every rotation so that the error summed over
+		// all executions stays within -rotation-error-budget with as few T
+		// gates as possible: start from the cheapest precision of each and
+		// keep taking the upgrade that removes the most weighted error per T
+		// gate added. Prints the resulting table.
+		static void choosePrecisions(std::vector<PendingRotation> &Pending,
+		                             const std::vector<unsigned> &Precisions,
+		                             StringMap<std::string> &Decomposed) {
+			std::vector<std::vector<unsigned> > TCount(Pending.size());
+			std::vector<std::vector<double> > Error(Pending.size());
+			double Total = 0.0;
+			for (unsigned p = 0; p < Pending.size(); p++) {
+				PendingRotation &P = Pending[p];
+				for (unsigned t = 0; t < P.Keys.size(); t++) {
+					// Precisions the decomposer failed at are never chosen
+					StringMap<std::string>::iterator D = Decomposed.find(P.Keys[t]);
+					if (D == Decomposed.end()) {
+						TCount[p].push_back(~0U);
+						Error[p].push_back(HUGE_VAL);
+						continue;
+					}
+					std::string Gates = applyCanonical(P.Axis, P.Canonical,
+						P.FromZ ? fromZ(P.Axis, D->second) : D->second);
+					TCount[p].push_back(countT(Gates));
+					Error[p].push_back(rotdist::traceDistance(P.Axis[0], P.Angle, Gates));
+					if (TCount[p][t] < TCount[p][P.Chosen] ||
+					    (TCount[p][t] == TCount[p][P.Chosen] &&
+					     Error[p][t] < Error[p][P.Chosen]))
+						P.Chosen = t;
+				}
+				Total += P.Executions * Error[p][P.Chosen];
+			}
+
+			std::priority_queue<Upgrade> Upgrades;
+			for (unsigned p = 0; p < Pending.size(); p++)
+				pushUpgrade(Pending, TCount, Error, p, Upgrades);
+			while (Total > RotationErrorBudget && !Upgrades.empty()) {
+				Upgrade U = Upgrades.top();
+				Upgrades.pop();
+				PendingRotation &P = Pending[U.Rotation];
+				if (P.Chosen != U.From) continue;
+				Total -= P.Executions * (Error[U.Rotation][U.From] - Error[U.Rotation][U.To]);
+				P.Chosen = U.To;
+				pushUpgrade(Pending, TCount, Error, U.Rotation, Upgrades);
+			}
+			if (Total > RotationErrorBudget)
+				errs() << "Rotation error budget " << (double)RotationErrorBudget
+				       << " cannot be met at the available precisions\n";
+
+			errs() << "Function\tExecutions\tPrecision\tT-count\tError\n";
+			unsigned TotalT = 0;
+			for (unsigned p = 0; p < Pending.size(); p++) {
+				const PendingRotation &P = Pending[p];
+				errs() << P.Name << "\t" << P.Executions << "\t"
+				       << Precisions[P.Chosen] << "\t" << TCount[p][P.Chosen] << "\t"
+				       << Error[p][P.Chosen] << "\n";
+				TotalT += TCount[p][P.Chosen];
+			}
+			errs() << "Total\t\t\t" << TotalT << "\t" << Total << "\n";
+		}
+
+		// Queue the best upgrade of rotation p from its chosen precision
+		static void pushUpgrade(const std::vector<PendingRotation> &Pending,
+		                        const std::vector<std::vector<unsigned> > &TCount,
+		                        const std::vector<std::vector<double> > &Error,
+		                        unsigned p, std::priority_queue<Upgrade> &Upgrades) {
+			const PendingRotation &P = Pending[p];
+			if (P.Executions <= 0.0) return;
+			unsigned From = P.Chosen;
+			Upgrade Best;
+			Best.Gain = 0.0;
+			for (unsigned t = 0; t < TCount[p].size(); t++) {
+				double Removed = P.Executions * (Error[p][From] - Error[p][t]);
+				if (Removed <= 0.0) continue;
+				double Added = (double)TCount[p][t] - (double)TCount[p][From];
+				double Gain = Added > 0.0 ? Removed / Added : HUGE_VAL;
+				if (Gain > Best.Gain) {
+					Best.Gain = Gain;
+					Best.To = t;
+				}
+			}
+			if (Best.Gain == 0.0) return;
+			Best.Rotation = p;
+			Best.From = From;
+			Upgrades.push(Best);
+		}
+
+		virtual bool runOnModule(Module &M) {
+			// Collect every rotation first
+			std::vector<RotationSite> Sites;
+			RotationVisitor RV(Sites);
+			RV.visit(M);
+			if (Sites.empty()) return false;
+
+			SqctLibrary *Lib = SqctLibrary::get();
+			char *path = getenv("ROTATIONPATH");
+			if (!Lib && !path) {
+				errs() << "Rotation decomposer not found!\n";
+				return false;
+			}
+
+			// How often each rotation runs, for -rotation-error-budget
+			StringMap<double> Freq;
+			bool HaveFreq = RotationErrorBudget > 0.0 && !RotationFreqFile.empty();
+			if (HaveFreq && !readFrequencies(RotationFreqFile, Freq)) {
+				errs() << "Cannot read frequency profile " << RotationFreqFile << "\n";
+				HaveFreq = false;
+			}
+
+			// Decompose each representative angle (see canonicalize) that is
+			// neither in the module nor in the cache once per precision, all of
+			// them in parallel
+			std::vector<unsigned> Precisions = getPrecisions(path, Lib);
+			RotationCache Cache;
+			Cache.open(RotationCacheFile);
+			StringMap<std::string> Circuits;    // function name -> decomposition
+			StringMap<std::string> Decomposed;  // RotationCache key -> decomposition
+			StringMap<unsigned> JobOf;          // RotationCache key -> index in Jobs
+			StringMap<unsigned> PendingOf;      // function name -> index in Pending
+			std::vector<DecompositionJob> Jobs;
+			std::vector<PendingRotation> Pending;
+			for (unsigned i = 0; i < Sites.size(); i++) {
+				if (Sites[i].Angle == 0.0) continue;
+				const std::string &Axis = Sites[i].Axis;
+				std::string FuncName = getFunctionName(Axis, Sites[i].Angle);
+				// Functions missing from the profile are counted once
+				double Executions = 1.0;
+				if (HaveFreq) {
+					StringMap<double>::iterator F =
+						Freq.find(Sites[i].Call->getParent()->getParent()->getName());
+					if (F != Freq.end()) Executions = F->second;
+				}
+				if (PendingOf.count(FuncName)) {
+					Pending[PendingOf[FuncName]].Executions += Executions;
+					continue;
+				}
+				if (M.getFunction(FuncName) || Circuits.count(FuncName)) continue;
+				CanonicalAngle C = canonicalize(Axis, Sites[i].Angle);
+				if (C.Angle == 0.0) {
+					++NumExact;
+					Circuits[FuncName] = applyCanonical(Axis, C, "");
+					continue;
+				}
+				PendingRotation P;
+				P.Name = FuncName;
+				P.Axis = Axis;
+				P.Angle = Sites[i].Angle;
+				P.Canonical = C;
+				P.FromZ = isGridsynth(path, Lib) && Axis != "Z";
+				P.Executions = Executions;
+				P.Chosen = 0;
+				for (unsigned t = 0; t < Precisions.size(); t++) {
+					DecompositionJob Job;
+					Job.Axis = 0;
+					Job.ToolAngle = 0.0;
+					if (!getCommand(path, Lib, C.Angle, Axis, Precisions[t], Job)) {
+						errs() << "Invalid rotation decomposer!\n";
+						return false;
+					}
+					P.Keys.push_back(Job.Key);
+					if (Decomposed.count(Job.Key) || JobOf.count(Job.Key)) {
+						if (t == 0) ++NumShared;
+						continue;
+					}
+					if (Cache.lookup(Job.Key, Decomposed[Job.Key])) {
+						++NumCacheHits;
+						continue;
+					}
+					Decomposed.erase(Job.Key);
+					Job.Name = FuncName;
+					Job.Ok = false;
+					if (!Lib)
+						errs() << "Calling '" << Job.Command << "'\n";
+					JobOf[Job.Key] = Jobs.size();
+					Jobs.push_back(Job);
+				}
+				Circuits[FuncName] = "";
+				PendingOf[FuncName] = Pending.size();
+				Pending.push_back(P);
+			}
+			if (Lib && !Jobs.empty())
+				errs() << "Decomposing " << Jobs.size() << " rotations in process\n";
+			NumDecomposed += Jobs.size();
+			runJobsInParallel(Jobs, Lib, RotationThreads);
+			for (unsigned i = 0; i < Jobs.size(); i++) {
+				const DecompositionJob &Job = Jobs[i];
+				if (!Job.Ok) {
+					const PendingRotation &P = Pending[PendingOf[Job.Name]];
+					errs() << "Rotation decomposer failed for R" << StringRef(P.Axis).lower() << "("
+					       << P.Angle << ") at precision " << Job.Precision << "\n";
+					continue;
+				}
+				Decomposed[Job.Key] = Job.Circuit;
+				std::string gates;
+				for (unsigned c = 0; c < Job.Circuit.size(); c++)
+					if (strchr("TtPpHXYZ", Job.Circuit[c])) gates += Job.Circuit[c];
+				Cache.insert(Job.Key, gates);
+			}
+			// Rotations that could not be decomposed at any precision keep
+			// their Rx/Ry/Rz call; the others start from a precision that did
+			// decompose
+			std::vector<PendingRotation> Decomposable;
+			for (unsigned p = 0; p < Pending.size(); p++) {
+				PendingRotation &P = Pending[p];
+				while (P.Chosen < P.Keys.size() && !Decomposed.count(P.Keys[P.Chosen]))
+					P.Chosen++;
+				if (P.Chosen == P.Keys.size()) {
+					errs() << "Cannot decompose R" << StringRef(P.Axis).lower() << "(" << P.Angle
+					       << "); leaving it undecomposed\n";
+					Circuits.erase(P.Name);
+					continue;
+				}
+				Decomposable.push_back(P);
+			}
+			Pending.swap(Decomposable);
+			if (RotationErrorBudget > 0.0)
+				choosePrecisions(Pending, Precisions, Decomposed);
+			for (unsigned p = 0; p < Pending.size(); p++) {
+				const PendingRotation &P = Pending[p];
+				const std::string &Circuit = Decomposed[P.Keys[P.Chosen]];
+				Circuits[P.Name] = applyCanonical(P.Axis, P.Canonical,
+				                                  P.FromZ ? fromZ(P.Axis, Circuit) : Circuit);
+			}
+
+			// Create a FunctionType object with 'void' return type and one 'qbit'
+			// parameter
+			FunctionType *FuncType = FunctionType::get(
+				Type::getVoidTy(getGlobalContext()),
+				ArrayRef<Type*>(Type::getInt16Ty(getGlobalContext())),
+				false);
+
+			// Rewrite the rotations in program order
+			for (unsigned i = 0; i < Sites.size(); i++) {
+				CallInst &I = *Sites[i].Call;
+				double Angle = Sites[i].Angle;
+				Value *Target = I.getArgOperand(0);
 				// If the angle is 0, delete the rotation
 				if ( Angle == 0.0 || Angle == -0.0 ) {
 					errs() << "Rotation angle is " << Angle << " for " << Target->getName() << "\n";
 					I.eraseFromParent();
-					return;
-				}
-				// Create a unique function name (for lookup later)
-				std::string buf; raw_string_ostream ss(buf);
-				ss << "DecomposeRotation_" << Angle;
-				std::string FuncName = ss.str();
-				// Sanitize strings
-				for (std::string::iterator iter = FuncName.begin(); iter < FuncName.end(); iter++) {
-					switch (*iter) {
-						case '-': FuncName.replace(iter,iter+1,"n"); break;
-						case '+': FuncName.erase(iter); iter--; break;
-						case '.': FuncName.replace(iter,iter+1,"_"); break;
-						case '"': FuncName.erase(iter); iter--; break;
-					}
+					continue;
 				}
-				// Create a FunctionType object with 'void' return type and one 'qbit'
-				// parameter
-				FunctionType *FuncType = FunctionType::get(
-					Type::getVoidTy(getGlobalContext()),
-					ArrayRef<Type*>(Type::getInt16Ty(getGlobalContext())),
-					false);
 				// Lookup the Function in the module
-				Function *DR = M->getFunction(FuncName);
-				// If it does not exist perform a decomposition
+				std::string FuncName = getFunctionName(Sites[i].Axis, Angle);
+				Function *DR = M.getFunction(FuncName);
+				// If it does not exist create it from its decomposition
 				if (!DR) {
-					// Create the new function
+					if (!Circuits.count(FuncName)) continue;
 					DR = Function::Create(FuncType, GlobalVariable::ExternalLinkage,
-						FuncName, M);
+						FuncName, &M);
 
 					Function::arg_iterator args = DR->arg_begin(); //set name of variable
 					Value* qArg = args;
 					qArg->setName("q");
 
-					// Create a BasicBlock and insert it at the end of the Function
-					BasicBlock *BB = BasicBlock::Create(getGlobalContext(), "", DR, 0);
-					// Populate the BasicBlock
-					// Build rotation decomposition command
-					std::string buf; std::ostringstream ss2;
-					char *path = getenv("ROTATIONPATH");
-					if (!path) {
-						errs() << "Rotation decomposer not found!\n";
-						return;
-					}
-          if (std::string(path).find("gridsynth") != std::string::npos) {
-    			  ss2 << path << " \"(" << std::fixed << Angle << ")\"" << " -d 3";          
-          }
-          else if (std::string(path).find("sqct") != std::string::npos) {
-            ss2 << path << " " << Angle << axis << SqctLevels;
-          }
-          else {
-            errs() << "Invalid rotation decomposer!\n";
-            return;
-          }
-          
-          buf = ss2.str();
-          raw_string_ostream ss3(buf);          
-					errs() << "Calling '" << ss3.str() << "'\n";
-					// Capture result
-					std::string circuit = exec(ss3.str().c_str());
-
-					// For each gate in decomposition:
-          // (the decomposed string is given in the reverse order that ops must be applied)
-					for (int i=circuit.length()-1, e=0; i>=e; i--) {
-						Function *gate = NULL;
-						switch(circuit[i]) {
-							case 'T':
-								gate = Intrinsic::getDeclaration(M, Intrinsic::T);
-								break;
-							case 't':
-								gate = Intrinsic::getDeclaration(M, Intrinsic::Tdag);
-								break;
-							case 'P':
-								// TODO: P NOT YET SUPPORTED
-								gate = Intrinsic::getDeclaration(M, Intrinsic::S);
-								break;
-							case 'p':
-								// TODO: P NOT YET SUPPORTED
-								gate = Intrinsic::getDeclaration(M, Intrinsic::Sdag);
-								break;
-							case 'H':
-								gate = Intrinsic::getDeclaration(M, Intrinsic::H);
-								break;
-							case 'X':
-								gate = Intrinsic::getDeclaration(M, Intrinsic::X);
-								break;
-							case 'Y':
-								gate = Intrinsic::getDeclaration(M, Intrinsic::Y);
-								break;
-							case 'Z':
-								gate = Intrinsic::getDeclaration(M, Intrinsic::Z);
-								break;
-							default:
-								continue;
-						}
-						CallInst *newCallInst;
-						newCallInst = CallInst::Create(gate, ArrayRef<Value*>(DR->arg_begin()),
-								// Insert at front
-								// "", BB->front());
-								// Insert at end
-								"", BB);
-						//newCallInst->setTailCall();
-					}
-					ReturnInst::Create(getGlobalContext(), 0, BB);
+					buildDecomposition(&M, DR, Circuits[FuncName]);
 				} // endif 'decomposition not found'
 				// Replace the old Rz call with the new call to Decomposed_Rotation
 				BasicBlock::iterator ii(&I);
 				ReplaceInstWithInst(I.getParent()->getInstList(), ii,
 					CallInst::Create(DR, ArrayRef<Value*>(Target)));
-				// } // endif 'found Rz'
-			} // visitCallInst()
-
-		}; // struct RotationVisitor
-
-		virtual bool runOnModule(Module &M) {
-			RotationVisitor RV(&M);
-			RV.visit(M);
+			}
 
 			return true;
 		} // runOnModule()
@@ -222,4 +885,3 @@ namespace {
 
 char Rotations::ID = 0;
 static RegisterPass<Rotations> X("Rotations", "Rotation Decomposition", false, false);
-
@@ -0,0 +1,184 @@
+//===----------------------- UnrollCloneFixpoint.cpp ---------------------===//
+// This file implements the Scaffold pass that fully flattens a module by
+// repeating loop unrolling, function cloning and dead argument elimination
+// until the module stops changing.
+//
+// Convergence is detected with a structural hash of the module computed in
+// memory, instead of printing every round to a .ll file and diffing it.
+//
+//        This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "UnrollCloneFixpoint"
+#include "llvm/Pass.h"
+#include "llvm/PassManager.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/Instruction.h"
+#include "llvm/Instructions.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Scalar.h"
+
+using namespace llvm;
+
+STATISTIC(NumFixpointIterations, "Number of unroll/clone iterations");
+
+static cl::opt<unsigned>
+FixpointUnrollThreshold("fixpoint-unroll-threshold", cl::init(100000000),
+  cl::Hidden, cl::desc("Loop unroll threshold used while flattening loops"));
+
+static cl::opt<unsigned>
+FixpointMaxIterations("fixpoint-max-iterations", cl::init(0), cl::Hidden,
+  cl::desc("Stop the unroll/clone fixpoint after N rounds (0 = no limit)"));
+
+// An anonymous namespace for the pass. Things declared inside it are
+// only visible to the current file.
+namespace {
+
+  struct UnrollCloneFixpoint : public ModulePass {
+    static char ID; // Pass identification
+    UnrollCloneFixpoint() : ModulePass(ID) {}
+
+    // hash a value used as an operand: constants by value, everything
+    // else by its position in the function (or by name for globals)
+    hash_code hashOperand(const Value *V,
+                          const DenseMap<const Value*, unsigned> &Numbering) const {
+      if (const ConstantInt *CI = dyn_cast<ConstantInt>(V))
+        return hash_combine(1, hash_value(CI->getValue()));
+      if (const ConstantFP *CF = dyn_cast<ConstantFP>(V))
+        return hash_combine(2, hash_value(CF->getValueAPF()));
+      if (const GlobalValue *GV = dyn_cast<GlobalValue>(V))
+        return hash_combine(3, hash_value(GV->getName()));
+      DenseMap<const Value*, unsigned>::const_iterator I = Numbering.find(V);
+      if (I != Numbering.end())
+        return hash_combine(4, I->second);
+      // other constants (null, undef, constant expressions, ...)
+      return hash_combine(5, V->getValueID(), V->getType()->getTypeID());
+    }
+
+    // structural hash of a function body
+    hash_code hashFunction(const Function &F) const {
+      DenseMap<const Value*, unsigned> Numbering;
+      unsigned N = 0;
+      for (Function::const_arg_iterator A = F.arg_begin(), E = F.arg_end(); A != E; ++A)
+        Numbering[A] = N++;
+      for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+        Numbering[BB] = N++;
+        for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+          Numbering[I] = N++;
+      }
+
+      hash_code H = hash_combine(hash_value(F.getName()), F.arg_size(), N);
+      for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+        for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+          // types and attribute lists are uniqued, so their addresses
+          // identify them within one run
+          H = hash_combine(H, I->getOpcode(), I->getNumOperands(), I->getType());
+          if (const CmpInst *CI = dyn_cast<CmpInst>(I))
+            H = hash_combine(H, CI->getPredicate());
+          if (const CallInst *CI = dyn_cast<CallInst>(I)) {
+            H = hash_combine(H, CI->getAttributes().getRawPointer());
+            if (const Function *Callee = CI->getCalledFunction())
+              H = hash_combine(H, Callee, Callee->getAttributes().getRawPointer());
+          }
+          for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+            H = hash_combine(H, hashOperand(I->getOperand(i), Numbering));
+        }
+      return H;
+    }
+
+    // structural hash of the whole module; two modules with the same hash
+    // are considered identical for the purpose of detecting the fixpoint
+    hash_code hashModule(const Module &M) const {
+      hash_code H = hash_value(M.size());
+      for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F) {
+        if (F->isDeclaration())
+          H = hash_combine(H, hash_value(F->getName()));
+        else
+          H = hash_combine(H, hashFunction(*F));
+      }
+      return H;
+    }
+
+    void addTargetInfo(PassManager &PM, Module &M) const {
+      PM.add(new TargetLibraryInfo(Triple(M.getTargetTriple())));
+      if (!M.getDataLayout().empty())
+        PM.add(new TargetData(M.getDataLayout()));
+    }
+
+    virtual bool runOnModule (Module &M) {
+      // FunctionClone lives in this library; look it up like opt would
+      const PassInfo *CloneInfo =
+        PassRegistry::getPassRegistry()->getPassInfo(StringRef("FunctionClone"));
+      if (!CloneInfo) {
+        errs() << "UnrollCloneFixpoint: FunctionClone pass not registered\n";
+        return false;
+      }
+
+      hash_code Previous = hashModule(M);
+      unsigned Iterations = 0;
+      bool Converged = false;
+
+      while (!Converged) {
+        ++Iterations;
+        ++NumFixpointIterations;
+        errs() << "[UnrollCloneFixpoint] Unrolling Loops, Cloning Functions ("
+               << Iterations << ") ...\n";
+
+        // -mem2reg -loops -loop-simplify -loop-rotate -lcssa -loop-unroll -sccp -simplifycfg
+        PassManager Unroll;
+        addTargetInfo(Unroll, M);
+        Unroll.add(createPromoteMemoryToRegisterPass());
+        Unroll.add(createLoopSimplifyPass());
+        Unroll.add(createLoopRotatePass());
+        Unroll.add(createLCSSAPass());
+        Unroll.add(createLoopUnrollPass(FixpointUnrollThreshold));
+        Unroll.add(createSCCPPass());
+        Unroll.add(createCFGSimplificationPass());
+        Unroll.run(M);
+
+        // -FunctionClone -sccp
+        PassManager Clone;
+        addTargetInfo(Clone, M);
+        Clone.add(CloneInfo->createPass());
+        Clone.add(createSCCPPass());
+        Clone.run(M);
+
+        // -deadargelim
+        PassManager DAE;
+        DAE.add(createDeadArgEliminationPass());
+        DAE.run(M);
+
+        hash_code Current = hashModule(M);
+        Converged = (Current == Previous);
+        Previous = Current;
+
+        if (!Converged && FixpointMaxIterations && Iterations >= FixpointMaxIterations) {
+          errs() << "[UnrollCloneFixpoint] Giving up after " << Iterations
+                 << " iterations without reaching a fixpoint\n";
+          break;
+        }
+      }
+
+      if (Converged)
+        errs() << "[UnrollCloneFixpoint] Fixpoint reached after " << Iterations
+               << " iterations\n";
+      return true;
+    } // End runOnModule
+  }; // End of struct UnrollCloneFixpoint
+} // End of anonymous namespace
+
+char UnrollCloneFixpoint::ID = 0;
+static RegisterPass<UnrollCloneFixpoint> X("scaffold-unroll-clone-fixpoint",
+  "Unroll loops and clone functions until the module stops changing", false, false);
@@ -0,0 +1,65 @@
+; RUN: opt -load %llvmshlibdir/Scaffold%shlibext -gen-flat-qasm %s -o /dev/null 2>&1 | FileCheck %s
+; REQUIRES: loadable_module
+
+; Arrays of the same name in different functions share qubit names, but an
+; array declared larger than before must not run into the names of other
+; arrays: f2's anc[2] and anc[3] are new qubits, not x0a or f1's anc.
+
+; CHECK: qubit anc0a
+; CHECK-NEXT: qubit anc1a
+; CHECK-NEXT: qubit x0a
+; CHECK-NEXT: qubit anc2a
+; CHECK-NEXT: qubit anc3a
+; CHECK-NEXT: qubit q0
+; CHECK-NEXT: H anc1a
+; CHECK-NEXT: H anc2a
+; CHECK-NEXT: H anc3a
+; CHECK-NEXT: CNOT x0a,anc0a
+; CHECK-NEXT: CNOT anc3a,x0a
+
+declare void @llvm.H(i16)
+declare void @llvm.CNOT(i16, i16)
+
+define void @f1() {
+entry:
+  %anc = alloca [2 x i16]
+  %p = getelementptr inbounds [2 x i16]* %anc, i32 0, i32 1
+  %q = load i16* %p
+  call void @llvm.H(i16 %q)
+  ret void
+}
+
+define void @g(i16* %a) {
+entry:
+  %p = getelementptr inbounds i16* %a, i32 3
+  %q = load i16* %p
+  call void @llvm.H(i16 %q)
+  ret void
+}
+
+define void @f2() {
+entry:
+  %x = alloca [1 x i16]
+  %anc = alloca [4 x i16]
+  %p2 = getelementptr inbounds [4 x i16]* %anc, i32 0, i32 2
+  %q2 = load i16* %p2
+  call void @llvm.H(i16 %q2)
+  %a = getelementptr inbounds [4 x i16]* %anc, i32 0, i32 0
+  call void @g(i16* %a)
+  %px = getelementptr inbounds [1 x i16]* %x, i32 0, i32 0
+  %qx = load i16* %px
+  %q0 = load i16* %a
+  call void @llvm.CNOT(i16 %qx, i16 %q0)
+  %p3 = getelementptr inbounds [4 x i16]* %anc, i32 0, i32 3
+  %q3 = load i16* %p3
+  call void @llvm.CNOT(i16 %q3, i16 %qx)
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %q = alloca [1 x i16]
+  call void @f1()
+  call void @f2()
+  ret i32 0
+}
@@ -0,0 +1,38 @@
+; RUN: opt -load %llvmshlibdir/Scaffold%shlibext -ResourceCountSymbolic %s -o /dev/null 2>&1 | FileCheck %s
+; RUN: opt -load %llvmshlibdir/Scaffold%shlibext -ResourceCountSymbolic -symbolic-unroll-fallback=false %s -o /dev/null 2>&1 | FileCheck %s -check-prefix=NOUNROLL
+; REQUIRES: loadable_module
+
+; The H only runs on the first of four iterations. The branch is not
+; evaluated, so the block is counted once and reported rather than
+; multiplied by the trip count; the fallback unrolls the loop and folds it.
+
+; CHECK: Function: main
+; CHECK-NEXT: {{^}}	0	0	0	1	4
+; CHECK-NOT: Blocks counted once
+
+; NOUNROLL: Function: main
+; NOUNROLL-NEXT: {{^}}	0	0	0	1	4
+; NOUNROLL: Blocks counted once, behind a branch inside a loop:
+; NOUNROLL-NEXT: {{^}}	main: first{{$}}
+
+declare void @llvm.H(i16)
+declare void @llvm.T(i16)
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%inc, %latch]
+  call void @llvm.T(i16 0)
+  %is0 = icmp eq i32 %i, 0
+  br i1 %is0, label %first, label %latch
+first:
+  call void @llvm.H(i16 0)
+  br label %latch
+latch:
+  %inc = add i32 %i, 1
+  %c = icmp slt i32 %inc, 4
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 0
+}
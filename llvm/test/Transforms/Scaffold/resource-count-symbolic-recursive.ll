@@ -0,0 +1,43 @@
+; RUN: opt -load %llvmshlibdir/Scaffold%shlibext -ResourceCountSymbolic %s -o /dev/null 2>&1 | FileCheck %s
+; REQUIRES: loadable_module
+
+; f calls itself with a smaller trip count. The inner call contributes
+; nothing whatever its arguments are, as in -ResourceCount, instead of
+; starting a new context for every level of the recursion.
+
+; CHECK: Function: f(?, 3)
+; CHECK-NEXT: {{^}}	0	0	0	3	0
+; CHECK-NEXT: Function: main
+; CHECK-NEXT: {{^}}	0	0	0	3	0
+; CHECK: total_gates = 3
+; CHECK: Recursive calls counted as empty:
+; CHECK-NEXT: {{^}}	f{{$}}
+
+declare void @llvm.H(i16)
+
+define void @f(i16 %q, i32 %n) {
+entry:
+  %cmp0 = icmp sgt i32 %n, 0
+  br i1 %cmp0, label %loop, label %tail
+loop:
+  %i = phi i32 [0, %entry], [%inc, %loop]
+  call void @llvm.H(i16 %q)
+  %inc = add i32 %i, 1
+  %c = icmp slt i32 %inc, %n
+  br i1 %c, label %loop, label %tail
+tail:
+  %more = icmp sgt i32 %n, 1
+  br i1 %more, label %recurse, label %exit
+recurse:
+  %m = sub i32 %n, 1
+  call void @f(i16 %q, i32 %m)
+  br label %exit
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @f(i16 0, i32 3)
+  ret i32 0
+}
@@ -0,0 +1,309 @@
+//===- scaffold-opt.cpp - In-process Scaffold compile pipeline ------------===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+//        This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// scaffold-opt loads the Scaffold pass library once and runs the whole chain
+// that scaffold/Scaffold.makefile otherwise spreads over a dozen 'opt -S'
+// invocations: XformCbitStores, the O1 passes, the unroll/FunctionClone/
+// deadargelim fixpoint, Rotations, ToffoliReplace and finally ResourceCount,
+// gen-qasm or gen-flat-qasm. The module stays in memory between stages;
+// intermediate IR is only written out when -save-temps is given.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Assembly/PrintModulePass.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/IRReader.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PluginLoader.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/LinkAllPasses.h"
+#include "llvm/LinkAllVMCore.h"
+#include <cctype>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace llvm;
+
+static cl::opt<std::string>
+InputFilename(cl::Positional, cl::desc("<input bitcode file>"),
+    cl::init("-"), cl::value_desc("filename"));
+
+static cl::opt<std::string>
+OutputFilename("o", cl::desc("Output filename (default: stdout)"),
+               cl::value_desc("filename"), cl::init("-"));
+
+enum EmitKind { EmitResources, EmitQASM, EmitFlat, EmitIR };
+
+static cl::opt<EmitKind>
+Emit("emit", cl::desc("Final product of the pipeline"),
+     cl::init(EmitResources),
+     cl::values(
+       clEnumValN(EmitResources, "resources", "Resource count (-ResourceCount)"),
+       clEnumValN(EmitQASM, "qasm", "Hierarchical QASM (-gen-qasm)"),
+       clEnumValN(EmitFlat, "flat", "Flattened QASM (-gen-flat-qasm)"),
+       clEnumValN(EmitIR, "ir", "Optimized IR (the $(FILE)11.ll equivalent)"),
+       clEnumValEnd));
+
+static cl::opt<bool>
+OutputAssembly("S", cl::desc("Write IR output as LLVM assembly"));
+
+static cl::opt<bool>
+DoRotations("rotations", cl::desc("Run rotation decomposition (-Rotations)"));
+
+static cl::opt<bool>
+DoToffoli("toffoli", cl::desc("Run Toffoli decomposition (-ToffoliReplace)"));
+
+static cl::opt<std::string>
+SaveTemps("save-temps", cl::value_desc("prefix"),
+  cl::desc("Write the IR after each stage to <prefix>N.ll, using the same "
+           "stage numbers as Scaffold.makefile"));
+
+static cl::opt<bool>
+Quiet("q", cl::desc("Do not print stage banners"));
+
+// Pass lists of every stage, spelled the way Scaffold.makefile spells them.
+// Each string is run by its own PassManager, just as each line of the
+// makefile was run by its own opt process.
+static const char *CbitStages[] = {
+  "xform-cbit-stores",
+  0
+};
+
+static const char *O1Stages[] = {
+  "no-aa tbaa targetlibinfo basicaa",
+  "simplifycfg domtree",
+  "early-cse lower-expect",
+  "targetlibinfo no-aa tbaa basicaa globalopt ipsccp",
+  "instcombine simplifycfg basiccg prune-eh always-inline functionattrs "
+  "domtree early-cse lazy-value-info jump-threading correlated-propagation "
+  "simplifycfg instcombine tailcallelim simplifycfg reassociate domtree loops "
+  "loop-simplify lcssa loop-rotate licm lcssa loop-unswitch instcombine "
+  "scalar-evolution loop-simplify lcssa iv-users indvars loop-idiom "
+  "loop-deletion loop-unroll memdep memcpyopt sccp instcombine "
+  "lazy-value-info jump-threading correlated-propagation domtree memdep dse "
+  "adce simplifycfg instcombine strip-dead-prototypes preverify domtree "
+  "verify",
+  0
+};
+
+// The unroll/clone/deadargelim loop is iterated inside the pass library;
+// see -fixpoint-unroll-threshold and -fixpoint-max-iterations.
+static const char *FlattenStages[] = {
+  "scaffold-unroll-clone-fixpoint",
+  "internalize globaldce adce",
+  0
+};
+
+static const char *RotationStages[] = {
+  "Rotations",
+  0
+};
+
+static const char *DeadCodeStages[] = {
+  "internalize globaldce deadargelim",
+  0
+};
+
+static const char *ToffoliStages[] = {
+  "ToffoliReplace",
+  0
+};
+
+static const char *ProgName;
+
+static void banner(const char *Msg) {
+  // Banners go to stderr so that they do not end up in IR written to stdout
+  if (!Quiet)
+    errs() << "[scaffold-opt] " << Msg << " ...\n";
+}
+
+/// addPassByName - Look up a pass by its command line name and add it to PM.
+static bool addPassByName(PassManager &PM, StringRef Name) {
+  const PassInfo *PI = PassRegistry::getPassRegistry()->getPassInfo(Name);
+  if (!PI || !PI->getNormalCtor()) {
+    errs() << ProgName << ": unknown pass '" << Name << "'";
+    if (PI == 0 && isupper(Name[0]))
+      errs() << " (was the Scaffold library given with -load?)";
+    errs() << "\n";
+    return false;
+  }
+  PM.add(PI->getNormalCtor()());
+  return true;
+}
+
+/// runPassList - Run one space separated pass list on M in a fresh
+/// PassManager. Returns false if a pass could not be created.
+static bool runPassList(Module &M, StringRef List) {
+  PassManager PM;
+  PM.add(new TargetLibraryInfo(Triple(M.getTargetTriple())));
+  if (!M.getDataLayout().empty())
+    PM.add(new TargetData(M.getDataLayout()));
+
+  SmallVector<StringRef, 64> Names;
+  List.split(Names, " ", -1, false);
+  for (unsigned i = 0, e = Names.size(); i != e; ++i)
+    if (!addPassByName(PM, Names[i]))
+      return false;
+
+  PM.run(M);
+  return true;
+}
+
+static bool runStage(Module &M, const char **Lists) {
+  for (; *Lists; ++Lists)
+    if (!runPassList(M, *Lists))
+      return false;
+  return true;
+}
+
+/// writeModule - Write M to Filename as bitcode, or as assembly if requested.
+static bool writeModule(Module &M, const std::string &Filename, bool Assembly) {
+  std::string ErrorInfo;
+  tool_output_file Out(Filename.c_str(), ErrorInfo, raw_fd_ostream::F_Binary);
+  if (!ErrorInfo.empty()) {
+    errs() << ProgName << ": " << ErrorInfo << "\n";
+    return false;
+  }
+  if (Assembly)
+    M.print(Out.os(), 0);
+  else
+    WriteBitcodeToFile(&M, Out.os());
+  Out.keep();
+  return true;
+}
+
+/// saveTemp - Dump the current module as <prefix><Stage>.ll if -save-temps.
+static bool saveTemp(Module &M, const char *Stage) {
+  if (SaveTemps.empty())
+    return true;
+  return writeModule(M, SaveTemps + Stage + ".ll", true);
+}
+
+/// runAnalysis - Run the final analysis pass. ResourceCount and the QASM
+/// generators print their results on stderr, so stderr is pointed at the
+/// output file while they run; messages from earlier stages stay on the
+/// terminal.
+static bool runAnalysis(Module &M, const char *PassName) {
+  int SavedStderr = -1;
+  if (OutputFilename != "-") {
+    int FD = open(OutputFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (FD < 0) {
+      errs() << ProgName << ": cannot open '" << OutputFilename << "'\n";
+      return false;
+    }
+    errs().flush();
+    SavedStderr = dup(2);
+    dup2(FD, 2);
+    close(FD);
+  }
+
+  bool Ok = runPassList(M, PassName);
+
+  if (SavedStderr >= 0) {
+    errs().flush();
+    dup2(SavedStderr, 2);
+    close(SavedStderr);
+  }
+  return Ok;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  ProgName = argv[0];
+
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+  LLVMContext &Context = getGlobalContext();
+
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeScalarOpts(Registry);
+  initializeIPO(Registry);
+  initializeAnalysis(Registry);
+  initializeIPA(Registry);
+  initializeTransformUtils(Registry);
+  initializeInstCombine(Registry);
+  initializeTarget(Registry);
+
+  cl::ParseCommandLineOptions(argc, argv,
+    "Scaffold in-process compile pipeline\n");
+
+  SMDiagnostic Err;
+  OwningPtr<Module> M(ParseIRFile(InputFilename, Err, Context));
+  if (!M) {
+    Err.print(ProgName, errs());
+    return 1;
+  }
+
+  banner("Transforming cbits");
+  if (!runStage(*M, CbitStages) || !saveTemp(*M, "1"))
+    return 1;
+
+  banner("O1 optimizations");
+  if (!runStage(*M, O1Stages) || !saveTemp(*M, "4"))
+    return 1;
+
+  banner("Unrolling Loops and Cloning Functions");
+  if (!runStage(*M, FlattenStages) || !saveTemp(*M, "6"))
+    return 1;
+
+  if (DoRotations) {
+    banner("Decomposing Rotations");
+    if (!runStage(*M, RotationStages))
+      return 1;
+  }
+  if (!saveTemp(*M, "7"))
+    return 1;
+
+  banner("Internalizing and Removing Unused Functions");
+  if (!runStage(*M, DeadCodeStages) || !saveTemp(*M, "10"))
+    return 1;
+
+  if (DoToffoli) {
+    banner("Toffoli Decomposition");
+    if (!runStage(*M, ToffoliStages))
+      return 1;
+  }
+  if (!saveTemp(*M, "11"))
+    return 1;
+
+  if (verifyModule(*M, PrintMessageAction)) {
+    errs() << ProgName << ": optimized module is broken\n";
+    return 1;
+  }
+
+  switch (Emit) {
+  case EmitResources:
+    banner("Generating resource count");
+    return runAnalysis(*M, "ResourceCount") ? 0 : 1;
+  case EmitQASM:
+    banner("Generating hierarchical QASM");
+    return runAnalysis(*M, "gen-qasm") ? 0 : 1;
+  case EmitFlat:
+    banner("Generating flattened QASM");
+    return runAnalysis(*M, "gen-flat-qasm") ? 0 : 1;
+  case EmitIR:
+    return writeModule(*M, OutputFilename, OutputAssembly) ? 0 : 1;
+  }
+  return 0;
+}
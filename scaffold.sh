@@ -9,11 +9,17 @@ if [ $(echo $PATH | grep ${CTQG_PATH} | wc -l) -eq 0 ]; then
 fi
 
 function show_help {
-    echo "Usage: $0 [-h] [-rqfRFcpd] [-L #] <filename>.scaffold"
+    echo "Usage: $0 [-h] [-rqfQRseFcpdibCt] [-L #] [-j #] <filename>.scaffold ..."
     echo "    -r   Generate resource estimate (default)"
     echo "    -q   Generate QASM"
     echo "    -f   Generate flattened QASM"
+    echo "    -Q   Write flattened QASM as a binary trace (decode with scripts/qtrace)"
     echo "    -R   Disable rotation decomposition"
+    echo "    -s   Keep each rotation decomposition as one packed gate sequence"
+    echo "         (llvm.CliffordTSeq), expanded only in flattened QASM"
+    echo "    -e   Estimate resources from loop trip counts instead of unrolling"
+    echo "         every loop (RESOURCES_SYMBOLIC); implies -R, rotations are"
+    echo "         counted as Rx/Ry/Rz gates"
     echo "    -T   Disable Toffoli decomposition"    
 	  echo "    -l   Levels of recursion to run (default=1)"
     echo "    -F   Force running all steps"
@@ -21,54 +27,215 @@ function show_help {
     echo "    -p   Purge all intermediate files (preserves specified output,"
     echo "         but requires recompilation for any new output)"
     echo "    -d   Dry-run; show all commands to be run, but do not execute"
+    echo "    -i   Run the optimization pipeline in a single scaffold-opt process"
+    echo "         (intermediate .ll files are not written)"
+    echo "    -b   Keep intermediate IR as bitcode (.bc) instead of text (.ll)"
+    echo "    -C   Reuse stage results from the compilation cache in"
+    echo "         \$SCAFFOLD_CACHE_DIR (default ~/.cache/scaffold); also"
+    echo "         enabled by SCAFFOLD_CACHE=1"
+    echo "    -t   Record wall/CPU time, peak memory and IR size of every stage"
+    echo "         in <filename>.stats.json"
+    echo "    -j   Batch mode: compile all given files with up to # parallel"
+    echo "         jobs, each in its own directory under \$SCAFFOLD_BATCH_DIR"
+    echo "         (default ./scaffold-batch), then print per-stage timings"
 }
 
 # Parse opts
 OPTIND=1         # Reset in case getopts has been used previously in the shell.
+bitcode=0
+cache=${SCAFFOLD_CACHE:-0}
 ctqg=0
 clean=0
 dryrun=""
 force=0
+inproc=0
+qtrace=0
+stats=0
+jobs=0
+passthru=""
 purge=0
 res=0
 rot=1
+symbolic=0
 toff=1
 targets=""
-while getopts "h?cdfFpqrRTl:" opt; do
+while getopts "h?bcCdefFij:pqQrRstTl:" opt; do
     case "$opt" in
     h|\?)
         show_help
         exit 0
         ;;
+    b) bitcode=1
+        ;;
     c) clean=1
         ;;
+    C) cache=1
+        ;;
 	  d) dryrun="--dry-run"
 		;;
+    e) symbolic=1
+        ;;
     F) force=1
         ;;
     f) targets="${targets} flat"
         ;;
+    i) inproc=1
+        ;;
+    j) jobs=${OPTARG}
+        ;;
     p) purge=1
         ;;
     q) targets="${targets} qasm"
         ;;
+    Q) qtrace=1
+        ;;
     r) res=1
         ;;
     R) rot=0
         ;;
+    s) targets="${targets} ROTATION_SEQ=1"
+        ;;
+    t) stats=1
+        ;;
     T) toff=0
         ;;        
     l) targets="${targets} SQCT_LEVELS=${OPTARG}"
         ;;
     esac
+    # Options are forwarded to every job in batch mode
+    if [ "$opt" != "j" ]; then
+        passthru="${passthru} -${opt}${OPTARG:+ ${OPTARG}}"
+    fi
 done
 shift $((OPTIND-1))
 [ "$1" = "--" ] && shift
 
+# Rotation decomposition needs the unrolled program, which -e is meant to avoid
+if [ ${symbolic} -eq 1 ]; then
+    targets="${targets} RESOURCES_SYMBOLIC=1"
+    rot=0
+fi
+
+# Stage name for a Scaffold.makefile banner line, or nothing if the line
+# does not start a stage
+function stage_of {
+    case "$1" in
+        *"] Extracting CTQG"*|*"] Compiling CTQG"*|*"] Merging CTQG"*) echo "ctqg" ;;
+        *"] Compiling "*) echo "clang" ;;
+        *"] Transforming cbits"*) echo "cbits" ;;
+        *"] O1 optimizations"*) echo "O1" ;;
+        *"] Unrolling Loops"*) echo "unroll" ;;
+        *"] Decomposing Rotations"*|*"] Rotation tool not built"*) echo "rotations" ;;
+        *"] Internalizing"*) echo "dce" ;;
+        *"] Toffoli Decomposition"*) echo "toffoli" ;;
+        *"] Running in-process pipeline"*) echo "inproc" ;;
+        *"] Generating resource count"*) echo "resources" ;;
+        *"] Generating hierarchical QASM"*) echo "qasm" ;;
+        *"] Generating flattened QASM"*) echo "flat" ;;
+        *"] Resources written"*|*"] Hierarchical QASM written"*|*"] Flat QASM written"*) echo "-" ;;
+    esac
+}
+
+# Compile one file inside its own scratch directory; every banner is
+# timestamped into stages.tsv so the batch summary can break down the time
+function batch_job {
+    local jobdir=$1 src=$2
+    local stage
+    cd "${jobdir}" || return 1
+    echo -e "start\t$(date +%s.%N)" > stages.tsv
+    "${root_abs}/scaffold.sh" ${passthru} "${src}" 2>&1 | while IFS= read -r line; do
+        echo "${line}"
+        stage=$(stage_of "${line}")
+        if [ -n "${stage}" ]; then
+            echo -e "${stage}\t$(date +%s.%N)" >> stages.tsv
+        fi
+    done > log.txt
+    local status=${PIPESTATUS[0]}
+    echo -e "end\t$(date +%s.%N)" >> stages.tsv
+    echo ${status} > status
+    return ${status}
+}
+
+# Print one row per job and one column per stage (seconds)
+function batch_summary {
+    local stages="ctqg clang cbits O1 unroll rotations dce toffoli inproc resources qasm flat"
+    printf "%-40s %-6s" "file" "status"
+    for s in ${stages}; do printf " %9s" "${s}"; done
+    printf " %9s\n" "total"
+    for jobdir in "$@"; do
+        printf "%-40s %-6s" "$(basename ${jobdir})" "$(cat ${jobdir}/status 2>/dev/null || echo '?')"
+        awk -F'\t' -v stages="${stages}" '
+            { name[NR] = $1; t[NR] = $2 }
+            END {
+                for (i = 2; i <= NR; i++)
+                    if (name[i-1] != "start" && name[i-1] != "-")
+                        secs[name[i-1]] += t[i] - t[i-1]
+                n = split(stages, s, " ")
+                for (i = 1; i <= n; i++) {
+                    if (s[i] in secs) printf " %9.2f", secs[s[i]]
+                    else printf " %9s", "-"
+                }
+                printf " %9.2f\n", t[NR] - t[1]
+            }' "${jobdir}/stages.tsv"
+    done
+}
+
+if [ $# -gt 1 ] || [ ${jobs} -gt 0 ]; then
+    [ ${jobs} -gt 0 ] || jobs=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+    root_abs=$(cd "${ROOT}" && pwd)
+    batch_dir=${SCAFFOLD_BATCH_DIR:-scaffold-batch}
+    mkdir -p "${batch_dir}" || exit 1
+    batch_dir=$(cd "${batch_dir}" && pwd)
+
+    declare -A seen
+    jobdirs=()
+    running=0
+    failed=0
+    for src in "$@"; do
+        if [ ! -e "${src}" ]; then
+            echo "${src}: file not found"
+            failed=1
+            continue
+        fi
+        src=$(cd "$(dirname "${src}")" && pwd)/$(basename "${src}")
+        name=$(basename "${src}" .scaffold)
+        # Same basename from different directories gets a numbered directory
+        n=${seen[${name}]:-0}
+        seen[${name}]=$((n + 1))
+        [ ${n} -gt 0 ] && name="${name}.${n}"
+        jobdir="${batch_dir}/${name}"
+        mkdir -p "${jobdir}"
+        jobdirs+=("${jobdir}")
+
+        if [ ${running} -ge ${jobs} ]; then
+            wait -n
+            running=$((running - 1))
+        fi
+        echo "[scaffold.sh] Compiling ${src} in ${jobdir} ..."
+        ( batch_job "${jobdir}" "${src}" ) &
+        running=$((running + 1))
+    done
+    wait
+
+    echo ""
+    batch_summary "${jobdirs[@]}"
+    for jobdir in "${jobdirs[@]}"; do
+        if [ "$(cat ${jobdir}/status 2>/dev/null)" != "0" ]; then
+            echo "[scaffold.sh] ${jobdir} failed, see ${jobdir}/log.txt"
+            failed=1
+        fi
+    done
+    exit ${failed}
+fi
+
 # Put resources at the end so it is easy to read
 if [ ${res} -eq 1 ]; then
     targets="${targets} resources"
 fi
+# Statistics cover all stages run before them
+if [ ${stats} -eq 1 ]; then
+    targets="${targets} stats"
+fi
 # Don't purge until done
 if [ ${purge} -eq 1 ]; then
     targets="${targets} purge"
@@ -78,8 +245,8 @@ if [ ${force} -eq 1 ]; then
     targets="clean ${targets}"
 fi
 # Default to resource estimate
-if [ -z "${targets}" ]; then
-    targets="resources"
+if [ -z "$(echo ${targets} | sed 's/stats//')" ]; then
+    targets="resources ${targets}"
 fi
 
 if [ $# -lt 1 ]; then 
@@ -108,6 +275,7 @@ if [ ${clean} -eq 1 ]; then
 	make -f $ROOT/scaffold/Scaffold.makefile ${dryrun} ROOT=$ROOT DIRNAME=${dir} FILENAME=${filename} FILE=${file} CFILE=${cfile} clean
     exit
 fi
-make -f $ROOT/scaffold/Scaffold.makefile ${dryrun} ROOT=$ROOT DIRNAME=${dir} FILENAME=${filename} FILE=${file} CFILE=${cfile} TOFF=${toff} CTQG=${ctqg} ROTATIONS=${rot} ${targets}
-
-exit 0
+if [ ${stats} -eq 1 ]; then
+    rm -f ${file}.stats.tmp
+fi
+make -f $ROOT/scaffold/Scaffold.makefile ${dryrun} ROOT=$ROOT DIRNAME=${dir} FILENAME=${filename} FILE=${file} CFILE=${cfile} TOFF=${toff} CTQG=${ctqg} ROTATIONS=${rot} INPROC=${inproc} BITCODE=${bitcode} CACHE=${cache} STATS=${stats} QTRACE=${qtrace} ${targets}
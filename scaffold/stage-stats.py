@@ -0,0 +1,117 @@
+#
+# Per-stage timing and memory report for Scaffold.makefile
+#
+# stage-stats.py record <stats-file> <stage> <output> <cached> -- <command...>
+#   Runs <command> and appends one JSON object per line to <stats-file>:
+#   wall and CPU seconds, peak RSS of the stage's processes, and the size of
+#   <output>. If <output> is LLVM IR and SCAFFOLD_STATS_OPT names an opt built
+#   with assertions, the function and instruction counts are added as well.
+#
+# stage-stats.py collect <stats-file> <report.json> <name>
+#   Gathers the recorded stages into a single JSON report.
+#
+
+import json
+import os
+import re
+import resource
+import subprocess
+import sys
+import time
+
+
+def ir_size(path):
+    """Function and instruction counts of an .ll/.bc file, using opt -instcount."""
+    opt = os.environ.get('SCAFFOLD_STATS_OPT')
+    if not opt or not os.path.exists(opt):
+        return None
+    if not (path.endswith('.ll') or path.endswith('.bc')) or not os.path.exists(path):
+        return None
+    p = subprocess.Popen([opt, '-disable-output', '-instcount', '-stats', path],
+                         stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    err = p.communicate()[1].decode('utf-8', 'replace')
+    counts = {}
+    for line in err.splitlines():
+        m = re.match(r'\s*(\d+) instcount\s+- Number of (.*)$', line)
+        if not m:
+            continue
+        if m.group(2).startswith('instructions (of all types)'):
+            counts['instructions'] = int(m.group(1))
+        elif m.group(2).startswith('non-external functions'):
+            counts['functions'] = int(m.group(1))
+        elif m.group(2).startswith('basic blocks'):
+            counts['basic_blocks'] = int(m.group(1))
+    return counts or None
+
+
+def record(stats, stage, output, cached, cmd):
+    before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    start = time.time()
+    status = subprocess.call(cmd)
+    wall = time.time() - start
+    after = resource.getrusage(resource.RUSAGE_CHILDREN)
+
+    # ru_maxrss is in kilobytes on Linux and in bytes on macOS
+    rss = after.ru_maxrss
+    if sys.platform != 'darwin':
+        rss *= 1024
+
+    entry = {
+        'stage': stage,
+        'output': output,
+        'cached': cached == '1',
+        'status': status,
+        'wall_seconds': round(wall, 3),
+        'user_seconds': round(after.ru_utime - before.ru_utime, 3),
+        'system_seconds': round(after.ru_stime - before.ru_stime, 3),
+        'peak_rss_bytes': rss,
+    }
+    if os.path.exists(output):
+        entry['output_bytes'] = os.path.getsize(output)
+        if status == 0:
+            size = ir_size(output)
+            if size:
+                entry['ir'] = size
+
+    f = open(stats, 'a')
+    f.write(json.dumps(entry, sort_keys=True) + '\n')
+    f.close()
+    return status
+
+
+def collect(stats, report, name):
+    stages = []
+    if os.path.exists(stats):
+        for line in open(stats):
+            if line.strip():
+                stages.append(json.loads(line))
+    totals = {
+        'wall_seconds': round(sum(s['wall_seconds'] for s in stages), 3),
+        'user_seconds': round(sum(s['user_seconds'] for s in stages), 3),
+        'system_seconds': round(sum(s['system_seconds'] for s in stages), 3),
+        'peak_rss_bytes': max([s['peak_rss_bytes'] for s in stages] or [0]),
+    }
+    f = open(report, 'w')
+    json.dump({'file': name, 'created': int(time.time()), 'stages': stages,
+               'total': totals}, f, indent=2, sort_keys=True)
+    f.write('\n')
+    f.close()
+
+    print('%-24s %10s %10s %12s %12s' % ('stage', 'wall(s)', 'cpu(s)', 'rss(MB)', 'instructions'))
+    for s in stages:
+        insts = s.get('ir', {}).get('instructions', '-')
+        print('%-24s %10.2f %10.2f %12.1f %12s' % (
+            s['stage'] + (' (cached)' if s['cached'] else ''), s['wall_seconds'],
+            s['user_seconds'] + s['system_seconds'], s['peak_rss_bytes'] / 1048576.0, insts))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) > 7 and sys.argv[1] == 'record' and sys.argv[6] == '--':
+        sys.exit(record(sys.argv[2], sys.argv[3], sys.argv[4], sys.argv[5], sys.argv[7:]))
+    elif len(sys.argv) == 5 and sys.argv[1] == 'collect':
+        collect(sys.argv[2], sys.argv[3], sys.argv[4])
+    else:
+        sys.stderr.write('usage: %s record <stats> <stage> <output> <cached> -- <command...>\n'
+                         '       %s collect <stats> <report.json> <name>\n'
+                         % (sys.argv[0], sys.argv[0]))
+        sys.exit(2)
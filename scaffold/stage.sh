@@ -0,0 +1,92 @@
+#!/bin/bash
+#
+# Runs one Scaffold.makefile stage, optionally cached and/or measured
+#
+# Usage: stage.sh <stage> <output> <input> [<option> ...] -- <command>
+#
+# Runs <command> (a single shell string) to produce <output> from <input>.
+#
+# With SCAFFOLD_CACHE=1 the result is content-addressed: if a result for the
+# same stage, the same <input> contents and the same <option> strings is
+# already in the cache, it is copied to <output> instead of running the
+# command. The opt binary and Scaffold library (SCAFFOLD_CACHE_TOOLS) are part
+# of the key, so rebuilding them invalidates the cache.
+#
+# With SCAFFOLD_STATS=<file>, wall time, CPU time, peak RSS and the size of
+# <output> are appended to <file> (see stage-stats.py).
+#
+# Environment:
+#   SCAFFOLD_CACHE        1 to enable the cache
+#   SCAFFOLD_CACHE_DIR    cache location (default: ~/.cache/scaffold)
+#   SCAFFOLD_CACHE_TOOLS  files whose size and mtime are part of every key
+#   SCAFFOLD_STATS        file collecting per-stage measurements
+#   SCAFFOLD_STATS_OPT    opt binary used to count functions and instructions
+
+if [ $# -lt 4 ]; then
+    echo "Usage: $0 <stage> <output> <input> [<option> ...] -- <command>" >&2
+    exit 2
+fi
+
+stage=$1
+output=$2
+input=$3
+shift 3
+options=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    options="${options} $1"
+    shift
+done
+[ "$1" = "--" ] && shift
+cmd="$*"
+
+# run <cached> <command>: run a command, measuring it if requested
+function run {
+    if [ -n "${SCAFFOLD_STATS}" ]; then
+        ${PYTHON:-python} "$(dirname $0)/stage-stats.py" record "${SCAFFOLD_STATS}" \
+            "${stage}" "${output}" "$1" -- /bin/bash -c "$2"
+    else
+        /bin/bash -c "$2"
+    fi
+}
+
+if [ "${SCAFFOLD_CACHE}" != "1" ]; then
+    run 0 "${cmd}"
+    exit $?
+fi
+
+if command -v sha1sum > /dev/null; then
+    HASH="sha1sum"
+else
+    HASH="shasum"
+fi
+
+cache_dir=${SCAFFOLD_CACHE_DIR:-${HOME}/.cache/scaffold}
+
+# Key: stage name, stage options, tool identities and the input contents
+input_hash=$(${HASH} < "${input}" | cut -d' ' -f1) || exit 1
+tools=""
+for t in ${SCAFFOLD_CACHE_TOOLS}; do
+    if [ -e "${t}" ]; then
+        tools="${tools} $(ls -lLn "${t}" | awk '{print $5, $6, $7, $8}')"
+    fi
+done
+key=$(printf '%s\n' "${stage}" "${options}" "${tools}" "${input_hash}" | ${HASH} | cut -d' ' -f1)
+entry="${cache_dir}/${key:0:2}/${key}"
+
+if [ -e "${entry}" ]; then
+    echo "[Scaffold.makefile] Reusing cached ${stage} result for ${output} ..."
+    run 1 "cp '${entry}' '${output}'"
+    exit $?
+fi
+
+run 0 "${cmd}" || exit $?
+
+# Store atomically so concurrent compiles never see a partial entry
+mkdir -p "${cache_dir}/${key:0:2}" || exit 0
+tmp="${entry}.tmp.$$"
+if cp "${output}" "${tmp}"; then
+    mv -f "${tmp}" "${entry}"
+else
+    rm -f "${tmp}"
+fi
+exit 0
@@ -0,0 +1,198 @@
+//===------------------------------ qtrace.cpp ----------------------------===//
+// Converts flat QASM (.qasmf) and LPFS schedules (.lpfs) between text and
+// the compact binary QTrace format (llvm/Transforms/Scaffold/QTrace.h).
+//
+//        This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+
+// Build:
+// $ g++ -O2 -o qtrace qtrace.cpp
+//
+// Usage:
+// $ ./qtrace encode <text input> <binary output>
+// $ ./qtrace decode <binary input>           (text on stdout)
+//
+// simd_router and braidflash read either form of a .lpfs file, so an
+// encoded schedule can replace the text one under the same name.
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include "../llvm/include/llvm/Transforms/Scaffold/QTrace.h"
+
+using namespace std;
+
+typedef qtrace::Writer<ostream> TraceWriter;
+
+static map<string, qtrace::u64> qubit_ids;
+
+// id of a qubit name, declaring it on first use
+static qtrace::u64 qubit_id (TraceWriter &W, const string &name, bool is_cbit = false) {
+  map<string, qtrace::u64>::iterator it = qubit_ids.find(name);
+  if (it != qubit_ids.end())
+    return it->second;
+  qtrace::u64 id = qubit_ids.size();
+  qubit_ids[name] = id;
+  W.declare(id, name, is_cbit);
+  return id;
+}
+
+// value of "key: N" in an LPFS function header, 0 if absent
+static qtrace::u64 header_field (const string &line, const string &key) {
+  string::size_type pos = line.find(" " + key + ": ");
+  if (pos == string::npos)
+    return 0;
+  return strtoull(line.c_str() + pos + key.size() + 3, NULL, 10);
+}
+
+static int encode (const char *in_path, const char *out_path) {
+  ifstream in (in_path);
+  if (!in.is_open()) {
+    cerr << "Error: Unable to open " << in_path << endl;
+    return 1;
+  }
+  ofstream out (out_path, ios::binary);
+  TraceWriter W(out);
+  string line;
+  unsigned long lineno = 0;
+
+  while (getline(in, line)) {
+    ++lineno;
+    // commas separate both timestep,zone and gate operands
+    string spaced = line;
+    for (string::size_type i = 0; i < spaced.size(); i++)
+      if (spaced[i] == ',') spaced[i] = ' ';
+    istringstream ss (spaced);
+    vector<string> elems;
+    string item;
+    while (ss >> item)
+      elems.push_back(item);
+    if (elems.empty())
+      continue;
+
+    // flat QASM declarations
+    if (elems.size() == 2 && (elems[0] == "qubit" || elems[0] == "cbit")) {
+      qubit_id(W, elems[1], elems[0] == "cbit");
+      continue;
+    }
+    // LPFS function headers
+    if (elems[0] == "Function:" && elems.size() > 1) {
+      W.module(elems[1], header_field(line, "k"), header_field(line, "d"));
+      continue;
+    }
+
+    // gates, optionally preceded by "timestep,zone" and other columns
+    bool scheduled = isdigit((unsigned char)line[0]) != 0;
+    qtrace::u64 timestep = 0, zone = 0;
+    unsigned first = 0;
+    if (scheduled) {
+      if (elems.size() < 3) continue;
+      timestep = strtoull(elems[0].c_str(), NULL, 10);
+      zone = strtoull(elems[1].c_str(), NULL, 10);
+      first = 2;
+    }
+    qtrace::OpCode op = qtrace::H;
+    unsigned i = first;
+    while (i < elems.size() && !qtrace::getOpCode(elems[i], op))
+      i++;
+    if (i == elems.size())
+      continue;  // "M:", "LPFS:", separators, ...
+    vector<string> args(elems.begin() + i + 1, elems.end());
+
+    if (qtrace::isMove(op)) {
+      if (args.size() < 3) {
+        cerr << in_path << ":" << lineno << ": malformed move" << endl;
+        return 1;
+      }
+      W.move(op, timestep, zone, strtoull(args[0].c_str(), NULL, 10),
+             strtoull(args[1].c_str(), NULL, 10), qubit_id(W, args[2]));
+    }
+    else if (qtrace::hasAngle(op)) {
+      // LPFS leaves the angle out
+      if (args.empty()) {
+        cerr << in_path << ":" << lineno << ": malformed rotation" << endl;
+        return 1;
+      }
+      double angle = args.size() > 1 ? atof(args[1].c_str()) : 0.0;
+      W.rotation(op, qubit_id(W, args[0]), angle, scheduled, timestep, zone);
+    }
+    else {
+      unsigned n = qtrace::getArity(op);
+      if (args.size() < n) {
+        cerr << in_path << ":" << lineno << ": expected " << n << " operands" << endl;
+        return 1;
+      }
+      qtrace::u64 q[3] = { 0, 0, 0 };
+      for (unsigned j = 0; j < n; j++)
+        q[j] = qubit_id(W, args[j]);
+      W.scheduledGate(op, scheduled, timestep, zone, q[0], q[1], q[2]);
+    }
+  }
+  W.end();
+  return 0;
+}
+
+static int decode (const char *in_path) {
+  qtrace::Reader R;
+  if (!R.open(in_path)) {
+    cerr << "Error: " << in_path << ": " << R.getError() << endl;
+    return 1;
+  }
+  qtrace::Record rec;
+  bool is_schedule = false;  // LPFS text has no declarations
+  while (R.next(rec)) {
+    switch (rec.kind) {
+    case qtrace::Record::Qubit:
+      if (!is_schedule)
+        cout << "qubit " << rec.name << "\n";
+      break;
+    case qtrace::Record::Cbit:
+      if (!is_schedule)
+        cout << "cbit " << rec.name << "\n";
+      break;
+    case qtrace::Record::Module:
+      is_schedule = true;
+      cout << "Function: " << rec.name << " (sched: lpfs, k: " << rec.k << ", d: " << rec.d << ")\n";
+      break;
+    case qtrace::Record::Gate:
+      if (rec.scheduled)
+        cout << rec.timestep << "," << rec.zone << " ";
+      cout << qtrace::getName(rec.op);
+      if (qtrace::isMove(rec.op))
+        cout << " " << rec.dst << " " << rec.src << " " << R.getQubitName(rec.qubits[0]);
+      else {
+        // LPFS separates operands with spaces, flat QASM with commas
+        const char *sep = rec.scheduled ? " " : ",";
+        for (unsigned i = 0, e = qtrace::getArity(rec.op); i != e; ++i)
+          cout << (i ? sep : " ") << R.getQubitName(rec.qubits[i]);
+        if (qtrace::hasAngle(rec.op)) {
+          char angle[32];
+          snprintf(angle, sizeof(angle), "%f", rec.angle);
+          cout << sep << angle;
+        }
+      }
+      cout << "\n";
+      break;
+    default:
+      break;
+    }
+  }
+  if (!R.getError().empty()) {
+    cerr << "Error: " << in_path << ": " << R.getError() << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main (int argc, char *argv[]) {
+  if (argc == 4 && string(argv[1]) == "encode")
+    return encode(argv[2], argv[3]);
+  if (argc == 3 && string(argv[1]) == "decode")
+    return decode(argv[2]);
+  cerr << "Usage: " << argv[0] << " encode <text input> <binary output>" << endl
+       << "       " << argv[0] << " decode <binary input>" << endl;
+  return 1;
+}
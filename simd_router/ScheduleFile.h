@@ -0,0 +1,553 @@
+//===-- ScheduleFile.h - Memory-mapped LPFS/CG/freq readers -----*- C++ -*-===//
+//
+//                     The LLVM Scaffold Compiler Infrastructure
+//
+// This file was created by Scaffold Compiler Working Group
+//
+//===----------------------------------------------------------------------===//
+//
+// Readers for the files the LPFS scheduler leaves next to a benchmark, which
+// simd_router and braidflash both consume:
+//
+//   <bench>.lpfs   schedule of every leaf function (text, or QTrace binary)
+//   <bench>.cg     calls made by every non-leaf function
+//   <bench>.freq   profile; the 10th column is how often a module is called
+//
+// Files are mapped into memory and tokenized in place: names are StrRefs
+// pointing into the mapping, and the qubit names of a schedule are interned
+// into dense integer ids, so every function becomes one flat array of Ops.
+// Large schedules are cut at their "Function:" headers and the sections are
+// parsed on several threads; ids are assigned in file order afterwards, so
+// the result does not depend on the number of threads.
+//
+// Unlike QTrace.h this header needs C++11, POSIX mmap and threads (build
+// with -pthread), and is only used by the standalone tools.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SIMD_ROUTER_SCHEDULEFILE_H
+#define SIMD_ROUTER_SCHEDULEFILE_H
+
+#include "../llvm/include/llvm/Transforms/Scaffold/QTrace.h"
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace schedfile {
+
+/// StrRef - A range of characters inside a mapped file; not null terminated.
+struct StrRef {
+  const char *Data;
+  size_t Size;
+
+  StrRef() : Data(nullptr), Size(0) {}
+  StrRef(const char *D, size_t N) : Data(D), Size(N) {}
+  StrRef(const std::string &S) : Data(S.data()), Size(S.size()) {}
+
+  bool empty() const { return Size == 0; }
+  std::string str() const { return std::string(Data, Size); }
+
+  bool operator==(StrRef O) const {
+    return Size == O.Size && memcmp(Data, O.Data, Size) == 0;
+  }
+  bool equals(const char *S) const { return *this == StrRef(S, strlen(S)); }
+  bool contains(const char *S) const {
+    size_t N = strlen(S);
+    return N <= Size && memmem(Data, Size, S, N) != nullptr;
+  }
+
+  /// upto - The prefix before the first C (all of it if there is none).
+  StrRef upto(char C) const {
+    const void *P = memchr(Data, C, Size);
+    return P ? StrRef(Data, (const char *)P - Data) : *this;
+  }
+
+  /// toULL - Leading decimal digits as a number, like strtoull.
+  unsigned long long toULL() const {
+    unsigned long long V = 0;
+    for (size_t i = 0; i < Size && isdigit((unsigned char)Data[i]); i++)
+      V = V * 10 + (Data[i] - '0');
+    return V;
+  }
+  double toDouble() const {
+    char Buf[64];
+    size_t N = Size < sizeof(Buf) - 1 ? Size : sizeof(Buf) - 1;
+    memcpy(Buf, Data, N);
+    Buf[N] = 0;
+    return strtod(Buf, nullptr);
+  }
+};
+
+/// MappedFile - A read-only file mapping.
+class MappedFile {
+  const char *Data;
+  size_t Size;
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+public:
+  MappedFile() : Data(nullptr), Size(0) {}
+  ~MappedFile() { close(); }
+
+  bool open(const std::string &Path) {
+    close();
+    int FD = ::open(Path.c_str(), O_RDONLY);
+    if (FD < 0) return false;
+    struct stat St;
+    bool Ok = fstat(FD, &St) == 0;
+    if (Ok && St.st_size > 0) {
+      void *P = mmap(nullptr, St.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+      if (P == MAP_FAILED) {
+        Ok = false;
+      } else {
+        Data = (const char *)P;
+        Size = St.st_size;
+        madvise(P, Size, MADV_SEQUENTIAL);
+      }
+    }
+    ::close(FD);
+    return Ok;
+  }
+
+  void close() {
+    if (Data) munmap((void *)Data, Size);
+    Data = nullptr;
+    Size = 0;
+  }
+
+  const char *begin() const { return Data; }
+  const char *end() const { return Data + Size; }
+  size_t size() const { return Size; }
+};
+
+/// nextLine - The line starting at Cur, without its line terminator;
+/// advances Cur past it.
+inline StrRef nextLine(const char *&Cur, const char *End) {
+  const char *Begin = Cur;
+  const char *NL = (const char *)memchr(Cur, '\n', End - Cur);
+  const char *Stop = NL ? NL : End;
+  Cur = NL ? NL + 1 : End;
+  if (Stop > Begin && Stop[-1] == '\r') --Stop;
+  return StrRef(Begin, Stop - Begin);
+}
+
+/// tokenize - Split Line at whitespace and at any character of Seps.
+inline void tokenize(StrRef Line, const char *Seps, std::vector<StrRef> &Tokens) {
+  Tokens.clear();
+  size_t i = 0;
+  while (i < Line.Size) {
+    while (i < Line.Size && (isspace((unsigned char)Line.Data[i]) ||
+                             strchr(Seps, Line.Data[i])))
+      i++;
+    size_t Begin = i;
+    while (i < Line.Size && !isspace((unsigned char)Line.Data[i]) &&
+           !strchr(Seps, Line.Data[i]))
+      i++;
+    if (i > Begin)
+      Tokens.push_back(StrRef(Line.Data + Begin, i - Begin));
+  }
+}
+
+/// NameTable - Interns names into dense ids, in order of first use. The
+/// table refers to the names, it does not copy them.
+class NameTable {
+  std::vector<StrRef> Names;
+  std::vector<uint32_t> Slots;    // id + 1, or 0 if free
+
+  static size_t hash(StrRef S) {
+    size_t H = 2166136261u;
+    for (size_t i = 0; i < S.Size; i++)
+      H = (H ^ (unsigned char)S.Data[i]) * 16777619u;
+    return H;
+  }
+  void insert(uint32_t Id) {
+    size_t Mask = Slots.size() - 1;
+    size_t i = hash(Names[Id]) & Mask;
+    while (Slots[i]) i = (i + 1) & Mask;
+    Slots[i] = Id + 1;
+  }
+  void grow() {
+    Slots.assign(Slots.empty() ? 64 : Slots.size() * 2, 0);
+    for (uint32_t Id = 0; Id < Names.size(); Id++)
+      insert(Id);
+  }
+
+public:
+  uint32_t intern(StrRef S) {
+    if ((Names.size() + 1) * 2 > Slots.size()) grow();
+    size_t Mask = Slots.size() - 1;
+    for (size_t i = hash(S) & Mask;; i = (i + 1) & Mask) {
+      if (!Slots[i]) {
+        Names.push_back(S);
+        Slots[i] = Names.size();
+        return Names.size() - 1;
+      }
+      if (Names[Slots[i] - 1] == S)
+        return Slots[i] - 1;
+    }
+  }
+
+  uint32_t size() const { return Names.size(); }
+  StrRef operator[](uint32_t Id) const { return Names[Id]; }
+  void clear() {
+    Names.clear();
+    Slots.clear();
+  }
+};
+
+/// lookupOp - Parse a gate mnemonic without copying it.
+inline bool lookupOp(StrRef Name, qtrace::OpCode &Op) {
+  for (unsigned i = 0; i < qtrace::NumOpCodes; i++)
+    if (Name.equals(qtrace::getName((qtrace::OpCode)i))) {
+      Op = (qtrace::OpCode)i;
+      return true;
+    }
+  if (Name.equals("Toffoli")) {
+    Op = qtrace::Toffoli;
+    return true;
+  }
+  return false;
+}
+
+/// Op - One scheduled gate; qubits are ids in Schedule::Qubits.
+struct Op {
+  qtrace::OpCode Code;
+  uint32_t Timestep, Zone;
+  uint32_t Qubits[3];   // getArity(Code) ids; TMOV/BMOV use Qubits[0]
+  uint32_t Dst, Src;    // TMOV/BMOV regions
+  double Angle;         // Rx/Ry/Rz
+};
+
+/// Function - The schedule of one leaf function.
+struct Function {
+  StrRef Name;
+  unsigned K, D;        // SIMD regions and depth from the header
+  std::vector<Op> Ops;
+  Function() : K(0), D(0) {}
+};
+
+/// Schedule - A parsed .lpfs file, text or QTrace.
+class Schedule {
+  MappedFile File;
+  std::deque<std::string> TraceNames;   // owns the names of a QTrace
+  std::string Error;
+
+  // One "Function:" section of a text schedule, parsed on its own with
+  // qubit ids local to the section.
+  struct Section {
+    const char *Begin, *End;
+    Function F;
+    NameTable Local;
+    std::string Error;
+  };
+
+  bool fail(const std::string &Msg) {
+    Error = Msg;
+    return false;
+  }
+
+  // value after "Key" in a tokenized function header
+  static unsigned headerField(const std::vector<StrRef> &Tok, const char *Key) {
+    for (size_t i = 0; i + 1 < Tok.size(); i++)
+      if (Tok[i].equals(Key))
+        return Tok[i + 1].toULL();
+    return 0;
+  }
+
+  static void parseSection(Section &S, unsigned OpField) {
+    std::vector<StrRef> Tok;
+    const char *Cur = S.Begin;
+    while (Cur < S.End) {
+      StrRef Line = nextLine(Cur, S.End);
+      tokenize(Line, ",", Tok);
+      if (Tok.empty())
+        continue;
+      if (Tok[0].equals("Function:")) {
+        if (Tok.size() > 1) S.F.Name = Tok[1];
+        S.F.K = headerField(Tok, "k:");
+        S.F.D = headerField(Tok, "d:");
+        continue;
+      }
+      // "timestep,zone OP operands", with OpField more columns in front
+      // of OP; anything else is decoration
+      size_t i = 2 + OpField;
+      if (!isdigit((unsigned char)Tok[0].Data[0]) || Tok.size() <= i)
+        continue;
+      Op O = Op();
+      if (!lookupOp(Tok[i], O.Code))
+        continue;
+      O.Timestep = Tok[0].toULL();
+      O.Zone = Tok[1].toULL();
+      const StrRef *Args = &Tok[i + 1];
+      size_t NumArgs = Tok.size() - i - 1;
+
+      if (qtrace::isMove(O.Code)) {
+        if (NumArgs < 3) {
+          S.Error = "malformed move '" + Line.str() + "'";
+          return;
+        }
+        O.Dst = Args[0].toULL();
+        O.Src = Args[1].toULL();
+        O.Qubits[0] = S.Local.intern(Args[2]);
+      } else {
+        unsigned N = qtrace::getArity(O.Code);
+        if (NumArgs < N) {
+          S.Error = "malformed gate '" + Line.str() + "'";
+          return;
+        }
+        for (unsigned j = 0; j < N; j++)
+          O.Qubits[j] = S.Local.intern(Args[j]);
+        // LPFS leaves the angle of a rotation out
+        if (qtrace::hasAngle(O.Code) && NumArgs > N)
+          O.Angle = Args[N].toDouble();
+      }
+      S.F.Ops.push_back(O);
+    }
+  }
+
+  bool loadText(unsigned Threads, unsigned OpField) {
+    // Cut the file at every line that starts with "Function:"; anything
+    // before the first header belongs to no function.
+    static const char Header[] = "Function:";
+    const size_t HeaderLen = sizeof(Header) - 1;
+    std::vector<Section> Sections;
+    const char *Begin = File.begin(), *End = File.end();
+    const char *Cur = Begin;
+    if (File.size() < HeaderLen || memcmp(Begin, Header, HeaderLen) != 0) {
+      Cur = (const char *)memmem(Begin, End - Begin, "\nFunction:", HeaderLen + 1);
+      Cur = Cur ? Cur + 1 : End;
+    }
+    while (Cur < End) {
+      const char *Next = (const char *)memmem(Cur + 1, End - Cur - 1,
+                                              "\nFunction:", HeaderLen + 1);
+      Next = Next ? Next + 1 : End;
+      Sections.push_back(Section());
+      Sections.back().Begin = Cur;
+      Sections.back().End = Next;
+      Cur = Next;
+    }
+
+    // Small schedules are not worth the threads
+    if (Threads == 0)
+      Threads = std::thread::hardware_concurrency();
+    if (File.size() < (1 << 20) || Threads == 0)
+      Threads = 1;
+    if (Threads > Sections.size())
+      Threads = Sections.size();
+
+    std::atomic<size_t> NextSection(0);
+    auto Work = [&]() {
+      for (size_t i; (i = NextSection++) < Sections.size();)
+        parseSection(Sections[i], OpField);
+    };
+    std::vector<std::thread> Pool;
+    for (unsigned t = 1; t < Threads; t++)
+      Pool.emplace_back(Work);
+    Work();
+    for (auto &T : Pool)
+      T.join();
+
+    // Renumber the qubits of every section into the shared table, in file
+    // order
+    std::vector<uint32_t> Remap;
+    for (auto &S : Sections) {
+      if (!S.Error.empty())
+        return fail(S.Error);
+      Remap.resize(S.Local.size());
+      for (uint32_t Id = 0; Id < S.Local.size(); Id++)
+        Remap[Id] = Qubits.intern(S.Local[Id]);
+      for (auto &O : S.F.Ops) {
+        unsigned N = qtrace::isMove(O.Code) ? 1 : qtrace::getArity(O.Code);
+        for (unsigned j = 0; j < N; j++)
+          O.Qubits[j] = Remap[O.Qubits[j]];
+      }
+      Functions.push_back(std::move(S.F));
+    }
+    return true;
+  }
+
+  bool loadTrace(const std::string &Path) {
+    qtrace::Reader Trace;
+    qtrace::Record Rec;
+    std::vector<uint32_t> Remap;    // trace qubit id -> table id
+    if (!Trace.open(Path))
+      return fail(Trace.getError());
+    while (Trace.next(Rec)) {
+      switch (Rec.kind) {
+      case qtrace::Record::Qubit:
+      case qtrace::Record::Cbit:
+        TraceNames.push_back(Rec.name);
+        if (Rec.id >= Remap.size()) Remap.resize(Rec.id + 1, 0);
+        Remap[Rec.id] = Qubits.intern(TraceNames.back());
+        break;
+      case qtrace::Record::Module:
+        TraceNames.push_back(Rec.name);
+        Functions.push_back(Function());
+        Functions.back().Name = TraceNames.back();
+        Functions.back().K = Rec.k;
+        Functions.back().D = Rec.d;
+        break;
+      case qtrace::Record::Gate: {
+        if (Functions.empty())
+          break;
+        Op O = Op();
+        O.Code = Rec.op;
+        O.Timestep = Rec.timestep;
+        O.Zone = Rec.zone;
+        O.Dst = Rec.dst;
+        O.Src = Rec.src;
+        O.Angle = Rec.angle;
+        unsigned N = qtrace::isMove(O.Code) ? 1 : qtrace::getArity(O.Code);
+        for (unsigned j = 0; j < N; j++) {
+          if (Rec.qubits[j] >= Remap.size())
+            return fail("undeclared qubit");
+          O.Qubits[j] = Remap[Rec.qubits[j]];
+        }
+        Functions.back().Ops.push_back(O);
+        break;
+      }
+      default:
+        break;
+      }
+    }
+    if (!Trace.getError().empty())
+      return fail(Trace.getError());
+    return true;
+  }
+
+public:
+  NameTable Qubits;
+  std::vector<Function> Functions;
+
+  /// load - Read a text or QTrace schedule. Threads is the number of
+  /// threads for a text schedule, 0 for one per core. OpField is the number
+  /// of columns between "timestep,zone" and the gate mnemonic of a text
+  /// schedule: 0 for LPFS output, 1 for the older layout braidflash reads.
+  bool load(const std::string &Path, unsigned Threads = 0, unsigned OpField = 0) {
+    Functions.clear();
+    Qubits.clear();
+    TraceNames.clear();
+    Error.clear();
+    if (qtrace::Reader::isTrace(Path))
+      return loadTrace(Path);
+    if (!File.open(Path))
+      return fail("cannot open file");
+    return loadText(Threads, OpField);
+  }
+
+  const std::string &getError() const { return Error; }
+};
+
+/// Call - One call in the body of a non-leaf function.
+struct Call {
+  StrRef Callee;
+  uint32_t FirstArg, NumArgs;   // range of CallGraph::Args
+};
+
+/// CallGraphFunction - A function summary ("SIMD k=.. d=.. NAME leaf= N")
+/// and, for non-leaves, the calls listed above it.
+struct CallGraphFunction {
+  StrRef Name;
+  bool IsLeaf;
+  uint32_t FirstCall, NumCalls;   // range of CallGraph::Calls
+};
+
+/// CallGraph - A parsed .cg file. Calls to llvm.* intrinsics are dropped,
+/// and arguments lose their "(index)" suffix.
+class CallGraph {
+  MappedFile File;
+
+public:
+  std::vector<CallGraphFunction> Functions;
+  std::vector<Call> Calls;
+  std::vector<StrRef> Args;
+
+  bool load(const std::string &Path) {
+    Functions.clear();
+    Calls.clear();
+    Args.clear();
+    if (!File.open(Path))
+      return false;
+    std::vector<StrRef> Tok;
+    uint32_t BodyBegin = 0;
+    const char *Cur = File.begin();
+    while (Cur < File.end()) {
+      StrRef Line = nextLine(Cur, File.end());
+      if (Line.empty())
+        continue;
+      // "callee : arg(i) arg(j) ..."
+      if (!Line.contains("#") && !Line.contains("SIMD")) {
+        tokenize(Line, "", Tok);
+        if (Tok.empty() || Tok[0].contains("llvm."))
+          continue;
+        Call C;
+        C.Callee = Tok[0];
+        C.FirstArg = Args.size();
+        for (size_t i = 2; i < Tok.size(); i++)
+          Args.push_back(Tok[i].upto('('));
+        C.NumArgs = Args.size() - C.FirstArg;
+        Calls.push_back(C);
+      }
+      // "SIMD k=4 d=1024 NAME leaf= N ..." closes the body above it
+      else if (Line.contains("SIMD k")) {
+        tokenize(Line, "", Tok);
+        CallGraphFunction F;
+        F.Name = Tok.size() > 3 ? Tok[3] : StrRef();
+        F.IsLeaf = Tok.size() > 5 && atoi(Tok[5].str().c_str()) != 0;
+        F.FirstCall = BodyBegin;
+        F.NumCalls = Calls.size() - BodyBegin;
+        Functions.push_back(F);
+        BodyBegin = Calls.size();
+      }
+    }
+    return true;
+  }
+};
+
+/// Frequency - One line of a .freq profile.
+struct Frequency {
+  StrRef Module;
+  unsigned long long Count;
+};
+
+/// FrequencyProfile - A parsed .freq file; lines with fewer than ten
+/// columns are skipped.
+class FrequencyProfile {
+  MappedFile File;
+
+public:
+  std::vector<Frequency> Entries;
+
+  bool load(const std::string &Path) {
+    Entries.clear();
+    if (!File.open(Path))
+      return false;
+    std::vector<StrRef> Tok;
+    const char *Cur = File.begin();
+    while (Cur < File.end()) {
+      tokenize(nextLine(Cur, File.end()), "", Tok);
+      if (Tok.size() < 10)
+        continue;
+      Frequency F;
+      F.Module = Tok[0];
+      F.Count = Tok[9].toULL();
+      Entries.push_back(F);
+    }
+    return true;
+  }
+};
+
+} // End schedfile namespace
+
+#endif
@@ -60,6 +60,7 @@
 #include <sstream>    //std::stringstream
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <tuple>
 #include <stack>
 #include <cstring>    //strcmp
@@ -76,6 +77,7 @@
 #include <boost/serialization/base_object.hpp> // serialize in polymorphism
 #include <boost/serialization/shared_ptr.hpp> // serialize shared_ptr
 #include <boost/graph/depth_first_search.hpp> // DFS for graph traversal
+#include "ScheduleFile.h" // .lpfs/.cg/.freq
 
 #define _DEBUG_PROGRESS
 //#define _DEBUG_SERIALIZATION
@@ -603,35 +605,6 @@ void print_mesh() {
 
 // ------------------------- Parser and Parser Helpers ------------------------
 
-// is there any of several words in a given string?
-template<typename T, size_t N>
-T * end(T (&ra)[N]) {
-    return ra + N;
-}
-
-std::string::size_type is_there(std::vector<std::string> needles, std::string haystack) {
-  std::vector<std::string>::iterator needle;
-  std::string::size_type pos;
-  for(needle=needles.begin(); needle!=needles.end(); ++needle){
-    pos = haystack.find(*needle);
-    if(pos != std::string::npos){
-      return pos;
-    }
-  }  
-  return std::string::npos;
-}
-
-// tokenize string
-std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
-    std::stringstream ss(s);
-    std::string item;
-    while (std::getline(ss, item, delim)) {
-      if (!item.empty())             
-        elems.push_back(item);
-    }
-    return elems;
-}
-
 // Set the latency and size of ancilla factories
 void create_factories(unsigned int concatenation_level) {
   unsigned int magic_cnots= 0;
@@ -688,59 +661,51 @@ InstTableTy create_mesh(const InstTableTy &mapOfLogicalInst_v) {
   return mapOfLogicalInst_v2;   
 }
 
-// Read in LPFS schedule, parse: SIMD_K, MOVinst(qbits, src, dest), OPinst(optype)
+// Set the SIMD topology from the first LPFS function header
+void set_topology (unsigned int k, unsigned int d) {
+  if (SIMD_K == 0) {
+    SIMD_K = k + num_zero_factories + num_magic_factories + num_epr_factories;
+    SIMD_D = d;
+    SIMD_rows = (int)(ceil(sqrt(2.0*SIMD_K)));
+    SIMD_cols = (int)(ceil(2.0*SIMD_K/SIMD_rows));
+    std::cerr<<"Topology : SIMD("<<SIMD_K<<","<<SIMD_D<<") : "<<SIMD_rows<<"*"<<SIMD_cols<<std::endl;
+  }
+}
+
+// Read in LPFS schedule (text, or binary from scripts/qtrace), parse: SIMD_K,
+// MOVinst(qbits, src, dest), OPinst(optype)
 InstTableTy parse_LPFS_file (const std::string file_path) {
   #ifdef _DEBUG_PROGRESS
     std::cerr<<"parsing LPFS..."<<std::endl;
   #endif
-  
-  std::ifstream LPFSfile (file_path);
-  std::string line;
+
+  schedfile::Schedule schedule;
   InstTableTy mapOfLogicalInst_v;
-  std::string leaf_func;    
-  
-  if (LPFSfile.is_open())
-  {    
-    // op_strings -- can be expanded to other 1-qubit / 2-qubit gates
-    const char* all_ops[] = {"PrepZ ", "X ", "Z ", "H ", "CNOT ", "T ", "Tdag ", "S ", "Sdag ", "MeasZ "};
-    std::vector<std::string> op_strings(all_ops, end(all_ops));
-     
-    while ( std::getline (LPFSfile,line) ) {
-      // FunctionHeaders
-      if (line.find("Function") != std::string::npos) {
-        std::vector<std::string> elems;
-        split(line, ' ', elems);
-        leaf_func = elems[1];
-        if (SIMD_K == 0) {
-          SIMD_K = atoi(elems[5].c_str()) + num_zero_factories + num_magic_factories + num_epr_factories;
-          SIMD_D = atoi(elems[7].c_str());    
-          SIMD_rows = (int)(ceil(sqrt(2.0*SIMD_K)));
-          SIMD_cols = (int)(ceil(2.0*SIMD_K/SIMD_rows));
-          std::cerr<<"Topology : SIMD("<<SIMD_K<<","<<SIMD_D<<") : "<<SIMD_rows<<"*"<<SIMD_cols<<std::endl;
-        }        
-      }
+  if (!schedule.load(file_path)) {
+    std::cerr<<"Error: "<<file_path<<": "<<schedule.getError()<<std::endl;
+    exit(1);
+  }
+  std::vector<std::string> qbit_names (schedule.Qubits.size());
+  for (uint32_t i = 0; i < schedule.Qubits.size(); i++)
+    qbit_names[i] = schedule.Qubits[i].str();
+
+  for (auto &F : schedule.Functions) {
+    std::string leaf_func = F.Name.str();
+    set_topology(F.K, F.D);
+    InstVecTy &LogicalInst_v = mapOfLogicalInst_v[leaf_func];
+    for (auto &op : F.Ops) {
+      std::vector<std::string> qbit_id;
+      qbit_id.push_back(qbit_names[op.Qubits[0]]);
 
       // MOVinst : Teleport
-      else if (line.find("TMOV") != std::string::npos) {
-        std::vector<std::string> elems;
-        split(line, ' ', elems);
-        unsigned int timestep = atoi(elems[0].substr(0,elems[0].find(',')).c_str());
-        unsigned int source = atoi(elems[3].c_str());
-        unsigned int destination = atoi(elems[2].c_str());
-        std::vector<std::string> qbit_id;        
-        std::string qbit_id1 = elems[4];
-        qbit_id.push_back(qbit_id1);
-        std::shared_ptr<Instruction> logical_inst_cur (std::make_shared <MOVinst> (timestep, source, destination, qbit_id));        
-        mapOfLogicalInst_v[leaf_func].push_back(logical_inst_cur);
-      }      
-
+      if (op.Code == qtrace::TMOV) {
+        std::shared_ptr<Instruction> logical_inst_cur (std::make_shared <MOVinst> (op.Timestep, op.Src, op.Dst, qbit_id));
+        LogicalInst_v.push_back(logical_inst_cur);
+      }
       // BMOVinst: Local Memory Move
-      else if (line.find("BMOV") != std::string::npos) {
-        std::vector<std::string> elems;
-        split(line, ' ', elems);
-        unsigned int timestep = atoi(elems[0].substr(0,elems[0].find(',')).c_str());
-        unsigned int source = atoi(elems[3].c_str());
-        unsigned int destination = atoi(elems[2].c_str());
+      else if (op.Code == qtrace::BMOV) {
+        unsigned int source = op.Src;
+        unsigned int destination = op.Dst;
         sub_loc_t source_sub, destination_sub;
         if (source % 10 == 0) {
           source = (unsigned int)(source / 10);
@@ -754,39 +719,18 @@ InstTableTy parse_LPFS_file (const std::string file_path) {
         }
         else
           std::cerr<<"Error: incorrect Local Memory move."<<std::endl;
-        std::vector<std::string> qbit_id;        
-        std::string qbit_id1 = elems[4];
-        qbit_id.push_back(qbit_id1);
-        std::shared_ptr<Instruction> logical_inst_cur (std::make_shared <BMOVinst> (timestep, source, source_sub, destination, destination_sub, qbit_id));        
-        mapOfLogicalInst_v[leaf_func].push_back(logical_inst_cur);
-      } 
-
-      // OPinsts
-      else if (is_there(op_strings, line) != std::string::npos) {
-        std::vector<std::string> elems;
-        std::vector<std::string> ts_zone;        
-        split(line, ' ', elems);
-        split(elems[0], ',', ts_zone);
-        unsigned int timestep = atoi(ts_zone[0].c_str());
-        unsigned int zone = atoi(ts_zone[1].c_str());
-        std::string operation_type = elems[1];
-        std::vector<std::string> qbit_id;
-        std::string qbit_id1 = elems[2]; 
-        qbit_id.push_back(qbit_id1);        
-        if (elems.size() == 4) {
-          std::string qbit_id2 = elems[3];          
-          qbit_id.push_back(qbit_id2);
-        }        
-        std::shared_ptr<Instruction> logical_inst_cur (std::make_shared <OPinst> (timestep, zone, operation_type, qbit_id));
-        if (operation_type != "X" && operation_type != "Z" && operation_type != "T" && operation_type != "Tdag")
-          mapOfLogicalInst_v[leaf_func].push_back(logical_inst_cur);        
+        std::shared_ptr<Instruction> logical_inst_cur (std::make_shared <BMOVinst> (op.Timestep, source, source_sub, destination, destination_sub, qbit_id));
+        LogicalInst_v.push_back(logical_inst_cur);
+      }
+      // OPinsts: X, Z, T and Tdag do not affect routing
+      else if (op.Code == qtrace::PrepZ || op.Code == qtrace::H || op.Code == qtrace::CNOT ||
+               op.Code == qtrace::S || op.Code == qtrace::Sdag || op.Code == qtrace::MeasZ) {
+        if (op.Code == qtrace::CNOT)
+          qbit_id.push_back(qbit_names[op.Qubits[1]]);
+        std::shared_ptr<Instruction> logical_inst_cur (std::make_shared <OPinst> (op.Timestep, op.Zone, qtrace::getName(op.Code), qbit_id));
+        LogicalInst_v.push_back(logical_inst_cur);
       }
     }
-    LPFSfile.close();
-  }
-  else {
-    std::cerr<<"Error: Unable to open file."<<std::endl;
-    exit(1);
   }
 
   return mapOfLogicalInst_v; 
@@ -797,26 +741,15 @@ std::unordered_map<std::string, unsigned long long> parse_freq (const std::strin
   #ifdef _DEBUG_PROGRESS
     std::cerr<<"parsing Freq..."<<std::endl;
   #endif  
-  std::ifstream profile_freq_file (file_path);
-  std::string line;
-  std::string module_name = "";  
+  schedfile::FrequencyProfile profile;
   std::unordered_map<std::string, unsigned long long> mapOfFreq;
-  mapOfFreq.clear();
-  unsigned long long freq = 0;
-  if (profile_freq_file.is_open()) {
-    while ( getline (profile_freq_file,line) ) {
-      std::vector<std::string> elems; 
-      elems.clear();     
-      split(line, ' ', elems);              
-      module_name = elems[0];
-      freq = std::stoull(elems[9]);
-      mapOfFreq[module_name] = freq;
-    }
-  }
-  else {
+  if (!profile.load(file_path)) {
     std::cerr << "Unable to open .freq file" << std::endl;
     exit(1);
   }
+  mapOfFreq.reserve(profile.Entries.size());
+  for (auto &E : profile.Entries)
+    mapOfFreq[E.Module.str()] = E.Count;
   return mapOfFreq;
 }
 
@@ -827,66 +760,46 @@ InstTableTy parse_CG_file (const std::string file_path) {
     std::cerr<<"parsing CG..."<<std::endl;
   #endif
   
-  std::ifstream CGfile (file_path);
-  std::string line;
+  schedfile::CallGraph cg;
   InstTableTy mapOfCGInst_v;
-  InstVecTy bodyInst_v;
-  unsigned int seq = 0;          // tag Instruction sequence numbers as we build bodyInst_v
+  std::unordered_set<std::string> leaf_set;   // lookups for leaves
 
-
-  if (CGfile.is_open())
-  {
-    while ( std::getline (CGfile,line) ) {
-      if(line.empty())
-        continue;
-      // Function Bodies: CGInsts
-      else if (line.find("#") == std::string::npos && line.find("SIMD") == std::string::npos) {
-        
-        std::vector<std::string> elems;
-        split(line, ' ', elems);
-        std::string callee_name = elems[0];
-        if (callee_name.find("llvm.")!=std::string::npos)
-          continue;
-        std::vector<std::string> args;
-        for (int i = 2; i<elems.size(); i++)
-          args.push_back( elems[i].substr(0, elems[i].find_first_of('(') ) );
-        bool is_callee_leaf;
-        if (std::find(leaves.begin(), leaves.end(), callee_name) != leaves.end())
-          is_callee_leaf = false;
-        else
-          is_callee_leaf = true;
-        std::shared_ptr<Instruction> cg_inst_cur (std::make_shared <CGinst> (0, callee_name, args, is_callee_leaf));
-        cg_inst_cur->seq = seq++;
-        bodyInst_v.push_back(cg_inst_cur);
-      }
-      // Function Summary
-      else if (line.find("SIMD k") != std::string::npos) {
-        std::vector<std::string> elems;
-        split(line, ' ', elems);
-        std::string module_name = elems[3];
-        std::string leaf_status = elems[5];
-        bool is_leaf = atoi(leaf_status.c_str());
-        if (is_leaf == 0) {
-          if (bodyInst_v.size() == 0) {
-            std::cerr<<"Error: Bad .cg file format."<<std::endl;
-            exit(1);
-          }
-          mapOfCGInst_v[module_name] = bodyInst_v;
-          non_leaves.push_back(module_name);  // add module to non-leaves
-        }
-        else 
-          leaves.push_back(module_name);      // add module to leaves
-        bodyInst_v.clear();                    // all of this non-leaf's body is read
-        seq = 0;
-      }      
-    }
-
-    CGfile.close();
-  }
-  else {
+  if (!cg.load(file_path)) {
     std::cerr<<"Error: Unable to open file."<<std::endl;
     exit(1);
   }
+  for (auto &F : cg.Functions) {
+    std::string module_name = F.Name.str();
+    if (F.IsLeaf) {
+      leaves.push_back(module_name);      // add module to leaves
+      leaf_set.insert(module_name);
+      continue;
+    }
+    // Function Bodies: CGInsts, tagged with sequence numbers
+    if (F.NumCalls == 0) {
+      std::cerr<<"Error: Bad .cg file format."<<std::endl;
+      exit(1);
+    }
+    InstVecTy &bodyInst_v = mapOfCGInst_v[module_name];
+    bodyInst_v.clear();
+    bodyInst_v.reserve(F.NumCalls);
+    for (uint32_t c = F.FirstCall; c < F.FirstCall + F.NumCalls; c++) {
+      const schedfile::Call &call = cg.Calls[c];
+      std::string callee_name = call.Callee.str();
+      std::vector<std::string> args;
+      for (uint32_t a = call.FirstArg; a < call.FirstArg + call.NumArgs; a++)
+        args.push_back(cg.Args[a].str());
+      bool is_callee_leaf;
+      if (leaf_set.count(callee_name))
+        is_callee_leaf = false;
+      else
+        is_callee_leaf = true;
+      std::shared_ptr<Instruction> cg_inst_cur (std::make_shared <CGinst> (0, callee_name, args, is_callee_leaf));
+      cg_inst_cur->seq = c - F.FirstCall;
+      bodyInst_v.push_back(cg_inst_cur);
+    }
+    non_leaves.push_back(module_name);  // add module to non-leaves
+  }
   return mapOfCGInst_v;
 }
 